@@ -39,6 +39,11 @@
 #include <ege/asyncLoop/AsyncHandler.h>
 #include <ege/asyncLoop/AsyncLoop.h>
 #include <ege/asyncLoop/AsyncTask.h>
+#include <ege/asyncLoop/CancellationToken.h>
+#include <ege/asyncLoop/Future.h>
+#include <ege/asyncLoop/InvokeQueue.h>
+#include <ege/asyncLoop/TaskExecutor.h>
+#include <ege/asyncLoop/ThreadPool.h>
 #include <ege/asyncLoop/ThreadSafeEventLoop.cpp>
 #include <ege/asyncLoop/ThreadSafeEventLoop.h>
 
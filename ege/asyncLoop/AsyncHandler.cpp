@@ -51,22 +51,18 @@ void AsyncHandler::addAsyncTask(SharedPtr<AsyncTask> task, std::string name)
 std::vector<std::weak_ptr<AsyncTask>> AsyncHandler::getAsyncTasks(std::string name)
 {
     std::vector<std::weak_ptr<AsyncTask>> tasks;
-    decltype(m_asyncTasks)::iterator it;
-    while((it = m_asyncTasks.find(name)) != m_asyncTasks.end())
-    {
+    auto range = m_asyncTasks.equal_range(name);
+    for(auto it = range.first; it != range.second; it++)
         tasks.push_back(it->second);
-    }
     return tasks;
 }
 
-// unsafe due to thread termination
 void AsyncHandler::removeAsyncTasks(std::string name)
 {
-    decltype(m_asyncTasks)::iterator it;
-    while((it = m_asyncTasks.find(name)) != m_asyncTasks.end())
-    {
-        m_asyncTasks.erase(it);
-    }
+    auto range = m_asyncTasks.equal_range(name);
+    for(auto it = range.first; it != range.second; it++)
+        it->second->stop();
+    m_asyncTasks.erase(range.first, range.second);
 }
 
 void AsyncHandler::safeRemoveAsyncTasks()
@@ -74,6 +70,15 @@ void AsyncHandler::safeRemoveAsyncTasks()
     ASSERT(false);
 }
 
+void AsyncHandler::finishAsyncTasks()
+{
+    for(auto& task: m_asyncTasks)
+        task.second->stop();
+    for(auto& task: m_asyncTasks)
+        task.second->wait();
+    m_asyncTasks.clear();
+}
+
 void AsyncHandler::updateAsyncTasks()
 {
     for(auto it = m_asyncTasks.begin(); it != m_asyncTasks.end(); it++)
@@ -51,9 +51,11 @@ namespace EGE
 class AsyncHandler
 {
 public:
+    virtual ~AsyncHandler() { finishAsyncTasks(); }
+
     virtual void addAsyncTask(SharedPtr<AsyncTask> task, std::string name = "");
 
-    // unsafe due to thread termination
+    // Stops removed tasks, their callbacks are not called.
     virtual void removeAsyncTasks(std::string name = "");
 
     virtual std::vector<std::weak_ptr<AsyncTask>> getAsyncTasks(std::string name = "");
@@ -64,6 +66,11 @@ public:
 protected:
     virtual void updateAsyncTasks();
 
+    // Stops all tasks and waits for them. Workers may use the handler, so
+    // derived classes that own data used by workers should call it in their
+    // destructors, after they made long running workers return.
+    void finishAsyncTasks();
+
 private:
     std::multimap<std::string, SharedPtr<AsyncTask>> m_asyncTasks;
 
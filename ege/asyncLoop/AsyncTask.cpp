@@ -39,51 +39,79 @@
 #include <ege/main/Config.h>
 #include <ege/util/PointerUtils.h>
 
+#include <thread>
+
 namespace EGE
 {
 
-AsyncTask::AsyncTask(std::function<int()> worker, std::function<void(AsyncTask::State)> callback)
-: m_thread(&AsyncTask::entryPoint, this), m_worker(worker), m_callback(callback) {}
+AsyncTask::AsyncTask(Worker worker, Callback callback)
+: m_worker([worker](const CancellationToken&) { return worker(); }), m_callback(callback) {}
+
+AsyncTask::AsyncTask(CancellableWorker worker, Callback callback)
+: m_worker(worker), m_callback(callback) {}
 
 AsyncTask::~AsyncTask()
 {
-    if(!m_currentState.finished)
-        m_thread.terminate();
+    if(!m_thread.joinable())
+        return;
+
+    // Last reference may be dropped by worker itself.
+    if(m_thread.get_id() == std::this_thread::get_id())
+    {
+        m_thread.detach();
+        return;
+    }
+    stop();
+    m_thread.join();
 }
 
 void AsyncTask::start()
 {
-    m_thread.launch();
+    // Thread is joined before task is destroyed, so it doesn't keep it
+    // alive (it would be never destroyed if it was running).
+    if(m_longRunning)
+    {
+        std::lock_guard<std::mutex> lock(m_threadMutex);
+        m_thread = std::thread([this]() { entryPoint(); });
+        return;
+    }
+    auto self = shared_from_this();
+    TaskExecutor::instance().submit([self]() { self->entryPoint(); }, m_priority);
 }
 
 AsyncTask::State AsyncTask::update()
 {
-    if(m_currentState.finished)
+    State state { 0, finished() };
+    if(state.finished)
     {
-        DBG(ASYNC_TASK_DEBUG, "worker finished with status " + std::to_string(m_currentState.returnCode));
-        m_callback(m_currentState);
+        state.returnCode = m_returnCode;
+        DBG(ASYNC_TASK_DEBUG, "worker finished with status " + std::to_string(state.returnCode));
+        if(m_callback)
+            m_callback(state);
     }
-    return m_currentState;
+    return state;
 }
 
 void AsyncTask::entryPoint()
 {
-    // atomic?
-    m_currentState = AsyncTask::State{m_worker(), true};
+    m_returnCode = m_worker(m_token);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_finished.store(true, std::memory_order_release);
+    }
+    m_condition.notify_all();
 }
 
 void AsyncTask::wait()
 {
-    m_thread.wait();
-}
-
-void AsyncTask::terminate()
-{
-    // it calls callback with m_currentState.finished == false
-    if(m_callback)
-        m_callback(m_currentState);
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_condition.wait(lock, [this]() { return finished(); });
+    }
 
-    m_thread.terminate();
+    std::lock_guard<std::mutex> lock(m_threadMutex);
+    if(m_thread.joinable())
+        m_thread.join();
 }
 
 }
@@ -36,10 +36,18 @@
 
 #pragma once
 
+#include "CancellationToken.h"
+#include "TaskExecutor.h"
+
 #include <ege/main/Config.h>
 #include <ege/util/PointerUtils.h>
+
+#include <atomic>
+#include <condition_variable>
 #include <functional>
-#include <SFML/System.hpp>
+#include <memory>
+#include <mutex>
+#include <thread>
 
 #define ASYNC_TASK_DEBUG 0
 
@@ -48,7 +56,7 @@ namespace EGE
 
 class AsyncLoop;
 
-class AsyncTask
+class AsyncTask : public std::enable_shared_from_this<AsyncTask>
 {
 public:
     struct State
@@ -57,24 +65,43 @@ public:
         bool finished;
     };
 
-    // WORKER runs in OTHER thread
+    typedef std::function<int()> Worker;
+    typedef std::function<int(const CancellationToken&)> CancellableWorker;
+    typedef std::function<void(State)> Callback;
+
+    // WORKER runs in OTHER thread (TaskExecutor, or own thread if task is
+    // long running)
     // CALLBACK runs in MAIN thread (The same as AsyncLoop)
     // So if you want callback to be called, you must update AsyncLoop!
-    AsyncTask(std::function<int()> worker, std::function<void(State)> callback);
+    AsyncTask(Worker worker, Callback callback);
+
+    // Worker should return as soon as token is canceled, see stop().
+    AsyncTask(CancellableWorker worker, Callback callback);
 
-    // NOTE: it calls terminate()! so it's recommended to call stop() before
-    // destroying AsyncTasks.
+    // Stops and joins thread of long running task.
     virtual ~AsyncTask();
 
+    // Task must be owned by SharedPtr, it's kept alive until worker returns
+    // (long running task is not, its destructor stops and waits for it).
     void start();
     State update();
 
-    // Safe.
-    virtual void stop() {}
+    // Cancels the token. Threads are never terminated, so worker that doesn't
+    // check it runs to the end.
+    virtual void stop() { m_token.cancel(); }
     void wait();
 
-    // Not safe!
-    void terminate();
+    const CancellationToken& getToken() const { return m_token; }
+
+    // Must be set before start().
+    void setPriority(TaskPriority priority) { m_priority = priority; }
+    TaskPriority getPriority() const { return m_priority; }
+
+    // Tasks that run for the whole program (e.g network) would occupy
+    // executor thread forever, so they get a dedicated thread. It's joined
+    // by wait().
+    void setLongRunning(bool longRunning) { m_longRunning = longRunning; }
+    bool isLongRunning() const { return m_longRunning; }
 
     void setName(std::string name)
     {
@@ -89,17 +116,25 @@ public:
 
     bool finished()
     {
-        return m_currentState.finished;
+        return m_finished.load(std::memory_order_acquire);
     }
 
 private:
     void entryPoint();
 
-    sf::Thread m_thread;
-    std::function<int()> m_worker;
-    std::function<void(State)> m_callback;
-
-    State m_currentState {0, false};
+    CancellableWorker m_worker;
+    Callback m_callback;
+    CancellationToken m_token;
+    TaskPriority m_priority = TaskPriority::Normal;
+    bool m_longRunning = false;
+
+    // Written by worker before m_finished is set.
+    int m_returnCode = 0;
+    std::atomic<bool> m_finished { false };
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::mutex m_threadMutex;
+    std::thread m_thread;
     std::string m_name;
 };
 
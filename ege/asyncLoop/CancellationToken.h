@@ -0,0 +1,84 @@
+/*
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*      ,----  ,----  ,----
+*      |      |      |
+*      |----  | --,  |----
+*      |      |   |  |
+*      '----  '---'  '----
+*
+*     Framework Library for Hexagon
+*
+*    Copyright (c) Sppmacd 2020 - 2021
+*
+*    Permission is hereby granted, free of charge, to any person obtaining a copy
+*    of this software and associated documentation files (the "Software"), to deal
+*    in the Software without restriction, including without limitation the rights
+*    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*    copies of the Software, and to permit persons to whom the Software is
+*    furnished to do so, subject to the following conditions:
+*
+*    The above copyright notice and this permission notice shall be included in all
+*    copies or substantial portions of the Software.
+*
+*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*    SOFTWARE.
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*/
+
+#pragma once
+
+#include <ege/util/PointerUtils.h>
+#include <ege/util/Types.h>
+
+#include <atomic>
+
+namespace EGE
+{
+
+// Flag that tells a background task that it should stop. Copies share the
+// flag. A token made from a parent is canceled also when the parent is.
+class CancellationToken
+{
+public:
+    CancellationToken()
+    : m_state(make<State>()) {}
+
+    static CancellationToken makeChild(const CancellationToken& parent)
+    {
+        CancellationToken token;
+        token.m_state->parent = parent.m_state;
+        return token;
+    }
+
+    void cancel() { m_state->canceled.store(true, std::memory_order_release); }
+
+    bool isCanceled() const
+    {
+        for(auto state = m_state.get(); state; state = state->parent.get())
+        {
+            if(state->canceled.load(std::memory_order_acquire))
+                return true;
+        }
+        return false;
+    }
+
+private:
+    struct State
+    {
+        std::atomic<bool> canceled { false };
+        SharedPtr<State> parent;
+    };
+
+    SharedPtr<State> m_state;
+};
+
+}
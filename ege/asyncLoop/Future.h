@@ -0,0 +1,144 @@
+/*
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*      ,----  ,----  ,----
+*      |      |      |
+*      |----  | --,  |----
+*      |      |   |  |
+*      '----  '---'  '----
+*
+*     Framework Library for Hexagon
+*
+*    Copyright (c) Sppmacd 2020 - 2021
+*
+*    Permission is hereby granted, free of charge, to any person obtaining a copy
+*    of this software and associated documentation files (the "Software"), to deal
+*    in the Software without restriction, including without limitation the rights
+*    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*    copies of the Software, and to permit persons to whom the Software is
+*    furnished to do so, subject to the following conditions:
+*
+*    The above copyright notice and this permission notice shall be included in all
+*    copies or substantial portions of the Software.
+*
+*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*    SOFTWARE.
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*/
+
+#pragma once
+
+#include "CancellationToken.h"
+
+#include <ege/main/Config.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+
+namespace EGE
+{
+
+class ThreadSafeEventLoop;
+
+// Result of ThreadSafeEventLoop::runAsync(). Task runs on TaskExecutor,
+// continuation is called by the loop that started the task.
+template<class T>
+class Future
+{
+public:
+    typedef std::function<void(Future<T>&)> Continuation;
+
+    explicit Future(CancellationToken token = {})
+    : m_token(token) {}
+
+    // Task finished and wasn't canceled before it started.
+    bool isReady() const { return m_finished.load(std::memory_order_acquire) && m_value.has_value(); }
+
+    // Task should check the token and return early. Continuation is not
+    // called if future is canceled before it's called.
+    void cancel() { m_token.cancel(); }
+    bool isCanceled() const { return m_token.isCanceled(); }
+    const CancellationToken& getToken() const { return m_token; }
+
+    // Blocks until task finished, or was skipped because of cancellation.
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_condition.wait(lock, [this]() { return m_finished.load(std::memory_order_acquire); });
+    }
+
+    template<class U = T>
+    std::enable_if_t<!std::is_void_v<U>, U&> get()
+    {
+        ASSERT(isReady());
+        return *m_value;
+    }
+
+    // Must be called from thread of the loop. If task already completed, it
+    // is called immediately.
+    void then(Continuation continuation)
+    {
+        if(!m_completed)
+        {
+            m_continuation = std::move(continuation);
+            return;
+        }
+        if(!isCanceled())
+            continuation(*this);
+    }
+
+private:
+    friend class ThreadSafeEventLoop;
+
+    // Worker thread.
+    template<class Func>
+    void run(Func& func)
+    {
+        if(!m_token.isCanceled())
+        {
+            if constexpr(std::is_void_v<T>)
+            {
+                func(m_token);
+                m_value.emplace(true);
+            }
+            else
+                m_value.emplace(func(m_token));
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_finished.store(true, std::memory_order_release);
+        }
+        m_condition.notify_all();
+    }
+
+    // Loop thread.
+    void complete()
+    {
+        m_completed = true;
+        if(m_continuation && !isCanceled())
+            m_continuation(*this);
+        m_continuation = nullptr;
+    }
+
+    CancellationToken m_token;
+    std::optional<std::conditional_t<std::is_void_v<T>, bool, T>> m_value;
+    std::atomic<bool> m_finished { false };
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_completed = false;
+    Continuation m_continuation;
+};
+
+}
@@ -0,0 +1,165 @@
+/*
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*      ,----  ,----  ,----
+*      |      |      |
+*      |----  | --,  |----
+*      |      |   |  |
+*      '----  '---'  '----
+*
+*     Framework Library for Hexagon
+*
+*    Copyright (c) Sppmacd 2020 - 2021
+*
+*    Permission is hereby granted, free of charge, to any person obtaining a copy
+*    of this software and associated documentation files (the "Software"), to deal
+*    in the Software without restriction, including without limitation the rights
+*    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*    copies of the Software, and to permit persons to whom the Software is
+*    furnished to do so, subject to the following conditions:
+*
+*    The above copyright notice and this permission notice shall be included in all
+*    copies or substantial portions of the Software.
+*
+*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*    SOFTWARE.
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*/
+
+#include "InvokeQueue.h"
+
+#include <thread>
+#include <type_traits>
+
+namespace EGE
+{
+
+// Bounded queue by Dmitry Vyukov. Each cell has a sequence number that
+// tells if it's free for push at position (sequence == position) or ready
+// to pop (sequence == position + 1).
+
+InvokeQueue::InvokeQueue(Size capacity)
+{
+    Size size = 2;
+    while(size < capacity)
+        size *= 2;
+    m_cells.reset(new Cell[size]);
+    m_mask = size - 1;
+    for(Size s = 0; s < size; s++)
+        m_cells[s].sequence.store(s, std::memory_order_relaxed);
+}
+
+void InvokeQueue::push(Function&& func)
+{
+    // Once something is in overflow, the rest must go there too to keep
+    // the order.
+    if(!m_overflowed.load(std::memory_order_acquire) && tryPush(func))
+        return;
+
+    std::lock_guard<std::mutex> lock(m_overflowMutex);
+    m_overflow.push_back(std::move(func));
+    m_overflowed.store(true, std::memory_order_release);
+}
+
+Size InvokeQueue::callAll()
+{
+    Size count = 0;
+    Function func;
+    for(;;)
+    {
+        Size lastCount = count;
+        while(tryPop(func))
+        {
+            func();
+            func.reset();
+            count++;
+        }
+
+        if(m_overflowed.load(std::memory_order_acquire))
+        {
+            std::vector<Function> overflow;
+            Size pushPosition;
+            {
+                std::lock_guard<std::mutex> lock(m_overflowMutex);
+                overflow.swap(m_overflow);
+                m_overflowed.store(false, std::memory_order_release);
+
+                // Functions that went to ring before these are below it.
+                pushPosition = m_pushPosition.load(std::memory_order_relaxed);
+            }
+
+            // They must be called first, also if producer didn't finish
+            // writing them yet, otherwise producer's order is broken.
+            typedef std::make_signed_t<Size> Diff;
+            while((Diff)(pushPosition - m_popPosition) > 0)
+            {
+                if(!tryPop(func))
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+                func();
+                func.reset();
+                count++;
+            }
+            for(auto& overflowFunc: overflow)
+            {
+                overflowFunc();
+                count++;
+            }
+        }
+
+        if(count == lastCount)
+            return count;
+    }
+}
+
+bool InvokeQueue::tryPush(Function& func)
+{
+    typedef std::make_signed_t<Size> Diff;
+    Size position = m_pushPosition.load(std::memory_order_relaxed);
+    for(;;)
+    {
+        Cell& cell = m_cells[position & m_mask];
+        Diff diff = (Diff)(cell.sequence.load(std::memory_order_acquire) - position);
+        if(diff == 0)
+        {
+            if(m_pushPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+            {
+                cell.function = std::move(func);
+                cell.sequence.store(position + 1, std::memory_order_release);
+                return true;
+            }
+        }
+        else if(diff < 0)
+            return false; // Full
+        else
+            position = m_pushPosition.load(std::memory_order_relaxed);
+    }
+}
+
+bool InvokeQueue::tryPop(Function& func)
+{
+    typedef std::make_signed_t<Size> Diff;
+    Cell& cell = m_cells[m_popPosition & m_mask];
+    Diff diff = (Diff)(cell.sequence.load(std::memory_order_acquire) - (m_popPosition + 1));
+
+    // Empty, or producer didn't finish writing the function yet.
+    if(diff < 0)
+        return false;
+
+    func = std::move(cell.function);
+    cell.sequence.store(m_popPosition + m_mask + 1, std::memory_order_release);
+    m_popPosition++;
+    return true;
+}
+
+}
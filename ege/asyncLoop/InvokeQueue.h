@@ -0,0 +1,97 @@
+/*
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*      ,----  ,----  ,----
+*      |      |      |
+*      |----  | --,  |----
+*      |      |   |  |
+*      '----  '---'  '----
+*
+*     Framework Library for Hexagon
+*
+*    Copyright (c) Sppmacd 2020 - 2021
+*
+*    Permission is hereby granted, free of charge, to any person obtaining a copy
+*    of this software and associated documentation files (the "Software"), to deal
+*    in the Software without restriction, including without limitation the rights
+*    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*    copies of the Software, and to permit persons to whom the Software is
+*    furnished to do so, subject to the following conditions:
+*
+*    The above copyright notice and this permission notice shall be included in all
+*    copies or substantial portions of the Software.
+*
+*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*    SOFTWARE.
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*/
+
+#pragma once
+
+#include <ege/util/SmallFunction.h>
+#include <ege/util/Types.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace EGE
+{
+
+// Queue of functions that any thread may push to, and only one thread
+// (owner of the queue, e.g loop thread) calls. Pushing is lock-free and
+// doesn't allocate as long as the queue is not full and the function fits
+// in SmallFunction. Functions that don't fit in full queue wait in a
+// locked overflow list, until it's emptied by callAll().
+class InvokeQueue
+{
+public:
+    typedef SmallFunction<void()> Function;
+
+    // %capacity is rounded up to power of 2.
+    explicit InvokeQueue(Size capacity = 1024);
+
+    InvokeQueue(const InvokeQueue&) = delete;
+    InvokeQueue& operator=(const InvokeQueue&) = delete;
+
+    // Functions pushed from one thread are called in order they were pushed.
+    void push(Function&& func);
+
+    // Calls all functions, including ones pushed while they are called.
+    // Returns how many functions were called. Only one thread may call it.
+    // Before overflow list is called, it may wait for producers that are
+    // in the middle of push().
+    Size callAll();
+
+    Size getCapacity() const { return m_mask + 1; }
+
+private:
+    bool tryPush(Function& func);
+    bool tryPop(Function& func);
+
+    struct alignas(64) Cell
+    {
+        std::atomic<Size> sequence;
+        Function function;
+    };
+
+    std::unique_ptr<Cell[]> m_cells;
+    Size m_mask = 0;
+    alignas(64) std::atomic<Size> m_pushPosition { 0 };
+    alignas(64) Size m_popPosition = 0;
+
+    std::atomic<bool> m_overflowed { false };
+    std::mutex m_overflowMutex;
+    std::vector<Function> m_overflow;
+};
+
+}
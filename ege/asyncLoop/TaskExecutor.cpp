@@ -0,0 +1,110 @@
+/*
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*      ,----  ,----  ,----
+*      |      |      |
+*      |----  | --,  |----
+*      |      |   |  |
+*      '----  '---'  '----
+*
+*     Framework Library for Hexagon
+*
+*    Copyright (c) Sppmacd 2020 - 2021
+*
+*    Permission is hereby granted, free of charge, to any person obtaining a copy
+*    of this software and associated documentation files (the "Software"), to deal
+*    in the Software without restriction, including without limitation the rights
+*    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*    copies of the Software, and to permit persons to whom the Software is
+*    furnished to do so, subject to the following conditions:
+*
+*    The above copyright notice and this permission notice shall be included in all
+*    copies or substantial portions of the Software.
+*
+*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*    SOFTWARE.
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*/
+
+#include "TaskExecutor.h"
+
+#include <algorithm>
+
+namespace EGE
+{
+
+TaskExecutor::TaskExecutor(Size threadCount)
+{
+    if(threadCount == 0)
+        threadCount = std::max(2u, std::thread::hardware_concurrency());
+
+    for(Size s = 0; s < threadCount; s++)
+        m_workers.emplace_back(&TaskExecutor::workerEntryPoint, this);
+}
+
+TaskExecutor::~TaskExecutor()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_condition.notify_all();
+    for(auto& worker: m_workers)
+        worker.join();
+}
+
+void TaskExecutor::submit(Task task, TaskPriority priority)
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if(m_stopping)
+        {
+            lock.unlock();
+            task();
+            return;
+        }
+        m_tasks.push_back({ priority, ++m_lastSequence, std::move(task) });
+        std::push_heap(m_tasks.begin(), m_tasks.end());
+    }
+    m_condition.notify_one();
+}
+
+Size TaskExecutor::getQueuedTaskCount()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_tasks.size();
+}
+
+TaskExecutor& TaskExecutor::instance()
+{
+    static TaskExecutor executor;
+    return executor;
+}
+
+void TaskExecutor::workerEntryPoint()
+{
+    while(true)
+    {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this]() { return m_stopping || !m_tasks.empty(); });
+            if(m_tasks.empty())
+                return;
+            std::pop_heap(m_tasks.begin(), m_tasks.end());
+            task = std::move(m_tasks.back().task);
+            m_tasks.pop_back();
+        }
+        task();
+    }
+}
+
+}
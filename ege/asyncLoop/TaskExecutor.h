@@ -0,0 +1,110 @@
+/*
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*      ,----  ,----  ,----
+*      |      |      |
+*      |----  | --,  |----
+*      |      |   |  |
+*      '----  '---'  '----
+*
+*     Framework Library for Hexagon
+*
+*    Copyright (c) Sppmacd 2020 - 2021
+*
+*    Permission is hereby granted, free of charge, to any person obtaining a copy
+*    of this software and associated documentation files (the "Software"), to deal
+*    in the Software without restriction, including without limitation the rights
+*    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*    copies of the Software, and to permit persons to whom the Software is
+*    furnished to do so, subject to the following conditions:
+*
+*    The above copyright notice and this permission notice shall be included in all
+*    copies or substantial portions of the Software.
+*
+*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*    SOFTWARE.
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*/
+
+#pragma once
+
+#include <ege/util/SmallFunction.h>
+#include <ege/util/Types.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace EGE
+{
+
+enum class TaskPriority
+{
+    Low,
+    Normal,
+    High
+};
+
+// Fixed set of worker threads that run independent background tasks
+// (loading, generation), higher priority first and in order of submission
+// otherwise. Unlike ThreadPool, it doesn't split one job between threads
+// and doesn't block the caller.
+class TaskExecutor
+{
+public:
+    typedef SmallFunction<void()> Task;
+
+    // 0 means one thread per hardware core, but at least 2.
+    explicit TaskExecutor(Size threadCount = 0);
+
+    // Runs all queued tasks before returning, so that nobody waits
+    // forever for their results (e.g at exit).
+    ~TaskExecutor();
+
+    TaskExecutor(const TaskExecutor&) = delete;
+    TaskExecutor& operator=(const TaskExecutor&) = delete;
+
+    // Tasks submitted while executor is destroyed are run immediately.
+    void submit(Task task, TaskPriority priority = TaskPriority::Normal);
+
+    Size getThreadCount() const { return m_workers.size(); }
+    Size getQueuedTaskCount();
+
+    // Shared by all loops, created on first use.
+    static TaskExecutor& instance();
+
+private:
+    struct QueuedTask
+    {
+        TaskPriority priority;
+        Size sequence;
+        Task task;
+
+        // Lower goes first out of the heap.
+        bool operator<(const QueuedTask& other) const
+        {
+            if(priority != other.priority)
+                return priority < other.priority;
+            return sequence > other.sequence;
+        }
+    };
+
+    void workerEntryPoint();
+
+    Vector<std::thread> m_workers;
+    Vector<QueuedTask> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    Size m_lastSequence = 0;
+    bool m_stopping = false;
+};
+
+}
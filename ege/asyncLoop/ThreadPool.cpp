@@ -0,0 +1,177 @@
+/*
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*      ,----  ,----  ,----
+*      |      |      |
+*      |----  | --,  |----
+*      |      |   |  |
+*      '----  '---'  '----
+*
+*     Framework Library for Hexagon
+*
+*    Copyright (c) Sppmacd 2020 - 2021
+*
+*    Permission is hereby granted, free of charge, to any person obtaining a copy
+*    of this software and associated documentation files (the "Software"), to deal
+*    in the Software without restriction, including without limitation the rights
+*    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*    copies of the Software, and to permit persons to whom the Software is
+*    furnished to do so, subject to the following conditions:
+*
+*    The above copyright notice and this permission notice shall be included in all
+*    copies or substantial portions of the Software.
+*
+*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*    SOFTWARE.
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*/
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+namespace EGE
+{
+
+ThreadPool::ThreadPool(Size threadCount)
+{
+    if(threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+    for(Size s = 0; s < threadCount; s++)
+        m_queues.push_back(std::make_unique<ChunkQueue>());
+
+    // Queue 0 belongs to the calling thread.
+    for(Size s = 1; s < threadCount; s++)
+        m_workers.emplace_back(&ThreadPool::workerEntryPoint, this, s);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_jobCondition.notify_all();
+    for(auto& worker: m_workers)
+        worker.join();
+}
+
+void ThreadPool::parallelFor(Size count, Size grainSize, const RangeFunction& function)
+{
+    if(count == 0)
+        return;
+    grainSize = std::max<Size>(grainSize, 1);
+    Size chunkCount = (count + grainSize - 1) / grainSize;
+
+    // Not worth waking up workers.
+    if(m_workers.empty() || chunkCount == 1)
+    {
+        function(0, count);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_function = &function;
+        m_count = count;
+        m_grainSize = grainSize;
+
+        Size threadCount = m_queues.size();
+        for(Size s = 0; s < threadCount; s++)
+        {
+            m_queues[s]->begin = chunkCount * s / threadCount;
+            m_queues[s]->end = chunkCount * (s + 1) / threadCount;
+        }
+        m_busyWorkers = m_workers.size();
+        m_jobGeneration++;
+    }
+    m_jobCondition.notify_all();
+
+    runChunks(0);
+
+    // Wait for workers, not only for chunks, so that nobody uses m_function
+    // after we return.
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_doneCondition.wait(lock, [this]() { return m_busyWorkers == 0; });
+    m_function = nullptr;
+}
+
+void ThreadPool::workerEntryPoint(Size queueIndex)
+{
+    Size lastGeneration = 0;
+    while(true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_jobCondition.wait(lock, [this, lastGeneration]() { return m_stopping || m_jobGeneration != lastGeneration; });
+            if(m_stopping)
+                return;
+            lastGeneration = m_jobGeneration;
+        }
+
+        runChunks(queueIndex);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(--m_busyWorkers == 0)
+            m_doneCondition.notify_one();
+    }
+}
+
+void ThreadPool::runChunks(Size queueIndex)
+{
+    Size chunk;
+    while(popChunk(queueIndex, chunk) || stealChunks(queueIndex, chunk))
+    {
+        Size begin = chunk * m_grainSize;
+        (*m_function)(begin, std::min(begin + m_grainSize, m_count));
+    }
+}
+
+bool ThreadPool::popChunk(Size queueIndex, Size& chunk)
+{
+    auto& queue = *m_queues[queueIndex];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if(queue.begin == queue.end)
+        return false;
+    chunk = queue.begin++;
+    return true;
+}
+
+bool ThreadPool::stealChunks(Size queueIndex, Size& chunk)
+{
+    Size threadCount = m_queues.size();
+    for(Size s = 1; s < threadCount; s++)
+    {
+        auto& victim = *m_queues[(queueIndex + s) % threadCount];
+        Size begin, end;
+        {
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if(victim.begin == victim.end)
+                continue;
+
+            // Take upper half, victim continues from its front.
+            end = victim.end;
+            begin = end - (end - victim.begin + 1) / 2;
+            victim.end = begin;
+        }
+
+        auto& queue = *m_queues[queueIndex];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        chunk = begin;
+        queue.begin = begin + 1;
+        queue.end = end;
+        return true;
+    }
+    return false;
+}
+
+}
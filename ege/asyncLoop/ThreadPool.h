@@ -0,0 +1,99 @@
+/*
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*      ,----  ,----  ,----
+*      |      |      |
+*      |----  | --,  |----
+*      |      |   |  |
+*      '----  '---'  '----
+*
+*     Framework Library for Hexagon
+*
+*    Copyright (c) Sppmacd 2020 - 2021
+*
+*    Permission is hereby granted, free of charge, to any person obtaining a copy
+*    of this software and associated documentation files (the "Software"), to deal
+*    in the Software without restriction, including without limitation the rights
+*    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*    copies of the Software, and to permit persons to whom the Software is
+*    furnished to do so, subject to the following conditions:
+*
+*    The above copyright notice and this permission notice shall be included in all
+*    copies or substantial portions of the Software.
+*
+*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*    SOFTWARE.
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*/
+
+#pragma once
+
+#include <ege/util/Types.h>
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace EGE
+{
+
+// Fixed set of worker threads for data-parallel jobs. The calling thread
+// takes part in every job too, so pool with N threads creates N-1 workers.
+class ThreadPool
+{
+public:
+    typedef std::function<void(Size begin, Size end)> RangeFunction;
+
+    // 0 means one thread per hardware core.
+    explicit ThreadPool(Size threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Splits [0, count) into chunks of at most %grainSize elements and calls
+    // %function for every chunk. Every thread starts with equal share of chunks,
+    // threads that finished early steal half of remaining chunks from others.
+    // Blocks until all chunks are done. Not reentrant.
+    void parallelFor(Size count, Size grainSize, const RangeFunction& function);
+
+    Size getThreadCount() const { return m_workers.size() + 1; }
+
+private:
+    // Range of chunk indices owned by a thread.
+    struct ChunkQueue
+    {
+        std::mutex mutex;
+        Size begin = 0;
+        Size end = 0;
+    };
+
+    void workerEntryPoint(Size queueIndex);
+    void runChunks(Size queueIndex);
+    bool popChunk(Size queueIndex, Size& chunk);
+    bool stealChunks(Size queueIndex, Size& chunk);
+
+    Vector<std::thread> m_workers;
+    Vector<UniquePtr<ChunkQueue>> m_queues;
+
+    std::mutex m_mutex;
+    std::condition_variable m_jobCondition;
+    std::condition_variable m_doneCondition;
+    const RangeFunction* m_function = nullptr;
+    Size m_count = 0;
+    Size m_grainSize = 1;
+    Size m_jobGeneration = 0;
+    Size m_busyWorkers = 0;
+    bool m_stopping = false;
+};
+
+}
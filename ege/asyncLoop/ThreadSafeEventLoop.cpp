@@ -39,10 +39,19 @@
 namespace EGE
 {
 
-void ThreadSafeEventLoop::addTimer(const std::string& name, SharedPtr<Timer> timer, EventLoop::TimerImmediateStart immediateStart)
+ThreadSafeEventLoop::~ThreadSafeEventLoop()
+{
+    // Workers post to m_invokeQueue, so it must outlive them.
+    m_asyncToken.cancel();
+    finishAsyncTasks();
+    std::unique_lock<std::mutex> lock(m_asyncMutex);
+    m_asyncCondition.wait(lock, [this]() { return m_runningAsyncCount == 0; });
+}
+
+TimerHandle ThreadSafeEventLoop::addTimer(const std::string& name, SharedPtr<Timer> timer, EventLoop::TimerImmediateStart immediateStart)
 {
     sf::Lock lock(m_timerMutex);
-    EventLoop::addTimer(name, timer, immediateStart);
+    return EventLoop::addTimer(name, timer, immediateStart);
 }
 
 std::vector<std::weak_ptr<Timer>> ThreadSafeEventLoop::getTimers(const std::string& timer)
@@ -50,11 +59,21 @@ std::vector<std::weak_ptr<Timer>> ThreadSafeEventLoop::getTimers(const std::stri
     sf::Lock lock(m_timerMutex);
     return EventLoop::getTimers(timer);
 }
+SharedPtr<Timer> ThreadSafeEventLoop::getTimer(TimerHandle handle)
+{
+    sf::Lock lock(m_timerMutex);
+    return EventLoop::getTimer(handle);
+}
 void ThreadSafeEventLoop::removeTimer(const std::string& timer)
 {
     sf::Lock lock(m_timerMutex);
     EventLoop::removeTimer(timer);
 }
+void ThreadSafeEventLoop::removeTimer(TimerHandle handle)
+{
+    sf::Lock lock(m_timerMutex);
+    EventLoop::removeTimer(handle);
+}
 
 void ThreadSafeEventLoop::onUpdate()
 {
@@ -64,8 +83,7 @@ void ThreadSafeEventLoop::onUpdate()
 
 void ThreadSafeEventLoop::deferredInvoke(std::function<void()> func)
 {
-    sf::Lock lock(m_timerMutex);
-    EventLoop::deferredInvoke(func);
+    m_invokeQueue.push(std::move(func));
 }
 
 void ThreadSafeEventLoop::addAsyncTask(SharedPtr<AsyncTask> task, std::string name)
@@ -74,7 +92,6 @@ void ThreadSafeEventLoop::addAsyncTask(SharedPtr<AsyncTask> task, std::string na
     AsyncHandler::addAsyncTask(task, name);
 }
 
-// unsafe due to thread termination
 void ThreadSafeEventLoop::removeAsyncTasks(std::string name)
 {
     sf::Lock lock(m_asyncTaskMutex);
@@ -94,16 +111,42 @@ void ThreadSafeEventLoop::safeRemoveAsyncTasks()
     AsyncHandler::safeRemoveAsyncTasks();
 }
 
+void ThreadSafeEventLoop::scheduleTimer(Timer& timer)
+{
+    sf::Lock lock(m_timerMutex);
+    EventLoop::scheduleTimer(timer);
+}
+
 void ThreadSafeEventLoop::updateTimers()
 {
     sf::Lock lock(m_timerMutex);
     EventLoop::updateTimers();
 }
 
+void ThreadSafeEventLoop::callDeferredInvokes()
+{
+    EventLoop::callDeferredInvokes();
+    m_invokeQueue.callAll();
+}
+
 void ThreadSafeEventLoop::updateAsyncTasks()
 {
     sf::Lock lock(m_asyncTaskMutex);
     AsyncHandler::updateAsyncTasks();
 }
 
+void ThreadSafeEventLoop::beginAsync()
+{
+    std::lock_guard<std::mutex> lock(m_asyncMutex);
+    m_runningAsyncCount++;
+}
+
+void ThreadSafeEventLoop::endAsync()
+{
+    // Notify with the lock held, destructor may return right after.
+    std::lock_guard<std::mutex> lock(m_asyncMutex);
+    m_runningAsyncCount--;
+    m_asyncCondition.notify_all();
+}
+
 }
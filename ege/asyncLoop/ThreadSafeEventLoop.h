@@ -37,10 +37,16 @@
 #pragma once
 
 #include <ege/asyncLoop/AsyncLoop.h>
+#include <ege/asyncLoop/Future.h>
+#include <ege/asyncLoop/InvokeQueue.h>
+#include <ege/asyncLoop/TaskExecutor.h>
 #include <ege/core/EventHandler.h>
+#include <condition_variable>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <SFML/System.hpp>
+#include <type_traits>
 #include <vector>
 
 namespace EGE
@@ -55,16 +61,44 @@ public:
     ThreadSafeEventLoop(String id = "ThreadSafeEventLoop")
     : AsyncLoop(id) {}
 
-    virtual void addTimer(const std::string& name, SharedPtr<Timer> timer, EventLoop::TimerImmediateStart start = EventLoop::TimerImmediateStart::Yes);
+    // Cancels tasks started with runAsync() and AsyncTasks, and waits for them.
+    virtual ~ThreadSafeEventLoop();
+
+    virtual TimerHandle addTimer(const std::string& name, SharedPtr<Timer> timer, EventLoop::TimerImmediateStart start = EventLoop::TimerImmediateStart::Yes);
     virtual std::vector<std::weak_ptr<Timer>> getTimers(const std::string& timer);
+    virtual SharedPtr<Timer> getTimer(TimerHandle handle);
     virtual void removeTimer(const std::string& timer);
+    virtual void removeTimer(TimerHandle handle);
     virtual void onUpdate();
+    // Doesn't lock, see InvokeQueue.
     virtual void deferredInvoke(std::function<void()> func);
 
+    // Like deferredInvoke(), but doesn't need std::function, so it doesn't
+    // allocate for small callables. It's the preferred way to pass data
+    // from other threads (e.g network) to the loop.
+    template<class Func>
+    void postInvoke(Func&& func) { m_invokeQueue.push(InvokeQueue::Function(std::forward<Func>(func))); }
+
+    // Runs func(const CancellationToken&) on TaskExecutor. Continuation of the
+    // returned Future is called by this loop.
+    template<class Func>
+    auto runAsync(Func func, TaskPriority priority = TaskPriority::Normal)
+    {
+        typedef std::invoke_result_t<Func&, const CancellationToken&> Result;
+        auto future = make<Future<Result>>(CancellationToken::makeChild(m_asyncToken));
+        beginAsync();
+        TaskExecutor::instance().submit([this, future, func = std::move(func)]() mutable {
+            future->run(func);
+            postInvoke([future]() { future->complete(); });
+            endAsync();
+        }, priority);
+        return future;
+    }
+
     // ASYNC TASKS
     virtual void addAsyncTask(SharedPtr<AsyncTask> task, std::string name = "");
 
-    // unsafe due to thread termination
+    // Stops removed tasks, their callbacks are not called.
     virtual void removeAsyncTasks(std::string name = "");
 
     virtual std::vector<std::weak_ptr<AsyncTask>> getAsyncTasks(std::string name = "");
@@ -74,8 +108,20 @@ protected:
     sf::Mutex m_timerMutex;
     sf::Mutex m_asyncTaskMutex;
 
+    virtual void scheduleTimer(Timer& timer);
     virtual void updateTimers();
     virtual void updateAsyncTasks();
+    virtual void callDeferredInvokes();
+
+private:
+    void beginAsync();
+    void endAsync();
+
+    InvokeQueue m_invokeQueue;
+    CancellationToken m_asyncToken;
+    std::mutex m_asyncMutex;
+    std::condition_variable m_asyncCondition;
+    Size m_runningAsyncCount = 0;
 };
 
 }
@@ -2,10 +2,18 @@
 
 #include <ege/asyncLoop/AsyncLoop.h>
 #include <ege/asyncLoop/AsyncTask.h>
+#include <ege/asyncLoop/InvokeQueue.h>
+#include <ege/asyncLoop/TaskExecutor.h>
+#include <ege/asyncLoop/ThreadPool.h>
 #include <ege/asyncLoop/ThreadSafeEventLoop.h>
 #include <ege/core/Timer.h>
 #include <ege/util/PointerUtils.h>
 #include <SFML/System.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <queue>
+#include <thread>
 
 int myWorker()
 {
@@ -81,4 +89,300 @@ TESTCASE(threadSafeEventLoop)
     return loop.run();
 }
 
+TESTCASE(threadPool)
+{
+    EGE::ThreadPool pool(4);
+    EXPECT_EQUAL(pool.getThreadCount(), 4);
+
+    // Every element must be visited exactly once, also when chunks are uneven.
+    for(size_t count: {1, 7, 1000, 100003})
+    {
+        std::vector<std::atomic<int>> visits(count);
+        pool.parallelFor(count, 64, [&visits](size_t begin, size_t end) {
+            for(size_t s = begin; s < end; s++)
+                visits[s]++;
+        });
+        bool ok = true;
+        for(auto& visit: visits)
+            ok &= (visit == 1);
+        EXPECT(ok);
+    }
+    return 0;
+}
+
+// What ThreadSafeEventLoop::deferredInvoke() did before InvokeQueue.
+struct MutexInvokeQueue
+{
+    void push(std::function<void()> func)
+    {
+        sf::Lock lock(mutex);
+        queue.push(std::move(func));
+    }
+
+    EGE::Size callAll()
+    {
+        EGE::Size count = 0;
+        for(;;)
+        {
+            std::function<void()> func;
+            {
+                sf::Lock lock(mutex);
+                if(queue.empty())
+                    return count;
+                func = std::move(queue.front());
+                queue.pop();
+            }
+            func();
+            count++;
+        }
+    }
+
+    sf::Mutex mutex;
+    std::queue<std::function<void()>> queue;
+};
+
+// If %paced, producers wait a bit between posts, so that latency is not
+// dominated by the queue being flooded.
+template<class Queue>
+static void benchmarkPosting(const char* name, Queue& queue, bool paced)
+{
+    const size_t producers = 4, perProducer = paced ? 2000 : 100000;
+    std::vector<double> latencies;
+    latencies.reserve(producers * perProducer);
+    std::vector<size_t> lastSequence(producers);
+    bool ordered = true;
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for(size_t p = 0; p < producers; p++)
+    {
+        threads.emplace_back([&, p]() {
+            for(size_t s = 1; s <= perProducer; s++)
+            {
+                auto posted = std::chrono::steady_clock::now();
+                queue.push([&, p, s, posted]() {
+                    latencies.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - posted).count());
+                    ordered &= (lastSequence[p] + 1 == s);
+                    lastSequence[p] = s;
+                });
+                if(paced)
+                    std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+        });
+    }
+    size_t called = 0;
+    while(called < producers * perProducer)
+    {
+        called += queue.callAll();
+        std::this_thread::yield();
+    }
+    for(auto& thread: threads)
+        thread.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::sort(latencies.begin(), latencies.end());
+    std::cerr << name << (paced ? " (paced)" : "") << ": " << (size_t)(called / seconds) << " posts/s, latency p50/p99: "
+              << latencies[latencies.size() / 2] << "/" << latencies[latencies.size() * 99 / 100] << " us" << std::endl;
+    EXPECT_EQUAL(called, producers * perProducer);
+    EXPECT(ordered);
+}
+
+TESTCASE(invokeQueue)
+{
+    // Small callables are stored inline.
+    int value = 0;
+    EGE::InvokeQueue::Function small = [&value]() { value++; };
+    std::array<char, 128> big {};
+    EGE::InvokeQueue::Function allocated = [&value, big]() { value += big.size(); };
+    EXPECT(!small.isAllocated());
+    EXPECT(allocated.isAllocated());
+    small();
+    allocated();
+    EXPECT_EQUAL(value, 129);
+
+    // Order is kept when queue overflows.
+    {
+        EGE::InvokeQueue queue(8);
+        std::vector<int> order;
+        for(int s = 0; s < 100; s++)
+            queue.push([&order, s]() { order.push_back(s); });
+        queue.push([&]() { queue.push([&order]() { order.push_back(100); }); });
+        EXPECT_EQUAL(queue.callAll(), 102u);
+        bool ordered = order.size() == 101;
+        for(size_t s = 0; s < order.size(); s++)
+            ordered &= (order[s] == (int)s);
+        EXPECT(ordered);
+    }
+
+    // Functions posted from other thread are called by loop.
+    {
+        EGE::ThreadSafeEventLoop loop;
+        int called = 0;
+        std::thread thread([&]() { loop.postInvoke([&called]() { called++; }); loop.deferredInvoke([&called]() { called++; }); });
+        thread.join();
+        loop.onUpdate();
+        EXPECT_EQUAL(called, 2);
+    }
+
+    for(bool paced: { false, true })
+    {
+        MutexInvokeQueue mutexQueue;
+        benchmarkPosting("sf::Mutex + std::queue<std::function>", mutexQueue, paced);
+        EGE::InvokeQueue invokeQueue;
+        benchmarkPosting("InvokeQueue", invokeQueue, paced);
+    }
+
+    // Producers keep their order also when most functions go to overflow.
+    EGE::InvokeQueue smallQueue(4);
+    benchmarkPosting("InvokeQueue (overflowing)", smallQueue, false);
+    return 0;
+}
+
+TESTCASE(taskExecutor)
+{
+    // Higher priority first, FIFO otherwise. The only worker is blocked until
+    // all tasks are queued.
+    {
+        EGE::TaskExecutor executor(1);
+        std::atomic<bool> gate { false };
+        std::atomic<int> done { 0 };
+        std::vector<int> order;
+        executor.submit([&gate]() { while(!gate) std::this_thread::yield(); });
+        executor.submit([&]() { order.push_back(0); done++; }, EGE::TaskPriority::Low);
+        executor.submit([&]() { order.push_back(1); done++; });
+        executor.submit([&]() { order.push_back(2); done++; }, EGE::TaskPriority::High);
+        executor.submit([&]() { order.push_back(3); done++; }, EGE::TaskPriority::High);
+        gate = true;
+        while(done < 4)
+            std::this_thread::yield();
+        EXPECT(order == std::vector<int>({ 2, 3, 1, 0 }));
+    }
+
+    // Queued tasks are still run when executor is destroyed.
+    {
+        std::atomic<bool> gate { false };
+        std::atomic<int> done { 0 };
+        {
+            EGE::TaskExecutor executor(1);
+            executor.submit([&gate]() { while(!gate) std::this_thread::yield(); });
+            for(int s = 0; s < 10; s++)
+                executor.submit([&done]() { done++; });
+            gate = true;
+        }
+        EXPECT_EQUAL(done, 10);
+    }
+
+    // Continuations are called by the loop.
+    {
+        EGE::ThreadSafeEventLoop loop;
+        auto future = loop.runAsync([](const EGE::CancellationToken&) { return 42; });
+        int value = 0;
+        std::thread::id continuationThread;
+        future->then([&](EGE::Future<int>& future) {
+            value = future.get();
+            continuationThread = std::this_thread::get_id();
+        });
+        future->wait();
+        EXPECT(future->isReady());
+        loop.onUpdate();
+        EXPECT_EQUAL(value, 42);
+        EXPECT(continuationThread == std::this_thread::get_id());
+
+        // Already completed, called immediately.
+        bool called = false;
+        future->then([&called](EGE::Future<int>&) { called = true; });
+        EXPECT(called);
+
+        // Canceled future doesn't call its continuation.
+        auto canceled = loop.runAsync([](const EGE::CancellationToken& token) {
+            while(!token.isCanceled())
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        });
+        called = false;
+        canceled->then([&called](EGE::Future<void>&) { called = true; });
+        canceled->cancel();
+        canceled->wait();
+        loop.onUpdate();
+        EXPECT(!called);
+
+        // Loop cancels and waits for its tasks when destroyed.
+        loop.runAsync([](const EGE::CancellationToken& token) {
+            while(!token.isCanceled())
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        });
+    }
+
+    // AsyncTask stops when asked to.
+    {
+        EGE::AsyncLoop loop;
+        int returnCode = -1;
+        auto task = make<EGE::AsyncTask>([](const EGE::CancellationToken& token) {
+            while(!token.isCanceled())
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            return 5;
+        }, [&returnCode](EGE::AsyncTask::State state) { returnCode = state.returnCode; });
+        loop.addAsyncTask(task, "cancellable");
+        EXPECT_EQUAL(loop.getAsyncTasks("cancellable").size(), 1u);
+        task->stop();
+        task->wait();
+        loop.onUpdate();
+        EXPECT_EQUAL(returnCode, 5);
+        EXPECT(loop.getAsyncTasks("cancellable").empty());
+    }
+
+    // Thread of long running task is stopped and joined with the loop.
+    {
+        std::atomic<bool> returned { false };
+        {
+            EGE::AsyncLoop loop;
+            auto task = make<EGE::AsyncTask>([&returned](const EGE::CancellationToken& token) {
+                while(!token.isCanceled())
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                returned = true;
+                return 0;
+            }, nullptr);
+            task->setLongRunning(true);
+            loop.addAsyncTask(task, "longRunning");
+        }
+        EXPECT(returned);
+    }
+
+    // Short tasks: shared executor vs thread per task (how AsyncTask worked).
+    {
+        const size_t count = 1000;
+        std::atomic<size_t> sum { 0 };
+        auto work = [&sum]() { size_t s = 0; for(size_t i = 0; i < 1000; i++) s += i; sum += s; };
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads;
+        for(size_t s = 0; s < count; s++)
+        {
+            threads.emplace_back(work);
+            if(threads.size() == 64)
+            {
+                for(auto& thread: threads)
+                    thread.join();
+                threads.clear();
+            }
+        }
+        for(auto& thread: threads)
+            thread.join();
+        double threadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        EGE::ThreadSafeEventLoop loop;
+        size_t completed = 0;
+        start = std::chrono::steady_clock::now();
+        for(size_t s = 0; s < count; s++)
+            loop.runAsync([&work](const EGE::CancellationToken&) { work(); })->then([&completed](EGE::Future<void>&) { completed++; });
+        while(completed < count)
+            loop.onUpdate();
+        double executorSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cerr << count << " tasks: thread per task " << threadSeconds * 1000 << " ms, TaskExecutor ("
+                  << EGE::TaskExecutor::instance().getThreadCount() << " threads) " << executorSeconds * 1000 << " ms" << std::endl;
+        EXPECT_EQUAL(sum.load(), 2 * count * 499500);
+    }
+    return 0;
+}
+
 RUN_TESTS(asyncLoop);
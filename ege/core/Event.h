@@ -41,6 +41,7 @@
 #define EGE_EVENT(_type) \
 public: \
     static EGE::Event::EventType type() { return _type; } \
+    static EGE::Event::TypeId typeId() { static const EGE::Event::TypeId id = EGE::Event::allocateTypeId(); return id; } \
     virtual EGE::Event::EventType getType() const override { return type(); } \
 
 #define EGE_SIMPLE_EVENT(_type, _name) \
@@ -57,8 +58,14 @@ class Event
 public:
     typedef std::string EventType;
 
+    // Index of event type in EventLoop handler list. It's assigned on first
+    // use of Evt::typeId(), so it may differ between runs.
+    typedef unsigned TypeId;
+
     virtual EGE::Event::EventType getType() const = 0;
 
+    static TypeId allocateTypeId();
+
     bool isCanceled() { return m_canceled; }
     void cancel() { m_canceled = true; }
 
@@ -66,12 +66,14 @@ public:
 
     virtual Event::EventType type() const override { return Evt::type(); }
 
+    // EventLoop calls it only with events of type Evt.
     virtual EventResult handle(Event& event) override
     {
-        auto event2 = dynamic_cast<Evt*>(&event);
-        ASSERT(event2);
+#ifndef NDEBUG
+        ASSERT(dynamic_cast<Evt*>(&event));
+#endif
         if(m_handler)
-            return m_handler(*event2);
+            return m_handler(static_cast<Evt&>(event));
         CRASH_WITH_MESSAGE("You need to give a handler or override `handle' function");
     }
 
@@ -52,12 +52,17 @@
 namespace EGE
 {
 
-EventLoop::EventArray<Event>& EventLoop::events(Event::EventType type)
+EventLoop::EventArray<Event>& EventLoop::createEventArray(Event::TypeId type)
 {
-    return m_eventHandlers[type];
+    // Arrays are allocated separately, because handlers may add
+    // new event types while they are fired.
+    if(type >= m_eventHandlers.size())
+        m_eventHandlers.resize(type + 1);
+    m_eventHandlers[type] = std::make_unique<EventArray<Event>>();
+    return *m_eventHandlers[type];
 }
 
-void EventLoop::addTimer(const std::string& name, SharedPtr<Timer> timer, EventLoop::TimerImmediateStart immediateStart)
+TimerHandle EventLoop::addTimer(const std::string& name, SharedPtr<Timer> timer, EventLoop::TimerImmediateStart immediateStart)
 {
     ASSERT(timer);
     timer->setName(name);
@@ -67,7 +72,7 @@ void EventLoop::addTimer(const std::string& name, SharedPtr<Timer> timer, EventL
         events<TimerStartEvent>().fire(event);
         if(event.isCanceled())
         {
-            return;
+            return 0;
         }
         timer->start();
     }
@@ -82,26 +87,116 @@ void EventLoop::addTimer(const std::string& name, SharedPtr<Timer> timer, EventL
             this->onTimerTick(_timer);
        });
     }
-    m_timers.insert(std::make_pair(name, timer));
+    if(!m_timerData)
+        m_timerData = std::make_unique<TimerData>();
+    TimerHandle handle = ++m_timerData->lastHandle;
+    timer->m_handle = handle;
+    m_timerData->timers.insert(std::make_pair(handle, timer));
+    m_timerData->timersByName.insert(std::make_pair(name, handle));
+    scheduleTimer(*timer);
+    return handle;
 }
 
 std::vector<std::weak_ptr<Timer>> EventLoop::getTimers(const std::string& timer)
 {
     std::vector<std::weak_ptr<Timer>> timers;
-    decltype(m_timers)::iterator it;
-    while((it = m_timers.find(timer)) != m_timers.end())
-    {
-        timers.push_back(it->second);
-    }
+    if(!m_timerData)
+        return timers;
+    auto range = m_timerData->timersByName.equal_range(timer);
+    for(auto it = range.first; it != range.second; it++)
+        timers.push_back(m_timerData->timers[it->second]);
     return timers;
 }
+
+SharedPtr<Timer> EventLoop::getTimer(TimerHandle handle)
+{
+    if(!m_timerData)
+        return nullptr;
+    auto it = m_timerData->timers.find(handle);
+    return it != m_timerData->timers.end() ? it->second : nullptr;
+}
+
 void EventLoop::removeTimer(const std::string& timer)
 {
-    decltype(m_timers)::iterator it;
-    while((it = m_timers.find(timer)) != m_timers.end())
+    if(!m_timerData)
+        return;
+    auto range = m_timerData->timersByName.equal_range(timer);
+    for(auto it = range.first; it != range.second; it++)
+    {
+        auto timerIt = m_timerData->timers.find(it->second);
+        timerIt->second->m_handle = 0;
+        timerIt->second->m_updatedEveryTick = false;
+        m_timerData->timers.erase(timerIt);
+    }
+    m_timerData->timersByName.erase(range.first, range.second);
+}
+
+void EventLoop::removeTimer(TimerHandle handle)
+{
+    if(!m_timerData)
+        return;
+    auto timerIt = m_timerData->timers.find(handle);
+    if(timerIt == m_timerData->timers.end())
+        return;
+    auto range = m_timerData->timersByName.equal_range(timerIt->second->getName());
+    for(auto it = range.first; it != range.second; it++)
+    {
+        if(it->second == handle)
+        {
+            m_timerData->timersByName.erase(it);
+            break;
+        }
+    }
+    timerIt->second->m_handle = 0;
+    timerIt->second->m_updatedEveryTick = false;
+    m_timerData->timers.erase(timerIt);
+}
+
+void EventLoop::scheduleTimer(Timer& timer)
+{
+    // Timer that has a handle is added to this loop, so m_timerData exists.
+    if(!timer.m_handle)
+        return;
+
+    if(timer.m_updateCallback)
     {
-        m_timers.erase(it);
+        if(!timer.m_updatedEveryTick)
+        {
+            timer.m_updatedEveryTick = true;
+            m_timerData->everyTickTimers.push_back(timer.m_handle);
+        }
+        return;
     }
+    if(!timer.m_started)
+        return;
+
+    // Previous entries of this timer are not valid anymore.
+    auto& queue = timer.m_interval.getUnit() == Time::Unit::Ticks ? m_timerData->tickQueue : m_timerData->secondQueue;
+    queue.push({ timer.getDeadline(), timer.m_handle, ++timer.m_scheduleGeneration });
+
+    // Timers that are restarted often leave a lot of them.
+    if(queue.size() > 64 && queue.size() > m_timerData->timers.size() * 4)
+        queue.removeIf([this](const ScheduledTimer& entry) { return !isScheduled(entry); });
+}
+
+bool EventLoop::isScheduled(const ScheduledTimer& entry)
+{
+    auto it = m_timerData->timers.find(entry.handle);
+    return it != m_timerData->timers.end() && it->second->m_scheduleGeneration == entry.generation && !it->second->m_updatedEveryTick;
+}
+
+void EventLoop::TimerQueue::push(const ScheduledTimer& timer)
+{
+    m_heap.push_back(timer);
+    std::push_heap(m_heap.begin(), m_heap.end(), std::greater<ScheduledTimer>());
+}
+
+EventLoop::ScheduledTimer EventLoop::TimerQueue::pop()
+{
+    std::pop_heap(m_heap.begin(), m_heap.end(), std::greater<ScheduledTimer>());
+    auto timer = m_heap.back();
+    m_heap.pop_back();
+    return timer;
 }
 
 void EventLoop::onUpdate()
@@ -129,41 +224,105 @@ void EventLoop::onUpdate()
 
 void EventLoop::updateTimers()
 {
-    for(auto it = m_timers.begin(); it != m_timers.end(); it++)
+    if(!m_timerData)
+        return;
+
+    auto& data = *m_timerData;
+    data.updating = true;
+    data.seconds = -1;
+
+    // Timers with update callback, e.g animations.
+    Size kept = 0;
+    for(Size s = 0; s < data.everyTickTimers.size(); s++)
     {
-        auto timer = *it;
-        if(timer.second.get()->update() == Timer::Finished::Yes)
-        {
-            TimerFinishEvent event(*timer.second);
-            events<TimerFinishEvent>().fire(event);
-            if(event.isCanceled())
-                continue;
+        auto it = data.timers.find(data.everyTickTimers[s]);
+        if(it == data.timers.end())
+            continue;
+        data.everyTickTimers[kept++] = it->first;
 
-            onTimerFinish(timer.second.get());
-            m_timers.erase(it);
+        // Callbacks may remove it from the loop.
+        auto timer = it->second;
+        if(timer->update() == Timer::Finished::Yes)
+            finishTimer(timer);
+    }
+    data.everyTickTimers.resize(kept);
 
-            if(m_timers.empty())
-                return;
+    updateDueTimers(data.tickQueue, Time::Unit::Ticks);
+    updateDueTimers(data.secondQueue, Time::Unit::Seconds);
+    data.updating = false;
+}
+
+void EventLoop::updateDueTimers(TimerQueue& queue, Time::Unit unit)
+{
+    if(queue.isEmpty())
+        return;
+
+    // Timers rescheduled in this tick wait for the next one, like before.
+    auto& dueTimers = m_timerData->dueTimers;
+    double time = timerTime(unit);
+    dueTimers.clear();
+    while(!queue.isEmpty() && queue.top().deadline <= time)
+        dueTimers.push_back(queue.pop());
 
-            it = m_timers.find(timer.first);
+    for(auto& entry: dueTimers)
+    {
+        if(!isScheduled(entry))
+            continue;
+        auto timer = m_timerData->timers[entry.handle];
+        if(timer->update() == Timer::Finished::Yes)
+        {
+            finishTimer(timer);
+            continue;
         }
+
+        // Next iteration, if callback didn't restart it.
+        if(timer->m_scheduleGeneration == entry.generation)
+            scheduleTimer(*timer);
     }
 }
 
+void EventLoop::finishTimer(SharedPtr<Timer> timer)
+{
+    TimerFinishEvent event(*timer);
+    events<TimerFinishEvent>().fire(event);
+    if(event.isCanceled())
+    {
+        scheduleTimer(*timer);
+        return;
+    }
+
+    onTimerFinish(timer.get());
+    EventLoop::removeTimer(timer->getHandle());
+}
+
 void EventLoop::deferredInvoke(std::function<void()> func)
 {
-    m_deferredInvokes.push(func);
+    m_deferredInvokes.push_back(std::move(func));
 }
 
 void EventLoop::callDeferredInvokes()
 {
+    // Functions deferred from these are called in this tick too.
     while(!m_deferredInvokes.empty())
     {
-        m_deferredInvokes.front()();
-        m_deferredInvokes.pop();
+        std::vector<std::function<void()>> invokes;
+        invokes.swap(m_deferredInvokes);
+        for(auto& func: invokes)
+            func();
     }
 }
 
+double EventLoop::timerTime(Time::Unit unit)
+{
+    if(!m_timerData || !m_timerData->updating || unit == Time::Unit::Ticks)
+        return time(unit);
+
+    // One clock sample for all timers in tick.
+    if(m_timerData->seconds < 0)
+        m_timerData->seconds = time(unit);
+    return m_timerData->seconds;
+}
+
 double EventLoop::time(Time::Unit unit)
 {
     if(unit == Time::Unit::Ticks)
@@ -42,11 +42,14 @@
 
 #include <ege/debug/InspectorNode.h>
 
+#include <algorithm>
+#include <functional>
 #include <map>
 #include <memory>
 #include <mutex>
 #include <queue>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 
 namespace EGE
@@ -129,12 +132,13 @@ public:
         bool m_inEventHandler = false;
     };
 
+    // Holds m_mutex of loop, unless thread-safe events are disabled.
     template<class EvtT>
     class LockingEventArray
     {
     public:
-        LockingEventArray(EventArray<EvtT>& array, std::mutex& mutex)
-        : m_array(array), m_lock(mutex) {}
+        LockingEventArray(EventArray<EvtT>& array, std::unique_lock<std::mutex>&& lock)
+        : m_array(array), m_lock(std::move(lock)) {}
 
         template<class Evt = EvtT>
         LockingEventArray<EvtT>& add(typename SimpleEventHandler<Evt>::Handler handler)
@@ -159,11 +163,22 @@ public:
 
     private:
         EventArray<EvtT>& m_array;
-        std::lock_guard<std::mutex> m_lock;
+        std::unique_lock<std::mutex> m_lock;
     };
 
     template<class Evt>
-    LockingEventArray<Evt> events() { return LockingEventArray<Evt>((EventArray<Evt>&)events(Evt::type()), m_mutex); }
+    LockingEventArray<Evt> events()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex, std::defer_lock);
+        if(m_threadSafeEvents)
+            lock.lock();
+        return LockingEventArray<Evt>((EventArray<Evt>&)events(Evt::typeId()), std::move(lock));
+    }
+
+    // Disable if handlers are added and events are fired only from thread
+    // of this loop, so that events() doesn't lock. Enabled by default.
+    void setThreadSafeEvents(bool threadSafe) { m_threadSafeEvents = threadSafe; }
+    bool areEventsThreadSafe() const { return m_threadSafeEvents; }
 
     template<class Evt>
     EventResult fire(Evt& evt) { return events<Evt>().fire(evt); }
@@ -174,9 +189,12 @@ public:
     virtual void onTimerFinish(Timer*) {}
     virtual void onTimerTick(Timer*) {}
 
-    virtual void addTimer(const std::string& name, SharedPtr<Timer> timer, TimerImmediateStart start = TimerImmediateStart::Yes);
+    // Returns 0 if timer was not added because TimerStartEvent was canceled.
+    virtual TimerHandle addTimer(const std::string& name, SharedPtr<Timer> timer, TimerImmediateStart start = TimerImmediateStart::Yes);
     virtual std::vector<std::weak_ptr<Timer>> getTimers(const std::string& timer);
+    virtual SharedPtr<Timer> getTimer(TimerHandle handle);
     virtual void removeTimer(const std::string& timer);
+    virtual void removeTimer(TimerHandle handle);
     virtual void onUpdate();
     virtual void deferredInvoke(std::function<void()> func);
 
@@ -184,6 +202,10 @@ public:
     // it should be used ONLY for comparisions
     virtual double time(Time::Unit unit);
 
+    // Time used by timers. It's sampled once per tick while timers are
+    // updated, and the same as time() otherwise.
+    double timerTime(Time::Unit unit);
+
     virtual int run();
 
     virtual void exit(int exitCode = 0);
@@ -194,6 +216,12 @@ public:
     virtual void removeSubLoop(EventLoop& loop);
 
 protected:
+    friend class Timer;
+
+    // Called when timer is started or its update callback changes.
+    virtual void scheduleTimer(Timer& timer);
+
+    // Only timers that are due, and timers with update callback are updated.
     virtual void updateTimers();
     virtual void callDeferredInvokes();
     bool m_running = true;
@@ -201,13 +229,70 @@ protected:
     SharedPtrVector<EventLoop> m_subLoops;
 
 private:
-    EventArray<Event>& events(Event::EventType type);
+    EventArray<Event>& events(Event::TypeId type)
+    {
+        if(type < m_eventHandlers.size() && m_eventHandlers[type])
+            return *m_eventHandlers[type];
+        return createEventArray(type);
+    }
+    EventArray<Event>& createEventArray(Event::TypeId type);
+
+    struct ScheduledTimer
+    {
+        double deadline;
+        TimerHandle handle;
+        Uint64 generation;
+
+        bool operator>(const ScheduledTimer& other) const { return deadline > other.deadline; }
+    };
+
+    // Min-heap by deadline. Entries of timers that were removed or
+    // rescheduled are skipped when they get to the top.
+    class TimerQueue
+    {
+    public:
+        void push(const ScheduledTimer& timer);
+        ScheduledTimer pop();
+        const ScheduledTimer& top() const { return m_heap.front(); }
+        bool isEmpty() const { return m_heap.empty(); }
+        Size size() const { return m_heap.size(); }
+
+        template<class Pred>
+        void removeIf(Pred pred)
+        {
+            m_heap.erase(std::remove_if(m_heap.begin(), m_heap.end(), pred), m_heap.end());
+            std::make_heap(m_heap.begin(), m_heap.end(), std::greater<ScheduledTimer>());
+        }
+
+    private:
+        std::vector<ScheduledTimer> m_heap;
+    };
+
+    void updateDueTimers(TimerQueue& queue, Time::Unit unit);
+    void finishTimer(SharedPtr<Timer> timer);
+    bool isScheduled(const ScheduledTimer& entry);
+
+    // Most loops (e.g scene objects and widgets) never get a timer, so
+    // it's allocated when the first one is added.
+    struct TimerData
+    {
+        TimerHandle lastHandle = 0;
+        std::unordered_map<TimerHandle, SharedPtr<Timer>> timers;
+        std::multimap<std::string, TimerHandle> timersByName;
+        TimerQueue tickQueue;
+        TimerQueue secondQueue;
+        std::vector<TimerHandle> everyTickTimers;
+        std::vector<ScheduledTimer> dueTimers;
+        bool updating = false;
+        double seconds = -1;
+    };
 
     int m_ticks = 0;
-    std::multimap<std::string, SharedPtr<Timer>> m_timers;
-    Map<Event::EventType, EventArray<Event>> m_eventHandlers;
-    std::queue<std::function<void()>> m_deferredInvokes;
+    UniquePtr<TimerData> m_timerData;
+    std::vector<UniquePtr<EventArray<Event>>> m_eventHandlers;
+    std::vector<std::function<void()>> m_deferredInvokes;
     std::mutex m_mutex;
+    bool m_threadSafeEvents = true;
 };
 
 }
@@ -48,15 +48,23 @@ namespace EGE
 
 void Timer::start()
 {
-    m_startTime = m_loop.time(m_interval.getUnit());
+    m_startTime = m_loop.timerTime(m_interval.getUnit());
     m_started = true;
     m_iterations = 0;
     m_remainingIterations = m_iterations + 1;
+    m_loop.scheduleTimer(*this);
 }
 void Timer::stop()
 {
     m_started = false;
 }
+Timer& Timer::setUpdateCallback(Callback func)
+{
+    m_updateCallback = func;
+    m_loop.scheduleTimer(*this);
+    return *this;
+}
+
 Timer::Finished Timer::update()
 {
     DUMP(TIMER_DEBUG, m_name);
@@ -65,7 +73,8 @@ Timer::Finished Timer::update()
     DUMP(TIMER_DEBUG, (long long)m_startTime);
     DUMP(TIMER_DEBUG, m_interval.getUnit() == Time::Unit::Ticks);
 
-    double time = m_loop.time(m_interval.getUnit());
+    // Sampled once per tick while loop updates timers.
+    double time = m_loop.timerTime(m_interval.getUnit());
     DUMP(TIMER_DEBUG, (long long)time);
 
     if(m_updateCallback)
@@ -96,7 +105,7 @@ Timer::Finished Timer::update()
 }
 Time Timer::getElapsedTime()
 {
-    return Time(m_loop.time(m_interval.getUnit()) - m_startTime, m_interval.getUnit());
+    return Time(m_loop.timerTime(m_interval.getUnit()) - m_startTime, m_interval.getUnit());
 }
 void Timer::restart()
 {
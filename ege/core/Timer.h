@@ -49,6 +49,10 @@ namespace EGE
 
 class EventLoop;
 
+// Returned by EventLoop::addTimer(). Identifies timer in its loop, 0 is
+// invalid.
+typedef Uint64 TimerHandle;
+
 class Timer
 {
 public:
@@ -79,11 +83,9 @@ public:
         return *this;
     }
 
-    Timer& setUpdateCallback(Callback func)
-    {
-        m_updateCallback = func;
-        return *this;
-    }
+    // Timers with update callback are updated every tick, others only
+    // when they are due.
+    Timer& setUpdateCallback(Callback func);
 
     Timer& setName(std::string name)
     {
@@ -103,6 +105,12 @@ public:
     bool isStarted() { return m_started; }
     Time getInterval() { return m_interval; }
 
+    // When timer will fire next time, in unit of interval.
+    double getDeadline() const { return m_startTime + m_interval.getValue(); }
+
+    // 0 if timer is not added to loop.
+    TimerHandle getHandle() const { return m_handle; }
+
     Time getElapsedTime();
 
     EventLoop& getLoop() { return m_loop; }
@@ -122,6 +130,13 @@ protected:
     std::string m_name;
     size_t m_iterations = 0;
     size_t m_remainingIterations = 1;
+
+private:
+    friend class EventLoop;
+
+    TimerHandle m_handle = 0;
+    Uint64 m_scheduleGeneration = 0;
+    bool m_updatedEveryTick = false;
 };
 
 }
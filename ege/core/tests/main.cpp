@@ -5,6 +5,7 @@
 #include <ege/debug/Logger.h>
 #include <ege/util/ObjectSerializers.h>
 #include <ege/util/Types.h>
+#include <chrono>
 #include <iostream>
 
 using EGE::Time;
@@ -98,6 +99,43 @@ TESTCASE(_eventPerfTest_3Handlers)
     return 0;
 }
 
+TESTCASE(eventDispatch)
+{
+    for(bool threadSafe: { true, false })
+    {
+        EGE::EventLoop loop;
+        loop.setThreadSafeEvents(threadSafe);
+        size_t handled = 0;
+        loop.events<TickEvent>().add([&handled](TickEvent&) { handled++; return EGE::EventResult::Success; });
+
+        const size_t count = 1000000;
+        auto start = std::chrono::steady_clock::now();
+        for(size_t s = 0; s < count; s++)
+            loop.fire<TickEvent>(s);
+        auto time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        std::cerr << "fire (" << (threadSafe ? "locking" : "not locking") << "): " << (double)time / count << " ns" << std::endl;
+        EXPECT_EQUAL(handled, count);
+    }
+
+    // Events of other types don't reach the handler, even if they are
+    // fired from inside it.
+    EGE::EventLoop loop;
+    size_t ticks = 0, timers = 0;
+    loop.events<TickEvent>().add([&](TickEvent&) {
+        ticks++;
+        Timer timer(loop, Timer::Mode::Limited, 1.0);
+        loop.fire<EGE::TimerTickEvent>(timer);
+        return EGE::EventResult::Success;
+    });
+    loop.setThreadSafeEvents(false);
+    loop.events<EGE::TimerTickEvent>().add([&](EGE::TimerTickEvent&) { timers++; return EGE::EventResult::Success; });
+    loop.fire<TickEvent>(0);
+    EXPECT_EQUAL(ticks, 1u);
+    EXPECT_EQUAL(timers, 1u);
+    EXPECT(TickEvent::typeId() != EGE::TimerTickEvent::typeId());
+    return 0;
+}
+
 class MyGameLoop2 : public MyGameLoop
 {
 public:
@@ -160,6 +198,77 @@ TESTCASE(time)
     return loop.run();
 }
 
+class CountingTimer : public Timer
+{
+public:
+    CountingTimer(EGE::EventLoop& loop)
+    : Timer(loop, Timer::Mode::Limited, Time(2, Time::Unit::Ticks)) {}
+
+    virtual Finished update() override
+    {
+        updates++;
+        return Timer::update();
+    }
+
+    size_t updates = 0;
+};
+
+TESTCASE(timerScheduler)
+{
+    EGE::EventLoop loop;
+
+    // Many idle timers shouldn't be touched every tick.
+    size_t fired = 0;
+    for(size_t s = 0; s < 50000; s++)
+        loop.addTimer("idle", make<Timer>(loop, Timer::Mode::Limited, Time(1000000, Time::Unit::Ticks), [&fired](std::string, Timer*) { fired++; }));
+
+    size_t limited = 0, infinite = 0, updates = 0;
+    loop.addTimer("limited", make<Timer>(loop, Timer::Mode::Limited, Time(5, Time::Unit::Ticks), [&limited](std::string, Timer*) { limited++; }));
+    auto infiniteHandle = loop.addTimer("infinite", make<Timer>(loop, Timer::Mode::Infinite, Time(2, Time::Unit::Ticks), [&infinite](std::string, Timer*) { infinite++; }));
+    auto removed = loop.addTimer("removed", make<Timer>(loop, Timer::Mode::Limited, Time(3, Time::Unit::Ticks), [&fired](std::string, Timer*) { fired++; }));
+    auto stopped = make<Timer>(loop, Timer::Mode::Limited, Time(3, Time::Unit::Ticks), [&fired](std::string, Timer*) { fired++; });
+    loop.addTimer("stopped", stopped);
+    auto updated = make<Timer>(loop, Timer::Mode::Limited, Time(4, Time::Unit::Ticks));
+    updated->setUpdateCallback([&updates](std::string, Timer*) { updates++; });
+    loop.addTimer("updated", updated);
+    auto counting = make<CountingTimer>(loop);
+    loop.addTimer("counting", counting);
+
+    EXPECT(infiniteHandle != removed);
+    EXPECT(loop.getTimer(removed));
+    loop.removeTimer(removed);
+    EXPECT(!loop.getTimer(removed));
+    stopped->stop();
+
+    auto start = std::chrono::steady_clock::now();
+    for(size_t s = 0; s < 10; s++)
+        loop.onUpdate();
+    auto time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << "10 ticks with 50000 idle timers: " << time << " us" << std::endl;
+
+    EXPECT_EQUAL(fired, 0u);
+    EXPECT_EQUAL(limited, 1u);
+    EXPECT_EQUAL(infinite, 4u);
+    EXPECT_EQUAL(updates, 5u);
+    EXPECT(loop.getTimers("limited").empty());
+    EXPECT(loop.getTimers("updated").empty());
+    EXPECT_EQUAL(counting->updates, 1u);
+    EXPECT_EQUAL(loop.getTimers("idle").size(), 50000u);
+
+    // Restarting reschedules from current tick.
+    stopped->start();
+    for(size_t s = 0; s < 4; s++)
+        loop.onUpdate();
+    EXPECT_EQUAL(fired, 1u);
+
+    loop.removeTimer("idle");
+    loop.removeTimer(infiniteHandle);
+    EXPECT(loop.getTimers("idle").empty());
+    loop.onUpdate();
+    EXPECT_EQUAL(infinite, 6u);
+    return 0;
+}
+
 TESTCASE(dataManager)
 {
     {
@@ -37,11 +37,15 @@
 #pragma once
 
 #include <ege/egeNetwork/ClientNetworkController.h>
+#include <ege/egeNetwork/CompactEncoding.h>
+#include <ege/egeNetwork/Compression.h>
 #include <ege/egeNetwork/EGEClientConnection.h>
 #include <ege/egeNetwork/EGEClient.h>
 #include <ege/egeNetwork/EGEGame.h>
 #include <ege/egeNetwork/EGEPacketConverter.h>
 #include <ege/egeNetwork/EGEPacket.h>
 #include <ege/egeNetwork/EGEServer.h>
+#include <ege/egeNetwork/InterpolationBuffer.h>
 #include <ege/egeNetwork/ServerNetworkController.h>
+#include <ege/egeNetwork/UnreliableChannel.h>
 
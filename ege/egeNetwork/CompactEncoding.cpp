@@ -0,0 +1,421 @@
+/*
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*      ,----  ,----  ,----
+*      |      |      |
+*      |----  | --,  |----
+*      |      |   |  |
+*      '----  '---'  '----
+*
+*     Framework Library for Hexagon
+*
+*    Copyright (c) Sppmacd 2020 - 2021
+*
+*    Permission is hereby granted, free of charge, to any person obtaining a copy
+*    of this software and associated documentation files (the "Software"), to deal
+*    in the Software without restriction, including without limitation the rights
+*    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*    copies of the Software, and to permit persons to whom the Software is
+*    furnished to do so, subject to the following conditions:
+*
+*    The above copyright notice and this permission notice shall be included in all
+*    copies or substantial portions of the Software.
+*
+*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*    SOFTWARE.
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*/
+#include "CompactEncoding.h"
+
+#include <cmath>
+
+namespace EGE
+{
+
+namespace CompactEncoding
+{
+
+namespace
+{
+
+enum MainStateFlags
+{
+    HasMotion = 1,
+    HasPitchRoll = 2,
+    HasModes = 4,
+    HasLayer = 8,
+    HasParent = 16
+};
+
+Uint64 zigzag(Int64 value)
+{
+    return ((Uint64)value << 1) ^ (Uint64)(value >> 63);
+}
+
+Int64 unzigzag(Uint64 value)
+{
+    return (Int64)(value >> 1) ^ -(Int64)(value & 1);
+}
+
+Int64 quantize(double value, double step)
+{
+    return std::llround(value / step);
+}
+
+Uint16 quantizeAngle(double value)
+{
+    double normalized = std::fmod(value, 360.0);
+    if(normalized < 0)
+        normalized += 360.0;
+    return (Uint16)((Uint32)std::lround(normalized / 360.0 * 65536) & 0xFFFF);
+}
+
+double dequantizeAngle(Uint16 value)
+{
+    return value * 360.0 / 65536;
+}
+
+Uint8 packModes(const SceneObject::MainState& state)
+{
+    return state.yawMode | (state.pitchMode << 2) | (state.rollMode << 4);
+}
+
+void unpackModes(Uint8 modes, SceneObject::MainState& state)
+{
+    state.yawMode = (SceneObject::RotationMode)(modes & 3);
+    state.pitchMode = (SceneObject::RotationMode)((modes >> 2) & 3);
+    state.rollMode = (SceneObject::RotationMode)((modes >> 4) & 3);
+}
+
+bool readLayer(sf::Packet& packet, int& layer)
+{
+    Int64 value;
+    if(!readVarInt(packet, value))
+        return false;
+    layer = value;
+    return true;
+}
+
+}
+
+void writeVarUint(sf::Packet& packet, Uint64 value)
+{
+    Uint8 buffer[10];
+    Size size = 0;
+    do
+    {
+        Uint8 byte = value & 0x7F;
+        value >>= 7;
+        buffer[size++] = byte | (value ? 0x80 : 0);
+    } while(value);
+    packet.append(buffer, size);
+}
+
+void writeVarUint(Vector<Uint8>& buffer, Uint64 value)
+{
+    do
+    {
+        Uint8 byte = value & 0x7F;
+        value >>= 7;
+        buffer.push_back(byte | (value ? 0x80 : 0));
+    } while(value);
+}
+
+bool readVarUint(const Uint8*& data, const Uint8* end, Uint64& value)
+{
+    value = 0;
+    for(Size shift = 0; shift < 64 && data < end; shift += 7)
+    {
+        Uint8 byte = *data++;
+        value |= (Uint64)(byte & 0x7F) << shift;
+        if(!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+bool readVarUint(sf::Packet& packet, Uint64& value)
+{
+    value = 0;
+    for(Size shift = 0; shift < 64; shift += 7)
+    {
+        Uint8 byte;
+        if(!(packet >> byte))
+            return false;
+        value |= (Uint64)(byte & 0x7F) << shift;
+        if(!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+void writeVarInt(sf::Packet& packet, Int64 value)
+{
+    writeVarUint(packet, zigzag(value));
+}
+
+bool readVarInt(sf::Packet& packet, Int64& value)
+{
+    Uint64 encoded;
+    if(!readVarUint(packet, encoded))
+        return false;
+    value = unzigzag(encoded);
+    return true;
+}
+
+void writeQuantized(sf::Packet& packet, double value, double step)
+{
+    writeVarInt(packet, quantize(value, step));
+}
+
+bool readQuantized(sf::Packet& packet, double& value, double step)
+{
+    Int64 encoded;
+    if(!readVarInt(packet, encoded))
+        return false;
+    value = encoded * step;
+    return true;
+}
+
+void writeExact(sf::Packet& packet, double value, double step)
+{
+    // Even varint is value / step, odd one is followed by double.
+    if(std::abs(value / step) < (double)(1ll << 52))
+    {
+        Int64 quantized = quantize(value, step);
+        if(quantized * step == value)
+        {
+            writeVarInt(packet, quantized * 2);
+            return;
+        }
+    }
+    writeVarInt(packet, 1);
+    packet << value;
+}
+
+bool readExact(sf::Packet& packet, double& value, double step)
+{
+    Int64 encoded;
+    if(!readVarInt(packet, encoded))
+        return false;
+    if(encoded & 1)
+        return encoded == 1 && (packet >> value);
+    value = encoded / 2 * step;
+    return true;
+}
+
+void writeVector(sf::Packet& packet, const Vec3d& value, double step)
+{
+    writeQuantized(packet, value.x, step);
+    writeQuantized(packet, value.y, step);
+    writeQuantized(packet, value.z, step);
+}
+
+bool readVector(sf::Packet& packet, Vec3d& value, double step)
+{
+    return readQuantized(packet, value.x, step)
+        && readQuantized(packet, value.y, step)
+        && readQuantized(packet, value.z, step);
+}
+
+void writeAngle(sf::Packet& packet, double value)
+{
+    packet << (sf::Uint16)quantizeAngle(value);
+}
+
+bool readAngle(sf::Packet& packet, double& value)
+{
+    sf::Uint16 encoded;
+    if(!(packet >> encoded))
+        return false;
+    value = dequantizeAngle(encoded);
+    return true;
+}
+
+void writeMainState(sf::Packet& packet, const SceneObject::MainState& state)
+{
+    Uint64 flags = 0;
+    if(state.motion.x != 0 || state.motion.y != 0 || state.motion.z != 0)
+        flags |= HasMotion;
+    if(state.pitch != 0 || state.roll != 0)
+        flags |= HasPitchRoll;
+    if(state.yawMode != SceneObject::Inherit || state.pitchMode != SceneObject::Inherit || state.rollMode != SceneObject::Inherit)
+        flags |= HasModes;
+    if(state.layer != 0)
+        flags |= HasLayer;
+    if(!state.parent.empty())
+        flags |= HasParent;
+
+    writeVarUint(packet, flags);
+    writeVector(packet, state.position, PositionStep);
+    if(flags & HasMotion)
+    {
+        writeExact(packet, state.motion.x, MotionStep);
+        writeExact(packet, state.motion.y, MotionStep);
+        writeExact(packet, state.motion.z, MotionStep);
+    }
+    writeAngle(packet, state.yaw);
+    if(flags & HasPitchRoll)
+    {
+        writeAngle(packet, state.pitch);
+        writeAngle(packet, state.roll);
+    }
+    if(flags & HasModes)
+        packet << (sf::Uint8)packModes(state);
+    if(flags & HasLayer)
+        writeVarInt(packet, state.layer);
+    if(flags & HasParent)
+        packet << state.parent;
+}
+
+bool readMainState(sf::Packet& packet, SceneObject::MainState& state)
+{
+    state = {};
+
+    Uint64 flags;
+    if(!readVarUint(packet, flags))
+        return false;
+    if(!readVector(packet, state.position, PositionStep))
+        return false;
+    if((flags & HasMotion) && !(readExact(packet, state.motion.x, MotionStep)
+                                && readExact(packet, state.motion.y, MotionStep)
+                                && readExact(packet, state.motion.z, MotionStep)))
+        return false;
+    if(!readAngle(packet, state.yaw))
+        return false;
+    if((flags & HasPitchRoll) && !(readAngle(packet, state.pitch) && readAngle(packet, state.roll)))
+        return false;
+    if(flags & HasModes)
+    {
+        sf::Uint8 modes;
+        if(!(packet >> modes))
+            return false;
+        unpackModes(modes, state);
+    }
+    if((flags & HasLayer) && !readLayer(packet, state.layer))
+        return false;
+    if((flags & HasParent) && !(packet >> state.parent))
+        return false;
+    return true;
+}
+
+SceneObject::MainState quantizeMainState(const SceneObject::MainState& state)
+{
+    SceneObject::MainState result = state;
+    auto quantizeVector = [](Vec3d& value, double step) {
+        value.x = quantize(value.x, step) * step;
+        value.y = quantize(value.y, step) * step;
+        value.z = quantize(value.z, step) * step;
+    };
+    quantizeVector(result.position, PositionStep);
+    result.yaw = dequantizeAngle(quantizeAngle(state.yaw));
+    result.pitch = dequantizeAngle(quantizeAngle(state.pitch));
+    result.roll = dequantizeAngle(quantizeAngle(state.roll));
+    return result;
+}
+
+Uint32 diffMainState(const SceneObject::MainState& state, const SceneObject::MainState& baseline)
+{
+    Uint32 mask = 0;
+    auto diff = [&mask](double value, double base, double step, Uint32 bit) {
+        if(quantize(value, step) != quantize(base, step))
+            mask |= bit;
+    };
+    auto diffAngle = [&mask](double value, double base, Uint32 bit) {
+        if(quantizeAngle(value) != quantizeAngle(base))
+            mask |= bit;
+    };
+    diff(state.position.x, baseline.position.x, PositionStep, DeltaPositionX);
+    diff(state.position.y, baseline.position.y, PositionStep, DeltaPositionY);
+    diff(state.position.z, baseline.position.z, PositionStep, DeltaPositionZ);
+    if(state.motion.x != baseline.motion.x) mask |= DeltaMotionX;
+    if(state.motion.y != baseline.motion.y) mask |= DeltaMotionY;
+    if(state.motion.z != baseline.motion.z) mask |= DeltaMotionZ;
+    diffAngle(state.yaw, baseline.yaw, DeltaYaw);
+    diffAngle(state.pitch, baseline.pitch, DeltaPitch);
+    diffAngle(state.roll, baseline.roll, DeltaRoll);
+    if(packModes(state) != packModes(baseline))
+        mask |= DeltaModes;
+    if(state.layer != baseline.layer)
+        mask |= DeltaLayer;
+    if(state.parent != baseline.parent)
+        mask |= DeltaParent;
+    return mask;
+}
+
+void writeMainStateDelta(sf::Packet& packet, const SceneObject::MainState& state, Uint32 mask)
+{
+    writeVarUint(packet, mask);
+    if(mask & DeltaPositionX) writeQuantized(packet, state.position.x, PositionStep);
+    if(mask & DeltaPositionY) writeQuantized(packet, state.position.y, PositionStep);
+    if(mask & DeltaPositionZ) writeQuantized(packet, state.position.z, PositionStep);
+    if(mask & DeltaMotionX) writeExact(packet, state.motion.x, MotionStep);
+    if(mask & DeltaMotionY) writeExact(packet, state.motion.y, MotionStep);
+    if(mask & DeltaMotionZ) writeExact(packet, state.motion.z, MotionStep);
+    if(mask & DeltaYaw) writeAngle(packet, state.yaw);
+    if(mask & DeltaPitch) writeAngle(packet, state.pitch);
+    if(mask & DeltaRoll) writeAngle(packet, state.roll);
+    if(mask & DeltaModes) packet << (sf::Uint8)packModes(state);
+    if(mask & DeltaLayer) writeVarInt(packet, state.layer);
+    if(mask & DeltaParent) packet << state.parent;
+}
+
+bool readMainStateDelta(sf::Packet& packet, SceneObject::MainState& state, Uint32& mask)
+{
+    Uint64 encodedMask;
+    if(!readVarUint(packet, encodedMask) || encodedMask > DeltaAll)
+        return false;
+    mask = encodedMask;
+    if((mask & DeltaPositionX) && !readQuantized(packet, state.position.x, PositionStep)) return false;
+    if((mask & DeltaPositionY) && !readQuantized(packet, state.position.y, PositionStep)) return false;
+    if((mask & DeltaPositionZ) && !readQuantized(packet, state.position.z, PositionStep)) return false;
+    if((mask & DeltaMotionX) && !readExact(packet, state.motion.x, MotionStep)) return false;
+    if((mask & DeltaMotionY) && !readExact(packet, state.motion.y, MotionStep)) return false;
+    if((mask & DeltaMotionZ) && !readExact(packet, state.motion.z, MotionStep)) return false;
+    if((mask & DeltaYaw) && !readAngle(packet, state.yaw)) return false;
+    if((mask & DeltaPitch) && !readAngle(packet, state.pitch)) return false;
+    if((mask & DeltaRoll) && !readAngle(packet, state.roll)) return false;
+    if(mask & DeltaModes)
+    {
+        sf::Uint8 modes;
+        if(!(packet >> modes))
+            return false;
+        unpackModes(modes, state);
+    }
+    if((mask & DeltaLayer) && !readLayer(packet, state.layer)) return false;
+    if((mask & DeltaParent) && !(packet >> state.parent)) return false;
+    return true;
+}
+
+void mergeMainState(SceneObject::MainState& target, const SceneObject::MainState& source, Uint32 mask)
+{
+    if(mask & DeltaPositionX) target.position.x = source.position.x;
+    if(mask & DeltaPositionY) target.position.y = source.position.y;
+    if(mask & DeltaPositionZ) target.position.z = source.position.z;
+    if(mask & DeltaMotionX) target.motion.x = source.motion.x;
+    if(mask & DeltaMotionY) target.motion.y = source.motion.y;
+    if(mask & DeltaMotionZ) target.motion.z = source.motion.z;
+    if(mask & DeltaYaw) target.yaw = source.yaw;
+    if(mask & DeltaPitch) target.pitch = source.pitch;
+    if(mask & DeltaRoll) target.roll = source.roll;
+    if(mask & DeltaModes)
+    {
+        target.yawMode = source.yawMode;
+        target.pitchMode = source.pitchMode;
+        target.rollMode = source.rollMode;
+    }
+    if(mask & DeltaLayer) target.layer = source.layer;
+    if(mask & DeltaParent) target.parent = source.parent;
+}
+
+}
+
+}
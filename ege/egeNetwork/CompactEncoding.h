@@ -0,0 +1,134 @@
+/*
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*      ,----  ,----  ,----
+*      |      |      |
+*      |----  | --,  |----
+*      |      |   |  |
+*      '----  '---'  '----
+*
+*     Framework Library for Hexagon
+*
+*    Copyright (c) Sppmacd 2020 - 2021
+*
+*    Permission is hereby granted, free of charge, to any person obtaining a copy
+*    of this software and associated documentation files (the "Software"), to deal
+*    in the Software without restriction, including without limitation the rights
+*    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*    copies of the Software, and to permit persons to whom the Software is
+*    furnished to do so, subject to the following conditions:
+*
+*    The above copyright notice and this permission notice shall be included in all
+*    copies or substantial portions of the Software.
+*
+*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*    SOFTWARE.
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*/
+
+#pragma once
+
+#include <ege/scene/SceneObject.h>
+#include <ege/util/Types.h>
+#include <ege/util/Vector.h>
+
+#include <SFML/Network.hpp>
+
+namespace EGE
+{
+
+// Key-less binary encoding used by egeNetwork for frequent packets (protocol
+// version 1 and newer). Integers are LEB128 varints (signed ones zigzag-encoded),
+// positions are fixed-point, motion is exact and angles are 16-bit.
+namespace CompactEncoding
+{
+
+// Precision of quantized values.
+const double PositionStep = 1.0 / 256;
+
+// Motion is not rounded, because receivers integrate it every tick. Its
+// multiples take a short varint, other values a double.
+const double MotionStep = 1.0 / 4096;
+
+void writeVarUint(sf::Packet& packet, Uint64 value);
+bool readVarUint(sf::Packet& packet, Uint64& value);
+
+// Raw buffer versions. Reading advances %data, and doesn't go past %end.
+void writeVarUint(Vector<Uint8>& buffer, Uint64 value);
+bool readVarUint(const Uint8*& data, const Uint8* end, Uint64& value);
+
+void writeVarInt(sf::Packet& packet, Int64 value);
+bool readVarInt(sf::Packet& packet, Int64& value);
+
+void writeQuantized(sf::Packet& packet, double value, double step);
+bool readQuantized(sf::Packet& packet, double& value, double step);
+
+// Like writeQuantized(), but values that are not multiples of %step are
+// written as double instead of being rounded.
+void writeExact(sf::Packet& packet, double value, double step);
+bool readExact(sf::Packet& packet, double& value, double step);
+
+void writeVector(sf::Packet& packet, const Vec3d& value, double step);
+bool readVector(sf::Packet& packet, Vec3d& value, double step);
+
+// Degrees, stored modulo 360.
+void writeAngle(sf::Packet& packet, double value);
+bool readAngle(sf::Packet& packet, double& value);
+
+// Layout:
+//   varint   flags (see below)
+//   vector   position
+//   exact    motion x,y,z   if HasMotion
+//   angle    yaw
+//   angle    pitch, roll    if HasPitchRoll
+//   Uint8    rotation modes if HasModes (2 bits per mode)
+//   varint   layer          if HasLayer
+//   string   parent         if HasParent
+void writeMainState(sf::Packet& packet, const SceneObject::MainState& state);
+bool readMainState(sf::Packet& packet, SceneObject::MainState& state);
+
+// Delta updates (protocol 2+). Mask has one bit per MainState field; only
+// these fields are written, in the order of bits:
+//   position x,y,z; motion x,y,z; yaw; pitch; roll; modes; layer; parent
+enum DeltaField : Uint32
+{
+    DeltaPositionX = 1 << 0,
+    DeltaPositionY = 1 << 1,
+    DeltaPositionZ = 1 << 2,
+    DeltaMotionX = 1 << 3,
+    DeltaMotionY = 1 << 4,
+    DeltaMotionZ = 1 << 5,
+    DeltaYaw = 1 << 6,
+    DeltaPitch = 1 << 7,
+    DeltaRoll = 1 << 8,
+    DeltaModes = 1 << 9,
+    DeltaLayer = 1 << 10,
+    DeltaParent = 1 << 11,
+    DeltaAll = (1 << 12) - 1
+};
+
+// State as seen by receiver after encoding and decoding.
+SceneObject::MainState quantizeMainState(const SceneObject::MainState& state);
+
+// Fields that differ after quantization. %baseline should be quantized.
+Uint32 diffMainState(const SceneObject::MainState& state, const SceneObject::MainState& baseline);
+
+void writeMainStateDelta(sf::Packet& packet, const SceneObject::MainState& state, Uint32 mask);
+
+// Fields not in %mask are left untouched.
+bool readMainStateDelta(sf::Packet& packet, SceneObject::MainState& state, Uint32& mask);
+
+// Copies fields in %mask from %source to %target.
+void mergeMainState(SceneObject::MainState& target, const SceneObject::MainState& source, Uint32 mask);
+
+}
+
+}
@@ -0,0 +1,186 @@
+/*
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*      ,----  ,----  ,----
+*      |      |      |
+*      |----  | --,  |----
+*      |      |   |  |
+*      '----  '---'  '----
+*
+*     Framework Library for Hexagon
+*
+*    Copyright (c) Sppmacd 2020 - 2021
+*
+*    Permission is hereby granted, free of charge, to any person obtaining a copy
+*    of this software and associated documentation files (the "Software"), to deal
+*    in the Software without restriction, including without limitation the rights
+*    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*    copies of the Software, and to permit persons to whom the Software is
+*    furnished to do so, subject to the following conditions:
+*
+*    The above copyright notice and this permission notice shall be included in all
+*    copies or substantial portions of the Software.
+*
+*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*    SOFTWARE.
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*/
+
+#include "Compression.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace EGE
+{
+
+namespace Compression
+{
+
+// Constants of LZ4 block format. Block always ends with literals, and last
+// match starts at least 12 bytes before the end.
+const Size MinMatch = 4;
+const Size LastLiterals = 5;
+const Size MatchSafeDistance = 12;
+const Size MaxOffset = 65535;
+
+const int HashBits = 12;
+
+static Uint32 read32(const Uint8* data)
+{
+    Uint32 value;
+    memcpy(&value, data, 4);
+    return value;
+}
+
+static Uint32 hash(Uint32 value)
+{
+    return (value * 2654435761u) >> (32 - HashBits);
+}
+
+// Lengths that don't fit in token are continued in bytes of 255.
+static void writeLength(Vector<Uint8>& output, Size length)
+{
+    while(length >= 255)
+    {
+        output.push_back(255);
+        length -= 255;
+    }
+    output.push_back(length);
+}
+
+static bool readLength(const Uint8*& data, const Uint8* end, Size& length)
+{
+    Uint8 byte;
+    do
+    {
+        if(data >= end)
+            return false;
+        byte = *data++;
+        length += byte;
+    } while(byte == 255);
+    return true;
+}
+
+// Match length 0 means last sequence, that has only literals.
+static void writeSequence(Vector<Uint8>& output, const Uint8* literals, Size literalCount, Size offset, Size matchLength)
+{
+    Uint8 token = std::min<Size>(literalCount, 15) << 4;
+    if(matchLength)
+        token |= std::min<Size>(matchLength - MinMatch, 15);
+    output.push_back(token);
+    if(literalCount >= 15)
+        writeLength(output, literalCount - 15);
+    output.insert(output.end(), literals, literals + literalCount);
+    if(!matchLength)
+        return;
+    output.push_back(offset & 0xFF);
+    output.push_back(offset >> 8);
+    if(matchLength - MinMatch >= 15)
+        writeLength(output, matchLength - MinMatch - 15);
+}
+
+void compress(const Uint8* data, Size size, Vector<Uint8>& output)
+{
+    // Positions + 1 of last occurence of 4-byte sequences; 0 is none.
+    Vector<Uint32> table(1 << HashBits, 0);
+    Size anchor = 0;
+    Size position = 0;
+
+    while(position + MatchSafeDistance < size)
+    {
+        Uint32 value = read32(data + position);
+        Uint32& entry = table[hash(value)];
+        Size candidate = entry;
+        entry = position + 1;
+        if(candidate == 0 || position - (candidate - 1) > MaxOffset || read32(data + candidate - 1) != value)
+        {
+            position++;
+            continue;
+        }
+        candidate--;
+
+        Size length = MinMatch;
+        while(position + length < size - LastLiterals && data[candidate + length] == data[position + length])
+            length++;
+
+        writeSequence(output, data + anchor, position - anchor, position - candidate, length);
+        position += length;
+        anchor = position;
+    }
+    writeSequence(output, data + anchor, size - anchor, 0, 0);
+}
+
+bool decompress(const Uint8* data, Size size, Vector<Uint8>& output, Size decompressedSize)
+{
+    const Uint8* end = data + size;
+    Size start = output.size();
+    output.reserve(start + decompressedSize);
+
+    while(data < end)
+    {
+        Uint8 token = *data++;
+        Size literals = token >> 4;
+        if(literals == 15 && !readLength(data, end, literals))
+            return false;
+        if((Size)(end - data) < literals || output.size() - start + literals > decompressedSize)
+            return false;
+        output.insert(output.end(), data, data + literals);
+        data += literals;
+
+        // Last sequence has no match.
+        if(data == end)
+            break;
+
+        if(end - data < 2)
+            return false;
+        Size offset = data[0] | (data[1] << 8);
+        data += 2;
+        Size length = token & 15;
+        if(length == 15 && !readLength(data, end, length))
+            return false;
+        length += MinMatch;
+
+        Size produced = output.size() - start;
+        if(offset == 0 || offset > produced || produced + length > decompressedSize)
+            return false;
+
+        // Match may overlap with itself, so it's copied byte by byte.
+        Size from = output.size() - offset;
+        for(Size s = 0; s < length; s++)
+            output.push_back(output[from + s]);
+    }
+    return output.size() - start == decompressedSize;
+}
+
+}
+
+}
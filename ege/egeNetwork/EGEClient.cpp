@@ -38,6 +38,7 @@
 
 #include "EGEPacket.h"
 
+#include <algorithm>
 #include <ege/asyncLoop/AsyncTask.h>
 #include <ege/debug/Dump.h>
 #include <ege/debug/Logger.h>
@@ -47,8 +48,18 @@
 namespace EGE
 {
 
+// Seconds, for interpolation.
+static double currentTime()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 EGEClient::~EGEClient()
 {
+    // Network thread uses members of this class, so it must end before
+    // they are destroyed.
+    m_running = false;
+    finishAsyncTasks();
     disconnect();
 }
 
@@ -61,6 +72,15 @@ bool EGEClient::sendWithUID(SharedPtr<EGEPacket> packet)
 }
 
 EventResult EGEClient::onReceive(SharedPtr<Packet> packet)
+{
+    if(!m_handlePacketsInLoop)
+        return handlePacket(packet);
+
+    postInvoke([this, packet]() { handlePacket(packet); });
+    return EventResult::Success;
+}
+
+EventResult EGEClient::handlePacket(SharedPtr<Packet> packet)
 {
     EGEPacket* egePacket = (EGEPacket*)packet.get();
 
@@ -83,12 +103,13 @@ EventResult EGEClient::onReceive(SharedPtr<Packet> packet)
     case EGEPacket::Type::_ProtocolVersion:
         {
             int value = egePacket->getArgs()->getObject("value").asInt().valueOr(0);
-            if(value != EGE_PROTOCOL_VERSION)
+            if(value < EGE_PROTOCOL_VERSION_MIN)
             {
-                err() << "0020 EGE/egeNetwork: Server PROTOCOL_VERSION doesn't match client! (required "
-                    << EGE_PROTOCOL_VERSION << ", got " << value << ")";
+                err() << "0020 EGE/egeNetwork: Server PROTOCOL_VERSION is not supported by client! (required at least "
+                    << EGE_PROTOCOL_VERSION_MIN << ", got " << value << ")";
                 return EventResult::Failure;
             }
+            m_protocolVersion = std::min(value, EGE_PROTOCOL_VERSION);
             send(EGEPacket::generate_Pong());
         }
         break;
@@ -121,7 +142,19 @@ EventResult EGEClient::onReceive(SharedPtr<Packet> packet)
             if(!typeId.hasValue())
                 return EventResult::Failure;
 
-            return createSceneObjectFromData(object.value(), id.value(), typeId.value());
+            if(auto channel = getUnreliableChannel())
+                channel->forget(id.value());
+
+            // Interpolation starts from there.
+            {
+                sf::Lock lock(m_interpolationMutex);
+                m_interpolationBuffers.erase(id.value());
+            }
+            auto result = createSceneObjectFromData(object.value(), id.value(), typeId.value());
+            auto sceneObject = getScene() ? getScene()->getObject(id.value()) : nullptr;
+            if(sceneObject)
+                bufferState(id.value(), sceneObject->getMainState(), sceneObject->getMainState());
+            return result;
         }
         break;
     case EGEPacket::Type::SSceneObjectUpdate:
@@ -139,6 +172,46 @@ EventResult EGEClient::onReceive(SharedPtr<Packet> packet)
             return updateSceneObjectFromData(object.value(), id.value());
         }
         break;
+    case EGEPacket::Type::SSceneObjectUpdate_Compact:
+        return updateSceneObjectFromState(egePacket->getMainState(), egePacket->getObjectId());
+    case EGEPacket::Type::SSceneObjectUpdate_Delta:
+        return updateSceneObjectFromState(egePacket->getMainState(), egePacket->getObjectId(), egePacket->getDeltaMask());
+    case EGEPacket::Type::SBatch:
+        {
+            Vector<SharedPtr<EGEPacket>> packets;
+            if(!egePacket->unpackBatch(packets))
+            {
+                err(LogLevel::Error) << "EGEClient: Invalid SBatch";
+                return EventResult::Failure;
+            }
+            // Already in order (and on the right thread), so not re-posted.
+            for(auto& batchedPacket: packets)
+            {
+                if(handlePacket(batchedPacket) == EventResult::Failure)
+                    return EventResult::Failure;
+            }
+        }
+        break;
+    case EGEPacket::Type::SCompressed:
+        {
+            auto decompressed = egePacket->decompress();
+            if(!decompressed)
+            {
+                err(LogLevel::Error) << "EGEClient: Invalid SCompressed";
+                return EventResult::Failure;
+            }
+            return handlePacket(decompressed);
+        }
+    case EGEPacket::Type::SUdpChannel:
+        {
+            SharedPtr<ObjectMap> args = egePacket->getArgs();
+            auto port = args->getObject("port").asInt().valueOr(0);
+            auto token = args->getObject("token").asInt().valueOr(0);
+            if(port <= 0 || port > 65535 || !token)
+                return EventResult::Failure;
+            openUnreliableChannel(port, token);
+        }
+        break;
     case EGEPacket::Type::SSceneObjectDeletion:
         {
             SharedPtr<ObjectMap> args = egePacket->getArgs();
@@ -147,6 +220,13 @@ EventResult EGEClient::onReceive(SharedPtr<Packet> packet)
             if(!id.hasValue())
                 return EventResult::Failure;
 
+            if(auto channel = getUnreliableChannel())
+                channel->remove(id.value());
+            {
+                sf::Lock lock(m_interpolationMutex);
+                m_interpolationBuffers.erase(id.value());
+            }
+
             auto scene = getScene();
             if(!scene) //scene not created
                 return EventResult::Success;
@@ -292,10 +372,104 @@ EventResult EGEClient::updateSceneObjectFromData(SharedPtr<ObjectMap> object, Ui
         return EventResult::Success;
     }
 
-    sceneObject->deserialize(object);
+    // Only main state is interpolated, the rest is applied now. Updates
+    // without main data (e.g. extended-only) don't produce a sample.
+    bool hasMain = object->getObject("m").to<ObjectMap>().hasValue();
+    auto shownState = sceneObject->getMainState();
+    if(sceneObject->deserialize(object) && hasMain && bufferState(id, shownState, sceneObject->getMainState()))
+        sceneObject->applyMainState(shownState);
     return EventResult::Success;
 }
 
+EventResult EGEClient::updateSceneObjectFromState(const SceneObject::MainState& state, UidType id, Uint32 mask)
+{
+    if(!getScene()) //scene not created
+        return EventResult::Success;
+
+    auto sceneObject = getScene()->getObject(id);
+
+    if(!sceneObject)
+    {
+        if(!m_requestedObjects.count(id))
+            requestObject(id);
+        return EventResult::Success;
+    }
+
+    if(m_interpolationDelay > 0)
+    {
+        // Delta is relative to the last state from server, not to the
+        // interpolated one.
+        SceneObject::MainState newState;
+        {
+            sf::Lock lock(m_interpolationMutex);
+            auto it = m_interpolationBuffers.find(id);
+            if(it == m_interpolationBuffers.end() || !it->second.getNewest(newState))
+                newState = sceneObject->getMainState();
+        }
+        CompactEncoding::mergeMainState(newState, state, mask);
+        bufferState(id, sceneObject->getMainState(), newState);
+        return EventResult::Success;
+    }
+
+    if(mask == CompactEncoding::DeltaAll)
+    {
+        sceneObject->applyMainState(state);
+        return EventResult::Success;
+    }
+    auto newState = sceneObject->getMainState();
+    CompactEncoding::mergeMainState(newState, state, mask);
+    sceneObject->applyMainState(newState);
+    return EventResult::Success;
+}
+
+bool EGEClient::bufferState(UidType id, const SceneObject::MainState& shownState, const SceneObject::MainState& state)
+{
+    if(m_interpolationDelay <= 0)
+        return false;
+    sf::Lock lock(m_interpolationMutex);
+    auto& buffer = m_interpolationBuffers[id];
+    double time = currentTime();
+
+    // Object moves from where it's shown now, instead of jumping.
+    if(buffer.isEmpty())
+        buffer.push(time - m_interpolationDelay, shownState);
+    buffer.push(time, state);
+    return true;
+}
+
+void EGEClient::applyInterpolatedStates()
+{
+    auto scene = getScene();
+    if(!scene)
+        return;
+
+    double time = currentTime() - m_interpolationDelay;
+    sf::Lock lock(m_interpolationMutex);
+    for(auto it = m_interpolationBuffers.begin(); it != m_interpolationBuffers.end();)
+    {
+        auto object = scene->getObject(it->first);
+        if(!object)
+        {
+            it = m_interpolationBuffers.erase(it);
+            continue;
+        }
+        SceneObject::MainState state;
+        if(it->second.sample(time, state, m_serverTickRate))
+        {
+            // Scene would move it once again.
+            state.motion = Vec3d();
+            object->applyMainState(state);
+        }
+        it->second.discardBefore(time);
+
+        // Nothing to do until the next update.
+        if(it->second.isSettled(time))
+            it = m_interpolationBuffers.erase(it);
+        else
+            ++it;
+    }
+}
+
 void EGEClient::setScene(SharedPtr<Scene> scene)
 {
     if(!scene)
@@ -335,13 +509,22 @@ EventResult EGEClient::onLoad()
 
         send(EGEPacket::generate_ProtocolVersion(EGE_PROTOCOL_VERSION));
 
+        // Waiting with timeout, so that thread notices when it should stop.
+        m_selector.add(*m_socket);
         while(isRunning())
         {
-            update();
+            if(auto channel = getUnreliableChannel())
+                updateWithUnreliableChannel(channel);
+            else if(m_selector.wait(sf::milliseconds(250)))
+                update();
             if(!isConnected())
                 m_running = false;
         }
 
+        // Sockets are used only by this thread, so they are closed here
+        // and not in disconnect().
+        m_selector.clear();
+        m_udpSocket.unbind();
         return 0;
     };
     auto clientNetworkCallback = [this](AsyncTask::State state) {
@@ -352,6 +535,7 @@ EventResult EGEClient::onLoad()
     };
 
     m_clientTask = make<AsyncTask>(clientNetworkWorker, clientNetworkCallback);
+    m_clientTask->setLongRunning(true);
     addAsyncTask(m_clientTask, "EGEClient network task");
 
     return EventResult::Success;
@@ -368,6 +552,9 @@ void EGEClient::onTick(TickCount tickCount)
 {
     if(!isConnected())
         exit(tickCount);
+
+    if(m_interpolationDelay > 0)
+        applyInterpolatedStates();
 }
 
 SharedPtr<SFMLPacket> EGEClient::makePacket(sf::Packet& packet)
@@ -378,6 +565,11 @@ SharedPtr<SFMLPacket> EGEClient::makePacket(sf::Packet& packet)
 void EGEClient::disconnect()
 {
     Client::disconnect();
+    {
+        // Next connection opens its own channel.
+        sf::Lock lock(m_unreliableMutex);
+        m_unreliableChannel = nullptr;
+    }
     onDisconnect("Disconnected");
 
     /*if(m_clientTask)
@@ -389,6 +581,101 @@ void EGEClient::disconnect()
     }*/
 }
 
+SharedPtr<UnreliableChannel> EGEClient::getUnreliableChannel()
+{
+    sf::Lock lock(m_unreliableMutex);
+    return m_unreliableChannel;
+}
+
+void EGEClient::openUnreliableChannel(unsigned short port, Uint64 token)
+{
+    if(getUnreliableChannel())
+        return;
+
+    // Not fatal, updates come through TCP then.
+    if(m_udpSocket.bind(sf::Socket::AnyPort) != sf::Socket::Done)
+    {
+        err(LogLevel::Warning) << "EGEClient: Failed to open UDP channel, using TCP only";
+        return;
+    }
+    m_udpToken = token;
+    auto channel = make<UnreliableChannel>(m_udpSocket, m_ip, port);
+    m_datagram.resize(sf::UdpSocket::MaxDatagramSize);
+    m_selector.add(m_udpSocket);
+    channel->sendHello(m_udpToken);
+    m_lastHello = std::chrono::steady_clock::now();
+
+    sf::Lock lock(m_unreliableMutex);
+    m_unreliableChannel = channel;
+}
+
+void EGEClient::updateWithUnreliableChannel(const SharedPtr<UnreliableChannel>& channel)
+{
+    bool ready = m_selector.wait(sf::milliseconds(250));
+
+    // Hello may be lost too, so it's resent until server starts sending.
+    if(!channel->hasReceived() && std::chrono::steady_clock::now() - m_lastHello > std::chrono::milliseconds(250))
+    {
+        channel->sendHello(m_udpToken);
+        m_lastHello = std::chrono::steady_clock::now();
+    }
+    if(!ready)
+        return;
+
+    if(m_selector.isReady(m_udpSocket))
+        receiveUnreliable(channel);
+    if(m_selector.isReady(*m_socket))
+        update();
+}
+
+void EGEClient::receiveUnreliable(const SharedPtr<UnreliableChannel>& channel)
+{
+    std::size_t size;
+    sf::IpAddress address;
+    unsigned short port;
+    if(m_udpSocket.receive(m_datagram.data(), m_datagram.size(), size, address, port) != sf::Socket::Done)
+        return;
+
+    // Only server may send updates.
+    if(address != channel->getAddress() || port != channel->getPort())
+        return;
+
+    Uint32 sequence;
+    Vector<SharedPtr<EGEPacket>> packets;
+    if(!UnreliableChannel::parse(m_datagram.data(), size, sequence, packets))
+    {
+        err(LogLevel::Verbose) << "EGEClient: Invalid datagram from server";
+        return;
+    }
+    channel->setReceived();
+
+    if(!m_handlePacketsInLoop)
+    {
+        applyUnreliableUpdates(*channel, sequence, packets);
+        return;
+    }
+    // Channel is kept alive, it may be closed before loop gets there.
+    postInvoke([this, channel, sequence, packets = std::move(packets)]() {
+        applyUnreliableUpdates(*channel, sequence, packets);
+    });
+}
+
+void EGEClient::applyUnreliableUpdates(UnreliableChannel& channel, Uint32 sequence, const Vector<SharedPtr<EGEPacket>>& packets)
+{
+    auto scene = getScene();
+    if(!scene)
+        return;
+    channel.markSeen(sequence);
+    for(auto& packet: packets)
+    {
+        // Objects are created through TCP, it's not a reason to request them.
+        UidType id = packet->getObjectId();
+        if(!scene->getObject(id) || !channel.accept(id, sequence))
+            continue;
+        updateSceneObjectFromState(packet->getMainState(), id);
+    }
+}
+
 SharedPtr<ClientNetworkController> EGEClient::getController(UidType objectId)
 {
     return m_controllersForObjects[objectId];
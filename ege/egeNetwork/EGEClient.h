@@ -37,8 +37,11 @@
 #pragma once
 
 #include "ClientNetworkController.h"
+#include "CompactEncoding.h"
 #include "EGEGame.h"
 #include "EGEPacket.h"
+#include "InterpolationBuffer.h"
+#include "UnreliableChannel.h"
 
 #include <ege/asyncLoop/ThreadSafeEventLoop.h>
 #include <ege/gui/GameLoop.h>
@@ -46,9 +49,11 @@
 #include <ege/network/Packet.h>
 #include <ege/network/SFMLNetworkImpl.h>
 #include <ege/network/SFMLPacket.h>
+#include <chrono>
 #include <ege/util/ObjectMap.h>
 #include <memory>
 #include <set>
+#include <unordered_map>
 
 #define EGECLIENT_DEBUG 0
 
@@ -82,6 +87,7 @@ public:
     virtual EventResult onReceive(SharedPtr<Packet> packet);
     EventResult createSceneObjectFromData(SharedPtr<ObjectMap> object, UidType id, String typeId);
     EventResult updateSceneObjectFromData(SharedPtr<ObjectMap> object, UidType id);
+    EventResult updateSceneObjectFromState(const SceneObject::MainState& state, UidType id, Uint32 mask = CompactEncoding::DeltaAll);
 
     virtual void setScene(SharedPtr<Scene> scene);
 
@@ -123,7 +129,50 @@ public:
     void removeAdditionalController(UidType id) { m_additionalControllers.erase(id); }
     bool hasAdditionalController(UidType id) { return m_additionalControllers.count(id); }
 
+    // Negotiated with server in _ProtocolVersion.
+    int getProtocolVersion() const { return m_protocolVersion; }
+
+    // Opened when server offers it (protocol 5+). Server sends main state
+    // updates there, everything else still goes through TCP.
+    // Closed by disconnect().
+    SharedPtr<UnreliableChannel> getUnreliableChannel();
+
+    // If not 0, objects are shown %seconds in the past, interpolated between
+    // states received from server, so that they move smoothly even with rare
+    // updates. It should be a bit more than time between updates. Updates
+    // are applied immediately if it's 0 (the default).
+    // Interpolated objects have no motion on client, it's already in their
+    // position.
+    void setInterpolationDelay(double seconds) { m_interpolationDelay = seconds; }
+    double getInterpolationDelay() const { return m_interpolationDelay; }
+
+    // Used to extrapolate position from motion if there's no newer state
+    // from server, e.g for objects that move only by their motion. 0 disables
+    // extrapolation.
+    void setServerTickRate(double ticksPerSecond) { m_serverTickRate = ticksPerSecond; }
+    double getServerTickRate() const { return m_serverTickRate; }
+
+    // If enabled, packets received by network thread are passed to loop
+    // (see postInvoke()) and handled there, so that scene is modified only
+    // by loop thread. Otherwise they are handled immediately in network
+    // thread (the default).
+    void setHandlePacketsInLoop(bool handle) { m_handlePacketsInLoop = handle; }
+    bool areHandledPacketsInLoop() const { return m_handlePacketsInLoop; }
+
 private:
+    EventResult handlePacket(SharedPtr<Packet> packet);
+    void applyUnreliableUpdates(UnreliableChannel& channel, Uint32 sequence, const Vector<SharedPtr<EGEPacket>>& packets);
+
+    // Returns false if interpolation is disabled. %shownState is where the
+    // object is now.
+    bool bufferState(UidType id, const SceneObject::MainState& shownState, const SceneObject::MainState& state);
+    void applyInterpolatedStates();
+
+    // Waits for data from TCP and UDP.
+    void updateWithUnreliableChannel(const SharedPtr<UnreliableChannel>& channel);
+    void receiveUnreliable(const SharedPtr<UnreliableChannel>& channel);
+    void openUnreliableChannel(unsigned short port, Uint64 token);
+
     Map<UidType, EGEPacket::Type> m_uidMap;
     SharedPtr<AsyncTask> m_clientTask;
     SharedPtr<ClientNetworkController> m_defaultController;
@@ -132,6 +181,21 @@ private:
     Set<UidType> m_additionalControllers;
     sf::IpAddress m_ip;
     unsigned short m_port;
+    int m_protocolVersion = EGE_PROTOCOL_VERSION_MIN;
+
+    sf::UdpSocket m_udpSocket;
+    sf::SocketSelector m_selector;
+    SharedPtr<UnreliableChannel> m_unreliableChannel;
+    sf::Mutex m_unreliableMutex;
+    Uint64 m_udpToken = 0;
+    std::chrono::steady_clock::time_point m_lastHello;
+    Vector<Uint8> m_datagram;
+
+    double m_interpolationDelay = 0;
+    double m_serverTickRate = 60;
+    bool m_handlePacketsInLoop = false;
+    sf::Mutex m_interpolationMutex;
+    std::unordered_map<UidType, InterpolationBuffer> m_interpolationBuffers;
 };
 
 }
@@ -46,9 +46,92 @@ SharedPtr<SFMLPacket> EGEClientConnection::makePacket(sf::Packet& packet)
     return make<EGEPacket>(packet);
 }
 
+bool EGEClientConnection::send(SharedPtr<Packet> packet)
+{
+    if(!packet)
+        return true;
+    if(m_batchLimit == 0 || m_protocolVersion < 3)
+        return sendFrame(packet);
+
+    sf::Lock lock(m_batchMutex);
+    if(m_batchCount++ == 0)
+        m_batchFirst = packet;
+    EGEPacket::appendToBatch(m_batch, *(SFMLPacket*)packet.get());
+    if(m_batch.size() >= m_batchLimit)
+        return flushBatchLocked();
+    return true;
+}
+
+bool EGEClientConnection::flushBatch()
+{
+    sf::Lock lock(m_batchMutex);
+    return flushBatchLocked();
+}
+
+bool EGEClientConnection::flushBatchLocked()
+{
+    if(m_batchCount == 0)
+        return true;
+
+    // Single packet doesn't need batch (and keeps its coalesce key).
+    bool success = m_batchCount == 1 ? sendFrame(m_batchFirst) : sendFrame(EGEPacket::generateSBatch(std::move(m_batch)));
+    m_batch.clear();
+    m_batchFirst = nullptr;
+    m_batchCount = 0;
+
+    // Dropped batch may contain delta updates, so client's state is not
+    // known anymore and whole states will be sent next time.
+    if(!success)
+        m_baselines.clear();
+    return success;
+}
+
+bool EGEClientConnection::sendFrame(SharedPtr<Packet> packet)
+{
+    auto size = ((SFMLPacket&)*packet).getEncodedData()->size();
+    if(m_compressionThreshold != 0 && m_protocolVersion >= 4 && size >= m_compressionThreshold)
+    {
+        if(auto compressed = EGEPacket::generateSCompressed((SFMLPacket&)*packet))
+            packet = compressed;
+    }
+    if(!sendTo(this, packet))
+        return false;
+    m_uncompressedBytesSent += size + 4;
+    return true;
+}
+
 void EGEClientConnection::setLastRecvTime(Time t)
 {
     m_lastRecv = t;
 }
 
+SceneObject::MainState* EGEClientConnection::getBaseline(UidType id)
+{
+    auto it = m_baselines.find(id);
+    return it != m_baselines.end() ? &it->second : nullptr;
+}
+
+void EGEClientConnection::resetBaseline(SceneObject& object)
+{
+    if(m_protocolVersion < 2)
+        return;
+    m_baselines[object.getObjectId()] = CompactEncoding::quantizeMainState(object.getMainState());
+}
+
+SharedPtr<EGEPacket> EGEClientConnection::makeDeltaUpdate(UidType id, const SceneObject::MainState& state)
+{
+    // Objects without baseline (e.g. created before protocol was
+    // negotiated) are sent as a whole.
+    auto it = m_baselines.find(id);
+    Uint32 mask = CompactEncoding::DeltaAll;
+    if(it != m_baselines.end())
+    {
+        mask = CompactEncoding::diffMainState(state, it->second);
+        if(!mask)
+            return nullptr;
+    }
+    m_baselines[id] = CompactEncoding::quantizeMainState(state);
+    return EGEPacket::generateSSceneObjectUpdate_Delta(id, state, mask);
+}
+
 }
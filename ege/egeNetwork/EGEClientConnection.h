@@ -36,14 +36,19 @@
 
 #pragma once
 
+#include "CompactEncoding.h"
 #include "EGEPacket.h"
 #include "EGEServer.h"
+#include "UnreliableChannel.h"
 
+#include <atomic>
 #include <ctime>
 #include <ege/network/ClientConnection.h>
 #include <ege/network/SFMLNetworkImpl.h>
 #include <ege/util/Time.h>
 #include <memory>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace EGE
 {
@@ -56,10 +61,8 @@ public:
     , m_lastRecv(server.time(Time::Unit::Seconds))
     , m_createTime(server.time(Time::Unit::Seconds)) {}
 
-    virtual bool send(SharedPtr<Packet> packet)
-    {
-        return sendTo(this, packet);
-    }
+    // Batched for clients with protocol 3+, if batching is enabled.
+    virtual bool send(SharedPtr<Packet> packet);
 
     virtual SharedPtr<Packet> receive()
     {
@@ -101,13 +104,61 @@ public:
     void addAdditionalController(UidType id) { m_additionalControllers.insert(id); }
     void removeAdditionalController(UidType id) { m_additionalControllers.erase(id); }
     bool hasAdditionalController(UidType id) { return m_additionalControllers.count(id); }
+    const Set<UidType>& getAdditionalControllers() const { return m_additionalControllers; }
+
+    // Objects that were created on client, used by EGEServer area of interest.
+    bool knowsObject(UidType id) const { return m_knownObjects.count(id); }
+    void addKnownObject(UidType id) { m_knownObjects.insert(id); }
+    void removeKnownObject(UidType id) { m_knownObjects.erase(id); }
+    const std::unordered_set<UidType>& getKnownObjects() const { return m_knownObjects; }
 
     bool agentVerCheckSucceeded() { return m_agentVerCheck; }
     bool protVerCheckSucceeded() { return m_agentVerCheck; }
     void setAgentVerCheckSuccess() { m_agentVerCheck = true; }
     void setProtVerCheckSuccess() { m_agentVerCheck = true; }
 
+    // Negotiated with client in _ProtocolVersion.
+    int getProtocolVersion() const { return m_protocolVersion; }
+    void setProtocolVersion(int version) { m_protocolVersion = version; }
+
+    // Main state of objects as last sent to client (quantized), used for
+    // delta updates. TCP delivers packets in order, so this is also the state
+    // that client has. Only kept for clients with protocol 2+.
+    SceneObject::MainState* getBaseline(UidType id);
+    void resetBaseline(SceneObject& object);
+    void removeBaseline(UidType id) { m_baselines.erase(id); }
+
+    // Returns delta packet for %object or nullptr if client is up to date.
+    // Updates baseline.
+    SharedPtr<EGEPacket> makeDeltaUpdate(UidType id, const SceneObject::MainState& state);
+
+    // Packets are collected and sent in one SBatch by flushBatch(), or when
+    // batch reaches %limit bytes. 0 disables batching.
+    void setBatchLimit(Size limit) { m_batchLimit = limit; }
+    Size getBatchLimit() const { return m_batchLimit; }
+    bool flushBatch();
+
+    // Frames (packets or batches) of at least %threshold bytes are sent
+    // compressed to clients with protocol 4+. 0 disables compression.
+    void setCompressionThreshold(Size threshold) { m_compressionThreshold = threshold; }
+    Size getCompressionThreshold() const { return m_compressionThreshold; }
+
+    // What getBytesSent() would be without compression.
+    Uint64 getUncompressedBytesSent() const { return m_uncompressedBytesSent; }
+
+    // Sent to client in SUdpChannel. 0 if server didn't offer UDP channel.
+    Uint64 getUdpToken() const { return m_udpToken; }
+    void setUdpToken(Uint64 token) { m_udpToken = token; }
+
+    // Set when client sends hello with its token. Main state updates are
+    // sent there instead of TCP then.
+    SharedPtr<UnreliableChannel> getUnreliableChannel() const { return m_unreliableChannel; }
+    void setUnreliableChannel(SharedPtr<UnreliableChannel> channel) { m_unreliableChannel = channel; }
+
 private:
+    bool flushBatchLocked();
+    bool sendFrame(SharedPtr<Packet> packet);
+
     UidType m_controlledSceneObjectId = 0;
     Time m_lastRecv;
     Time m_createTime;
@@ -116,6 +167,19 @@ private:
     bool m_pinged = false;
     bool m_agentVerCheck = false;
     bool m_protVerCheck = false;
+    int m_protocolVersion = EGE_PROTOCOL_VERSION_MIN;
+    std::unordered_map<UidType, SceneObject::MainState> m_baselines;
+    std::unordered_set<UidType> m_knownObjects;
+
+    sf::Mutex m_batchMutex;
+    Vector<Uint8> m_batch;
+    SharedPtr<Packet> m_batchFirst;
+    Size m_batchCount = 0;
+    Size m_batchLimit = 0;
+    Size m_compressionThreshold = 0;
+    std::atomic<Uint64> m_uncompressedBytesSent { 0 };
+    Uint64 m_udpToken = 0;
+    SharedPtr<UnreliableChannel> m_unreliableChannel;
 };
 
 }
@@ -36,6 +36,8 @@
 
 #include "EGEPacket.h"
 
+#include "CompactEncoding.h"
+#include "Compression.h"
 #include "EGEPacketConverter.h"
 
 #include <cstdlib>
@@ -71,6 +73,12 @@ std::string EGEPacket::typeString(Type type)
         case EGEPacket::Type::CSceneObjectRequest: return "CSceneObjectRequest";
         case EGEPacket::Type::SSceneObjectControl: return "SSceneObjectControl";
         case EGEPacket::Type::_Version: return "_Version";
+        case EGEPacket::Type::SAdditionalControllerId: return "SAdditionalControllerId";
+        case EGEPacket::Type::SSceneObjectUpdate_Compact: return "SSceneObjectUpdate_Compact";
+        case EGEPacket::Type::SSceneObjectUpdate_Delta: return "SSceneObjectUpdate_Delta";
+        case EGEPacket::Type::SBatch: return "SBatch";
+        case EGEPacket::Type::SCompressed: return "SCompressed";
+        case EGEPacket::Type::SUdpChannel: return "SUdpChannel";
         default: return "<unknown>";
     }
 }
@@ -81,6 +89,23 @@ bool EGEPacket::fromSFMLPacket(sf::Packet& packet)
     success &= !packet.endOfPacket();
     packet >> (unsigned int&)m_type;
     success &= !packet.endOfPacket();
+    if(m_type == Type::SSceneObjectUpdate_Compact || m_type == Type::SSceneObjectUpdate_Delta)
+    {
+        Int64 id;
+        if(!CompactEncoding::readVarInt(packet, id))
+            return false;
+        m_objectId = id;
+        if(m_type == Type::SSceneObjectUpdate_Delta)
+            return CompactEncoding::readMainStateDelta(packet, m_mainState, m_deltaMask);
+        return CompactEncoding::readMainState(packet, m_mainState);
+    }
+    if(m_type == Type::SBatch || m_type == Type::SCompressed)
+    {
+        // Unpacked later by unpackBatch() or decompress().
+        auto data = (const Uint8*)packet.getData();
+        m_payload.assign(data + packet.getReadPosition(), data + packet.getDataSize());
+        return true;
+    }
     SharedPtr<Object> args = make<ObjectMap>();
     if(!(packet >> objectIn(args, EGEPacketConverter())))
         return false;
@@ -94,12 +119,77 @@ sf::Packet EGEPacket::toSFMLPacket()
     sf::Packet packet;
     packet << (unsigned int)m_type;
 
+    if(m_type == Type::SSceneObjectUpdate_Compact)
+    {
+        CompactEncoding::writeVarInt(packet, m_objectId);
+        CompactEncoding::writeMainState(packet, m_mainState);
+        return packet;
+    }
+    if(m_type == Type::SSceneObjectUpdate_Delta)
+    {
+        CompactEncoding::writeVarInt(packet, m_objectId);
+        CompactEncoding::writeMainStateDelta(packet, m_mainState, m_deltaMask);
+        return packet;
+    }
+    if(m_type == Type::SBatch || m_type == Type::SCompressed)
+    {
+        packet.append(m_payload.data(), m_payload.size());
+        return packet;
+    }
+
     if(m_args)
         EGEPacketConverter().out(packet, *m_args);
 
     return packet;
 }
 
+void EGEPacket::appendToBatch(Vector<Uint8>& batch, SFMLPacket& packet)
+{
+    // Broadcast packets are still encoded once.
+    auto data = packet.getEncodedData();
+    CompactEncoding::writeVarUint(batch, data->size());
+    batch.insert(batch.end(), data->begin(), data->end());
+}
+
+bool EGEPacket::unpackBatch(Vector<SharedPtr<EGEPacket>>& packets) const
+{
+    const Uint8* data = m_payload.data();
+    const Uint8* end = data + m_payload.size();
+    while(data < end)
+    {
+        Uint64 size;
+        if(!CompactEncoding::readVarUint(data, end, size) || size > (Uint64)(end - data))
+            return false;
+        sf::Packet packet;
+        packet.append(data, size);
+        auto nested = make<EGEPacket>(packet);
+        if(!nested->isValid() || nested->m_type == Type::SBatch || nested->m_type == Type::SCompressed)
+            return false;
+        packets.push_back(nested);
+        data += size;
+    }
+    return true;
+}
+
+SharedPtr<EGEPacket> EGEPacket::decompress() const
+{
+    const Uint8* data = m_payload.data();
+    const Uint8* end = data + m_payload.size();
+    Uint64 size;
+    if(!CompactEncoding::readVarUint(data, end, size) || size > MaxDecompressedSize)
+        return nullptr;
+
+    Vector<Uint8> decompressed;
+    if(!Compression::decompress(data, end - data, decompressed, size))
+        return nullptr;
+    sf::Packet packet;
+    packet.append(decompressed.data(), decompressed.size());
+    auto nested = make<EGEPacket>(packet);
+    if(!nested->isValid() || nested->m_type == Type::SCompressed)
+        return nullptr;
+    return nested;
+}
+
 long long EGEPacket::generateUID()
 {
     static EGE::Random random(EGE::System::unixTime());
@@ -46,7 +46,16 @@
 
 // Protocol version used by this implementation.
 // It's reported by _ProtocolVersion packet.
-#define EGE_PROTOCOL_VERSION 0
+// 1 - SSceneObjectUpdate_Compact
+// 2 - SSceneObjectUpdate_Delta
+// 3 - SBatch
+// 4 - SCompressed
+// 5 - SUdpChannel
+#define EGE_PROTOCOL_VERSION 5
+
+// Oldest protocol version we can talk to. Peers use the lower
+// of their versions.
+#define EGE_PROTOCOL_VERSION_MIN 0
 
 #define EGEPACKET_DEBUG 0
 
@@ -65,7 +74,7 @@ public:
         _Data = 0x00,
         _Ping = 0x01,
         _Pong = 0x02,
-        _ProtocolVersion = 0x03, //current: 0x0 (unknown)
+        _ProtocolVersion = 0x03, //current: 0x4
         SResult = 0x04,
         CLogin = 0x05,
         SLoginRequest = 0x06,
@@ -80,7 +89,12 @@ public:
         CSceneObjectRequest = 0x0f,
         SSceneObjectControl = 0x10,
         _Version = 0x11, // defined for EGEGame.
-        SAdditionalControllerId = 0x12
+        SAdditionalControllerId = 0x12,
+        SSceneObjectUpdate_Compact = 0x13, // protocol 1+, CompactEncoding instead of ObjectMap
+        SSceneObjectUpdate_Delta = 0x14, // protocol 2+, fields changed since last update
+        SBatch = 0x15, // protocol 3+, packets sent in one tick
+        SCompressed = 0x16, // protocol 4+, another packet compressed
+        SUdpChannel = 0x17 // protocol 5+, UnreliableChannel port and token
     };
 
     static std::string typeString(Type type);
@@ -88,7 +102,7 @@ public:
     // receiver
     EGEPacket(sf::Packet& data)
     {
-        fromSFMLPacket(data);
+        m_valid = fromSFMLPacket(data);
     }
 
     // sender
@@ -97,9 +111,29 @@ public:
     , m_args(args)
     {}
 
+    // sender (SSceneObjectUpdate_Compact)
+    EGEPacket(UidType objectId, const SceneObject::MainState& state)
+    : m_type(Type::SSceneObjectUpdate_Compact)
+    , m_objectId(objectId)
+    , m_mainState(state)
+    {
+        setCoalesceKey(mainUpdateKey(objectId));
+    }
+
+    // sender (SSceneObjectUpdate_Delta)
+    EGEPacket(UidType objectId, const SceneObject::MainState& state, Uint32 deltaMask)
+    : m_type(Type::SSceneObjectUpdate_Delta)
+    , m_objectId(objectId)
+    , m_mainState(state)
+    , m_deltaMask(deltaMask)
+    {}
+
     bool fromSFMLPacket(sf::Packet& packet);
     virtual sf::Packet toSFMLPacket();
 
+    // False if received packet couldn't be parsed.
+    bool isValid() const { return m_valid; }
+
     Type getType()
     {
         return m_type;
@@ -110,6 +144,30 @@ public:
         return m_args;
     }
 
+    // Only for compact and delta packets; getArgs() is null then.
+    UidType getObjectId() const { return m_objectId; }
+    const SceneObject::MainState& getMainState() const { return m_mainState; }
+
+    // Fields of main state that are valid in delta packet (CompactEncoding::DeltaField).
+    Uint32 getDeltaMask() const { return m_deltaMask; }
+
+    // SBatch contains encoded packets, each prefixed with its size (varint).
+    // Fails if any of them is invalid, or is SBatch or SCompressed.
+    static void appendToBatch(Vector<Uint8>& batch, SFMLPacket& packet);
+    bool unpackBatch(Vector<SharedPtr<EGEPacket>>& packets) const;
+
+    // SCompressed contains size of encoded packet (varint), then the packet
+    // compressed with Compression. Returns nullptr if data is corrupted or
+    // the packet is SCompressed. Compressed SBatch is allowed.
+    SharedPtr<EGEPacket> decompress() const;
+
+    // Packets that decompress to more than that are treated as corrupted.
+    static const Size MaxDecompressedSize = 16 * 1024 * 1024;
+
+    // Coalesce key of packets that contain whole main state of object.
+    // Delta updates don't have it, because they depend on previous ones.
+    static Uint64 mainUpdateKey(UidType objectId) { return ((Uint64)Type::SSceneObjectUpdate << 56) ^ (Uint64)objectId; }
+
     static long long generateUID();
     static void appendUID(SharedPtr<ObjectMap> packetArgs);
 
@@ -124,6 +182,8 @@ public:
     static SharedPtr<EGEPacket> generateSSceneObjectCreation(SceneObject& object, std::string typeId);
     static SharedPtr<EGEPacket> generateSSceneObjectUpdate_Main(SceneObject& object);
     static SharedPtr<EGEPacket> generateSSceneObjectUpdate_Extended(SceneObject& object);
+    static SharedPtr<EGEPacket> generateSSceneObjectUpdate_Compact(SceneObject& object);
+    static SharedPtr<EGEPacket> generateSSceneObjectUpdate_Delta(UidType id, const SceneObject::MainState& state, Uint32 mask);
     static SharedPtr<EGEPacket> generateSSceneObjectDeletion(UidType id);
     static SharedPtr<EGEPacket> generateSSceneCreation(SharedPtr<ObjectMap> userData = nullptr);
     static SharedPtr<EGEPacket> generateSSceneDeletion(SharedPtr<ObjectMap> userData = nullptr);
@@ -133,10 +193,20 @@ public:
     static SharedPtr<EGEPacket> generateSSceneObjectControl(SceneObject& object, const ControlPacket& data);
     static SharedPtr<EGEPacket> generate_Version(int value, std::string str);
     static SharedPtr<EGEPacket> generateSAdditionalControllerId(SceneObject& object, bool remove);
+    static SharedPtr<EGEPacket> generateSBatch(Vector<Uint8>&& batch);
+
+    // Returns nullptr if compressed packet wouldn't be smaller.
+    static SharedPtr<EGEPacket> generateSCompressed(SFMLPacket& packet);
+    static SharedPtr<EGEPacket> generateSUdpChannel(unsigned short port, Uint64 token);
 
 private:
     Type m_type;
+    bool m_valid = true;
     SharedPtr<ObjectMap> m_args;
+    UidType m_objectId = 0;
+    SceneObject::MainState m_mainState;
+    Uint32 m_deltaMask = 0;
+    Vector<Uint8> m_payload; // SBatch, SCompressed
 };
 
 }
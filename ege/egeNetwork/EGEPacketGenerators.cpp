@@ -36,6 +36,9 @@
 
 #include "EGEPacket.h"
 
+#include "CompactEncoding.h"
+#include "Compression.h"
+
 #include <ege/main/Config.h>
 #include <ege/util/PointerUtils.h>
 #include <ege/util/ObjectBoolean.h>
@@ -115,7 +118,9 @@ SharedPtr<EGEPacket> EGEPacket::generateSSceneObjectUpdate_Main(SceneObject& obj
     objectData->addObject("m", object.serializeMain());
     data->addObject("object", objectData);
     data->addObject("id", make<ObjectInt>(object.getObjectId()));
-    return make<EGEPacket>(EGEPacket::Type::SSceneObjectUpdate, data);
+    auto packet = make<EGEPacket>(EGEPacket::Type::SSceneObjectUpdate, data);
+    packet->setCoalesceKey(mainUpdateKey(object.getObjectId()));
+    return packet;
 }
 
 SharedPtr<EGEPacket> EGEPacket::generateSSceneObjectUpdate_Extended(SceneObject& object)
@@ -127,6 +132,17 @@ SharedPtr<EGEPacket> EGEPacket::generateSSceneObjectUpdate_Extended(SceneObject&
     data->addObject("id", make<ObjectInt>(object.getObjectId()));
     return make<EGEPacket>(EGEPacket::Type::SSceneObjectUpdate, data);
 }
+
+SharedPtr<EGEPacket> EGEPacket::generateSSceneObjectUpdate_Compact(SceneObject& object)
+{
+    return make<EGEPacket>(object.getObjectId(), object.getMainState());
+}
+
+SharedPtr<EGEPacket> EGEPacket::generateSSceneObjectUpdate_Delta(UidType id, const SceneObject::MainState& state, Uint32 mask)
+{
+    return make<EGEPacket>(id, state, mask);
+}
+
 SharedPtr<EGEPacket> EGEPacket::generateSSceneObjectDeletion(UidType id)
 {
     SharedPtr<ObjectMap> data = make<ObjectMap>();
@@ -201,4 +217,34 @@ SharedPtr<EGEPacket> EGEPacket::generateSAdditionalControllerId(SceneObject& obj
     return make<EGEPacket>(EGEPacket::Type::SAdditionalControllerId, args);
 }
 
+SharedPtr<EGEPacket> EGEPacket::generateSBatch(Vector<Uint8>&& batch)
+{
+    auto packet = make<EGEPacket>(EGEPacket::Type::SBatch, nullptr);
+    packet->m_payload = std::move(batch);
+    return packet;
+}
+
+SharedPtr<EGEPacket> EGEPacket::generateSCompressed(SFMLPacket& packet)
+{
+    auto data = packet.getEncodedData();
+    Vector<Uint8> payload;
+    CompactEncoding::writeVarUint(payload, data->size());
+    Compression::compress(data->data(), data->size(), payload);
+
+    // Type of SCompressed takes 4 bytes.
+    if(payload.size() + 4 >= data->size())
+        return nullptr;
+    auto compressed = make<EGEPacket>(EGEPacket::Type::SCompressed, nullptr);
+    compressed->m_payload = std::move(payload);
+    return compressed;
+}
+
+SharedPtr<EGEPacket> EGEPacket::generateSUdpChannel(unsigned short port, Uint64 token)
+{
+    SharedPtr<ObjectMap> args = make<ObjectMap>();
+    args->addInt("port", port);
+    args->addInt("token", (MaxInt)token);
+    return make<EGEPacket>(EGEPacket::Type::SUdpChannel, args);
+}
+
 }
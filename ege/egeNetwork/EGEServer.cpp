@@ -38,23 +38,36 @@
 
 #include "EGEClientConnection.h"
 #include "EGEPacket.h"
+#include "UnreliableChannel.h"
 
+#include <algorithm>
 #include <ege/asyncLoop/AsyncTask.h>
 #include <ege/controller/ControlPacket.h>
 #include <ege/debug/Dump.h>
 #include <ege/debug/Logger.h>
 #include <ege/network/ClientConnection.h>
+#include <ege/scene/SpatialGrid.h>
 #include <iomanip>
 #include <iostream>
+#include <random>
+#include <unordered_set>
 
 namespace EGE
 {
 
+EGEServer::~EGEServer()
+{
+    // Network thread uses members of this class and Server, so it must end
+    // before they are destroyed. It checks isRunning() at least every 2s.
+    m_running = false;
+    finishAsyncTasks();
+}
+
 EventResult EGEServer::onClientConnect(ClientConnection& client)
 {
     sf::Lock lock(m_clientsAccessMutex);
 
-    // FIXME: should it be asynchronous?
+    // These are only queued if asynchronous sending is enabled.
     if(!client.send(EGEPacket::generate_Ping()))
         return EventResult::Failure;
     if(!client.send(EGEPacket::generate_ProtocolVersion(EGE_PROTOCOL_VERSION)))
@@ -73,6 +86,10 @@ EventResult EGEServer::onClientDisconnect(ClientConnection& client)
     if(!client.send(EGEPacket::generateSDisconnectReason("Disconnected")))
         return EventResult::Failure;
 
+    // Client is closed after that.
+    if(!((EGEClientConnection&)client).flushBatch())
+        return EventResult::Failure;
+
     return EventResult::Success;
 }
 
@@ -88,7 +105,15 @@ void EGEServer::setScene(SharedPtr<Scene> scene)
     scene->events<AddObjectEvent>().add([this](AddObjectEvent& event) {
         // Add controller to controller map.
         m_controllersForObjects[event.object.getObjectId()] = makeController(event.object);
-        sendToAll(EGEPacket::generateSSceneObjectCreation(event.object, event.object.getType()->getId()));
+
+        // With area of interest, objects are sent by updateInterest().
+        if(m_interestRadius != 0)
+            return EventResult::Success;
+        auto packet = EGEPacket::generateSSceneObjectCreation(event.object, event.object.getType()->getId());
+        sendTo(packet, [&event](ClientConnection& client) {
+            ((EGEClientConnection&)client).resetBaseline(event.object);
+            return true;
+        });
         return EventResult::Success;
     });
 
@@ -98,7 +123,14 @@ void EGEServer::setScene(SharedPtr<Scene> scene)
         if(it != m_controllersForObjects.end())
             m_controllersForObjects.erase(it);
 
-        sendToAll(EGEPacket::generateSSceneObjectDeletion(event.object.getObjectId()));
+        sendTo(EGEPacket::generateSSceneObjectDeletion(event.object.getObjectId()), [this, &event](ClientConnection& client) {
+            EGEClientConnection& egeClient = (EGEClientConnection&)client;
+            if(!isInterested(egeClient, event.object.getObjectId()))
+                return false;
+            egeClient.removeBaseline(event.object.getObjectId());
+            egeClient.removeKnownObject(event.object.getObjectId());
+            return true;
+        });
 
         // Notify players that were controlling the object that object was removed.
         sendTo(EGEPacket::generateSDefaultControllerId(nullptr), [event](ClientConnection& client)->bool {
@@ -119,7 +151,17 @@ void EGEServer::setScene(SharedPtr<Scene> scene)
 EventResult EGEServer::onReceive(ClientConnection& client, SharedPtr<Packet> packet)
 {
     sf::Lock lock(m_clientsAccessMutex);
-    EGEPacket* egePacket = (EGEPacket*)packet.get();
+    EGEClientConnection& egeClient = (EGEClientConnection&)client;
+    EventResult result = handlePacket(egeClient, *(EGEPacket*)packet.get());
+
+    // Replies don't wait for end of tick.
+    egeClient.flushBatch();
+    return result;
+}
+
+EventResult EGEServer::handlePacket(EGEClientConnection& egeClient, EGEPacket& packet)
+{
+    EGEPacket* egePacket = &packet;
 
     if constexpr(EGEPACKET_DEBUG)
     {
@@ -127,8 +169,6 @@ EventResult EGEServer::onReceive(ClientConnection& client, SharedPtr<Packet> pac
         printObject(egePacket->getArgs());
     }
 
-    EGEClientConnection& egeClient = (EGEClientConnection&)client;
-
     if(PING_DEBUG && egeClient.wasPinged())
         std::cerr << "%%%%% Client is now responding. clearing ping flag %%%%%" << std::endl;
 
@@ -157,15 +197,18 @@ EventResult EGEServer::onReceive(ClientConnection& client, SharedPtr<Packet> pac
         {
             egeClient.send(EGEPacket::generate_ProtocolVersion(EGE_PROTOCOL_VERSION));
             int value = egePacket->getArgs()->getObject("value").asInt().valueOr(0);
-            if(value != EGE_PROTOCOL_VERSION)
+            if(value < EGE_PROTOCOL_VERSION_MIN)
             {
-                err(LogLevel::Error) << "0021 EGE/egeNetwork: Client PROTOCOL_VERSION doesn't match server! (required "
-                    << EGE_PROTOCOL_VERSION << ", got " << value << ")";
-                kickClientWithReason(egeClient, "Invalid protocol version (need " + std::to_string(EGE_PROTOCOL_VERSION) + ", got " + std::to_string(value) + ")");
+                err(LogLevel::Error) << "0021 EGE/egeNetwork: Client PROTOCOL_VERSION is not supported by server! (required at least "
+                    << EGE_PROTOCOL_VERSION_MIN << ", got " << value << ")";
+                kickClientWithReason(egeClient, "Invalid protocol version (need at least " + std::to_string(EGE_PROTOCOL_VERSION_MIN) + ", got " + std::to_string(value) + ")");
                 return EventResult::Failure;
             }
+            egeClient.setProtocolVersion(std::min(value, EGE_PROTOCOL_VERSION));
             egeClient.send(EGEPacket::generate_Pong());
             egeClient.setProtVerCheckSuccess();
+            if(m_udpEnabled && egeClient.getProtocolVersion() >= 5)
+                offerUdpChannel(egeClient);
         }
         break;
     case EGEPacket::Type::CLogin:
@@ -230,6 +273,8 @@ EventResult EGEServer::onReceive(ClientConnection& client, SharedPtr<Packet> pac
 
             err(LogLevel::Debug) << "SceneObject requested: " << id.value();
             egeClient.send(EGEPacket::generateSSceneObjectCreation(*sceneObject, sceneObject->getType()->getId()));
+            egeClient.resetBaseline(*sceneObject);
+            egeClient.addKnownObject(id.value());
             if(egeClient.getControlledSceneObject() == id.value())
                 egeClient.send(EGEPacket::generateSDefaultControllerId(sceneObject.get()));
         }
@@ -286,6 +331,7 @@ EventResult EGEServer::onLoad()
     };
 
     SharedPtr<AsyncTask> task = make<AsyncTask>(serverNetworkWorker, serverNetworkCallback);
+    task->setLongRunning(true);
     addAsyncTask(task, "EGEServer network task");
 
     return EventResult::Success;
@@ -301,6 +347,9 @@ void EGEServer::onTick(TickCount)
 {
     sf::Lock lock(m_clientsAccessMutex);
 
+    if(m_udpEnabled)
+        receiveUdpHellos();
+
     // Check if clients are alive.
     for(auto it: *this)
     {
@@ -342,39 +391,104 @@ void EGEServer::onTick(TickCount)
     if(getScene())
         getScene()->onUpdate(getTickCount());
 
-    // Send object updates to Client.
-    // TODO: It will be better to not check every object!
+    // Create and delete objects that entered or left clients' areas of interest.
+    if(getScene() && m_interestRadius != 0)
+    {
+        for(auto it: *this)
+            updateInterest((EGEClientConnection&)*it.second);
+    }
+
+    // Send object updates to Client. Only objects that changed since last
+    // tick are checked.
     if(getScene())
     {
-        for(auto object: *getScene())
+        for(auto sceneObject: getScene()->takeChangedObjects())
         {
-            auto sceneObject = object.second;
-
             if(sceneObject->getMainChangedFlag())
             {
                 sceneObject->clearMainChangedFlag();
-                sendToAll(EGEPacket::generateSSceneObjectUpdate_Main(*sceneObject));
+                sendMainUpdate(*sceneObject);
             }
             if(sceneObject->getExtendedChangedFlag())
             {
                 sceneObject->clearExtendedChangedFlag();
-                sendToAll(EGEPacket::generateSSceneObjectUpdate_Extended(*sceneObject));
+                sendToInterested(EGEPacket::generateSSceneObjectUpdate_Extended(*sceneObject), sceneObject->getObjectId());
             }
         }
     }
+
+    // Everything sent in this tick goes out in one frame per client.
+    for(auto it: *this)
+    {
+        auto& client = (EGEClientConnection&)*it.second;
+        client.flushBatch();
+        if(auto channel = client.getUnreliableChannel())
+            channel->flush();
+    }
+}
+
+void EGEServer::sendMainUpdate(SceneObject& object)
+{
+    if(!object.allowCompactUpdates())
+    {
+        sendToInterested(EGEPacket::generateSSceneObjectUpdate_Main(object), object.getObjectId());
+        return;
+    }
+
+    // Clients with protocol 2+ get only fields that changed since their
+    // baseline, older ones the whole state. Whole-state packets are shared.
+    auto state = object.getMainState();
+    SharedPtr<EGEPacket> compactPacket;
+    SharedPtr<EGEPacket> legacyPacket;
+    for(auto it: *this)
+    {
+        auto& client = (EGEClientConnection&)*it.second;
+        if(!isInterested(client, object.getObjectId()))
+            continue;
+        int version = client.getProtocolVersion();
+        if(auto channel = client.getUnreliableChannel())
+        {
+            // Whole state, because updates may be lost.
+            if(!compactPacket)
+                compactPacket = make<EGEPacket>(object.getObjectId(), state);
+            channel->send(*compactPacket);
+        }
+        else if(version >= 2)
+        {
+            // If delta didn't make it to send queue, client's state is not
+            // known anymore, so the next update will be sent as a whole.
+            auto packet = client.makeDeltaUpdate(object.getObjectId(), state);
+            if(packet && !client.send(packet))
+                client.removeBaseline(object.getObjectId());
+        }
+        else if(version == 1)
+        {
+            if(!compactPacket)
+                compactPacket = make<EGEPacket>(object.getObjectId(), state);
+            client.send(compactPacket);
+        }
+        else
+        {
+            if(!legacyPacket)
+                legacyPacket = EGEPacket::generateSSceneObjectUpdate_Main(object);
+            client.send(legacyPacket);
+        }
+    }
 }
 
 EventResult EGEServer::onLogin(EGEClientConnection& client, SharedPtr<ObjectMap>)
 {
-    // Send SceneObject data to Client.
+    // Send SceneObject data to Client. With area of interest, it's done
+    // by updateInterest().
     auto scene = getScene();
-    if(scene)
+    if(scene && m_interestRadius == 0)
     {
         for(auto object: *scene)
         {
             bool success = client.send(EGEPacket::generateSSceneObjectCreation(*object.second, object.second->getType()->getId()));
             if(!success)
                 return EventResult::Failure;
+            client.resetBaseline(*object.second);
         }
     }
 
@@ -388,9 +502,69 @@ void EGEServer::kickClientWithReason(EGEClientConnection& client, std::string re
     kickClient(client);
 }
 
+bool EGEServer::enableUdpChannel(unsigned short port)
+{
+    if(m_udpSocket.bind(port) != sf::Socket::Done)
+    {
+        err(LogLevel::Error) << "EGEServer: Failed to bind UDP channel to port " << port;
+        return false;
+    }
+    m_udpSocket.setBlocking(false);
+    m_udpEnabled = true;
+    return true;
+}
+
+void EGEServer::offerUdpChannel(EGEClientConnection& client)
+{
+    // Token is the only thing that identifies client in hello.
+    static std::random_device device;
+    Uint64 token = 0;
+    while(!token)
+        token = ((Uint64)device() << 32) | device();
+    client.setUdpToken(token);
+    client.send(EGEPacket::generateSUdpChannel(getUdpPort(), token));
+}
+
+void EGEServer::receiveUdpHellos()
+{
+    // Bigger datagrams are not hellos anyway.
+    Uint8 data[UnreliableChannel::HelloSize + 1];
+    std::size_t size;
+    sf::IpAddress address;
+    unsigned short port;
+    while(m_udpSocket.receive(data, sizeof(data), size, address, port) == sf::Socket::Done)
+    {
+        Uint64 token;
+        if(!UnreliableChannel::parseHello(data, size, token) || !token)
+            continue;
+        for(auto it: *this)
+        {
+            auto& client = (EGEClientConnection&)*it.second;
+            if(client.getUdpToken() != token)
+                continue;
+
+            // Hello must come from the same host as TCP connection.
+            auto socket = client.getSocket().lock();
+            if(!socket || socket->getRemoteAddress() != address)
+                break;
+
+            auto channel = client.getUnreliableChannel();
+            if(!channel || channel->getAddress() != address || channel->getPort() != port)
+            {
+                err(LogLevel::Verbose) << "EGEServer: UDP channel for client " << client.getID() << " is " << address << ":" << port;
+                client.setUnreliableChannel(make<UnreliableChannel>(m_udpSocket, address, port));
+            }
+            break;
+        }
+    }
+}
+
 SharedPtr<ClientConnection> EGEServer::makeClient(Server& server, SharedPtr<sf::TcpSocket> socket)
 {
-    return make<EGEClientConnection>((EGEServer&)server, socket);
+    auto client = make<EGEClientConnection>((EGEServer&)server, socket);
+    client->setBatchLimit(m_batchLimit);
+    client->setCompressionThreshold(m_compressionThreshold);
+    return client;
 }
 
 void EGEServer::setDefaultController(EGEClientConnection& client, SceneObject* sceneObject)
@@ -436,4 +610,94 @@ void EGEServer::removeAdditionalController(EGEClientConnection& client, SceneObj
     client.send(EGEPacket::generateSAdditionalControllerId(sceneObject, true));
 }
 
+bool EGEServer::getInterestCenter(EGEClientConnection& client, Vec2d& center)
+{
+    auto object = getScene()->getObject(client.getControlledSceneObject());
+    if(!object)
+        return false;
+    Vec3d position = object->getPosition();
+    center = Vec2d(position.x, position.y);
+    return true;
+}
+
+bool EGEServer::isInterested(EGEClientConnection& client, UidType objectId) const
+{
+    return m_interestRadius == 0 || client.knowsObject(objectId);
+}
+
+bool EGEServer::sendToInterested(SharedPtr<Packet> packet, UidType objectId)
+{
+    return sendTo(packet, [this, objectId](ClientConnection& client) {
+        return isInterested((EGEClientConnection&)client, objectId);
+    });
+}
+
+void EGEServer::updateInterest(EGEClientConnection& client)
+{
+    auto scene = getScene();
+    std::unordered_set<UidType> interesting;
+
+    // Static objects are in spatial index too, but they are not synchronized.
+    // Their IDs may also collide with IDs of dynamic objects.
+    auto isDynamic = [&](SceneObject& object) {
+        return scene->getObject(object.getObjectId()).get() == &object;
+    };
+
+    // Parents are needed to compute position of their children. Static
+    // parents are loaded by client from scene data.
+    auto addObject = [&](SceneObject* object) {
+        while(object && isDynamic(*object) && interesting.insert(object->getObjectId()).second)
+            object = object->getParent();
+    };
+
+    addObject(scene->getObject(client.getControlledSceneObject()).get());
+    for(auto id: client.getAdditionalControllers())
+        addObject(scene->getObject(id).get());
+
+    Vec2d center;
+    if(getInterestCenter(client, center))
+    {
+        Vec2d radius(m_interestRadius, m_interestRadius);
+        for(auto object: scene->getObjectsInRect(RectD(center - radius, radius * 2.0)))
+            addObject(object);
+
+        // Known objects are kept a bit longer, so that objects on the border
+        // are not created and deleted every tick.
+        RectD leaveArea(center - radius * 1.25, radius * 2.5);
+        for(auto id: client.getKnownObjects())
+        {
+            if(interesting.count(id))
+                continue;
+            auto object = scene->getObject(id);
+            if(object && SpatialGrid::intersects(object->getBoundingBox(), leaveArea))
+                addObject(object.get());
+        }
+    }
+
+    Vector<UidType> leaving;
+    for(auto id: client.getKnownObjects())
+    {
+        if(!interesting.count(id))
+            leaving.push_back(id);
+    }
+    for(auto id: leaving)
+    {
+        client.send(EGEPacket::generateSSceneObjectDeletion(id));
+        client.removeBaseline(id);
+        client.removeKnownObject(id);
+    }
+
+    for(auto id: interesting)
+    {
+        if(client.knowsObject(id))
+            continue;
+        auto object = scene->getObject(id);
+        if(!object)
+            continue;
+        client.send(EGEPacket::generateSSceneObjectCreation(*object, object->getType()->getId()));
+        client.resetBaseline(*object);
+        client.addKnownObject(id);
+    }
+}
+
 }
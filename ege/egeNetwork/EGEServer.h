@@ -53,12 +53,19 @@ namespace EGE
 {
 
 class EGEClientConnection;
+class EGEPacket;
 
 class EGEServer : public Server, public GameLoop, public EGEGame
 {
 public:
     EGEServer(int port)
-    : Server(port) {}
+    : Server(port)
+    {
+        // Newer object update replaces one that slow client didn't get yet.
+        setSendQueueLimit(4 * 1024 * 1024, SendQueue::Policy::Coalesce);
+    }
+
+    virtual ~EGEServer();
 
     virtual EventResult onClientConnect(ClientConnection& client);
     virtual EventResult onClientDisconnect(ClientConnection& client);
@@ -97,8 +104,62 @@ public:
 
     virtual bool canControlPacket(ServerNetworkController& controller, EGEClientConnection& client);
 
+    // Area of interest. If radius is not 0, clients know only about objects
+    // whose bounding box is closer than %radius (in each axis) to the area
+    // center, and about objects they control. Objects are created on client
+    // when they enter the area, and deleted when they go 25% further away.
+    // If it's 0 (the default), every client knows about every object.
+    void setInterestRadius(double radius) { m_interestRadius = radius; }
+    double getInterestRadius() const { return m_interestRadius; }
+
+    // Center of area of interest. Default is position of controlled object.
+    // Returning false means that client has no area.
+    virtual bool getInterestCenter(EGEClientConnection& client, Vec2d& center);
+
+    bool isInterested(EGEClientConnection& client, UidType objectId) const;
+
+    // Sends %packet to clients that know about object %objectId.
+    bool sendToInterested(SharedPtr<Packet> packet, UidType objectId);
+
+    // Packets for clients with protocol 3+ are sent in one SBatch per tick.
+    // Batch is sent earlier if it reaches %limit bytes, and after handling
+    // each packet received from client. 0 disables batching. Applies to
+    // clients connected after that.
+    void setBatchLimit(Size limit) { m_batchLimit = limit; }
+    Size getBatchLimit() const { return m_batchLimit; }
+
+    // Frames of at least %threshold bytes are sent compressed to clients with
+    // protocol 4+. Useful for scene snapshots and big bursts of object
+    // creations. 0 (the default) disables compression. Applies to clients
+    // connected after that.
+    void setCompressionThreshold(Size threshold) { m_compressionThreshold = threshold; }
+    Size getCompressionThreshold() const { return m_compressionThreshold; }
+
+    // Opens UDP channel on %port (any free port if 0). Clients with protocol
+    // 5+ get main state updates of objects through it, so that they are not
+    // delayed by lost TCP packets. Clients that can't reach that port still
+    // get them through TCP.
+    bool enableUdpChannel(unsigned short port = 0);
+    bool isUdpChannelEnabled() const { return m_udpEnabled; }
+    unsigned short getUdpPort() const { return m_udpEnabled ? m_udpSocket.getLocalPort() : 0; }
+
+protected:
+    // Creates and deletes objects on client so that it knows exactly about
+    // objects in its area of interest. Called every tick.
+    void updateInterest(EGEClientConnection& client);
+
 private:
+    EventResult handlePacket(EGEClientConnection& client, EGEPacket& packet);
+    void sendMainUpdate(SceneObject& object);
+    void offerUdpChannel(EGEClientConnection& client);
+    void receiveUdpHellos();
+
     std::map<UidType, SharedPtr<ServerNetworkController>> m_controllersForObjects;
+    double m_interestRadius = 0;
+    Size m_batchLimit = 32 * 1024;
+    Size m_compressionThreshold = 0;
+    sf::UdpSocket m_udpSocket;
+    bool m_udpEnabled = false;
 };
 
 }
@@ -0,0 +1,126 @@
+/*
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*      ,----  ,----  ,----
+*      |      |      |
+*      |----  | --,  |----
+*      |      |   |  |
+*      '----  '---'  '----
+*
+*     Framework Library for Hexagon
+*
+*    Copyright (c) Sppmacd 2020 - 2021
+*
+*    Permission is hereby granted, free of charge, to any person obtaining a copy
+*    of this software and associated documentation files (the "Software"), to deal
+*    in the Software without restriction, including without limitation the rights
+*    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*    copies of the Software, and to permit persons to whom the Software is
+*    furnished to do so, subject to the following conditions:
+*
+*    The above copyright notice and this permission notice shall be included in all
+*    copies or substantial portions of the Software.
+*
+*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*    SOFTWARE.
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*/
+#include "InterpolationBuffer.h"
+
+#include <cmath>
+
+namespace EGE
+{
+
+// Along the shorter arc.
+static double interpolateAngle(double from, double to, double t)
+{
+    double difference = std::fmod(to - from, 360.0);
+    if(difference > 180)
+        difference -= 360;
+    else if(difference < -180)
+        difference += 360;
+    return from + difference * t;
+}
+
+void InterpolationBuffer::push(double time, const SceneObject::MainState& state)
+{
+    // Updates received at once (e.g in one batch) replace each other.
+    if(!m_states.empty() && time <= m_states.back().time)
+    {
+        m_states.back().state = state;
+        return;
+    }
+    m_states.push_back({ time, state });
+    if(m_states.size() > MaxStates)
+        m_states.pop_front();
+}
+
+bool InterpolationBuffer::sample(double time, SceneObject::MainState& state, double ticksPerSecond) const
+{
+    if(m_states.empty())
+        return false;
+
+    if(time <= m_states.front().time)
+    {
+        state = m_states.front().state;
+        return true;
+    }
+
+    auto& newest = m_states.back();
+    if(time >= newest.time)
+    {
+        state = newest.state;
+        state.position += newest.state.motion * ((time - newest.time) * ticksPerSecond);
+        return true;
+    }
+
+    // There are a few states, so linear search is fine.
+    Size s = m_states.size() - 1;
+    while(m_states[s - 1].time > time)
+        s--;
+    auto& from = m_states[s - 1];
+    auto& to = m_states[s];
+    double t = (time - from.time) / (to.time - from.time);
+
+    state = from.state;
+    state.position = from.state.position + (to.state.position - from.state.position) * t;
+    state.motion = from.state.motion + (to.state.motion - from.state.motion) * t;
+    state.yaw = interpolateAngle(from.state.yaw, to.state.yaw, t);
+    state.pitch = interpolateAngle(from.state.pitch, to.state.pitch, t);
+    state.roll = interpolateAngle(from.state.roll, to.state.roll, t);
+    return true;
+}
+
+bool InterpolationBuffer::getNewest(SceneObject::MainState& state) const
+{
+    if(m_states.empty())
+        return false;
+    state = m_states.back().state;
+    return true;
+}
+
+void InterpolationBuffer::discardBefore(double time)
+{
+    // The state just before %time is still needed.
+    while(m_states.size() > 1 && m_states[1].time <= time)
+        m_states.pop_front();
+}
+
+bool InterpolationBuffer::isSettled(double time) const
+{
+    if(m_states.size() != 1 || m_states[0].time > time)
+        return false;
+    auto& motion = m_states[0].state.motion;
+    return motion.x == 0 && motion.y == 0 && motion.z == 0;
+}
+
+}
@@ -0,0 +1,88 @@
+/*
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*      ,----  ,----  ,----
+*      |      |      |
+*      |----  | --,  |----
+*      |      |   |  |
+*      '----  '---'  '----
+*
+*     Framework Library for Hexagon
+*
+*    Copyright (c) Sppmacd 2020 - 2021
+*
+*    Permission is hereby granted, free of charge, to any person obtaining a copy
+*    of this software and associated documentation files (the "Software"), to deal
+*    in the Software without restriction, including without limitation the rights
+*    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*    copies of the Software, and to permit persons to whom the Software is
+*    furnished to do so, subject to the following conditions:
+*
+*    The above copyright notice and this permission notice shall be included in all
+*    copies or substantial portions of the Software.
+*
+*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*    SOFTWARE.
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*/
+
+#pragma once
+
+#include <deque>
+#include <ege/scene/SceneObject.h>
+
+namespace EGE
+{
+
+// Main states of replicated object received from server, with time when they
+// were received. Client shows objects a bit in the past, interpolated between
+// two states, so that they move smoothly even if server sends updates rarely
+// or they come with some jitter.
+class InterpolationBuffer
+{
+public:
+    // Older states are dropped.
+    static const Size MaxStates = 32;
+
+    // %time is in seconds. States must be pushed in order they were sent.
+    void push(double time, const SceneObject::MainState& state);
+
+    // State at %time, interpolated between the states around it. Position
+    // and rotation are interpolated, other fields are from the older state.
+    // Before the first state, it's the first state. After the newest state,
+    // position is extrapolated from its motion, which is in units per server
+    // tick (0 %ticksPerSecond disables that). Returns false if there are no
+    // states.
+    bool sample(double time, SceneObject::MainState& state, double ticksPerSecond = 0) const;
+
+    // Returns false if there are no states.
+    bool getNewest(SceneObject::MainState& state) const;
+
+    // Drops states that are not needed to sample at %time or later.
+    void discardBefore(double time);
+
+    // True if sampling at %time or later always gives the newest state.
+    bool isSettled(double time) const;
+
+    bool isEmpty() const { return m_states.empty(); }
+    Size getStateCount() const { return m_states.size(); }
+
+private:
+    struct TimedState
+    {
+        double time;
+        SceneObject::MainState state;
+    };
+
+    std::deque<TimedState> m_states;
+};
+
+}
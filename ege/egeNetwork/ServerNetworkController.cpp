@@ -44,7 +44,8 @@ namespace EGE
 
 void ServerNetworkController::sendRequest(const ControlPacket& data)
 {
-    m_server.sendToAll(EGEPacket::generateSSceneObjectControl((SceneObject&)getObject(), data));
+    auto& object = (SceneObject&)getObject();
+    m_server.sendToInterested(EGEPacket::generateSSceneObjectControl(object, data), object.getObjectId());
 }
 
 }
@@ -0,0 +1,155 @@
+/*
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*      ,----  ,----  ,----
+*      |      |      |
+*      |----  | --,  |----
+*      |      |   |  |
+*      '----  '---'  '----
+*
+*     Framework Library for Hexagon
+*
+*    Copyright (c) Sppmacd 2020 - 2021
+*
+*    Permission is hereby granted, free of charge, to any person obtaining a copy
+*    of this software and associated documentation files (the "Software"), to deal
+*    in the Software without restriction, including without limitation the rights
+*    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*    copies of the Software, and to permit persons to whom the Software is
+*    furnished to do so, subject to the following conditions:
+*
+*    The above copyright notice and this permission notice shall be included in all
+*    copies or substantial portions of the Software.
+*
+*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*    SOFTWARE.
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*/
+#include "UnreliableChannel.h"
+
+#include <ege/debug/Logger.h>
+
+namespace EGE
+{
+
+// Sequence, type of SBatch.
+static const Size DatagramHeaderSize = 8;
+
+bool UnreliableChannel::send(SFMLPacket& packet)
+{
+    // Size prefix of packet in batch is at most 3 bytes here.
+    auto size = packet.getEncodedData()->size();
+    if(!m_datagram.empty() && DatagramHeaderSize + m_datagram.size() + size + 3 > MaxDatagramSize)
+    {
+        if(!flush())
+            return false;
+    }
+    EGEPacket::appendToBatch(m_datagram, packet);
+    return true;
+}
+
+bool UnreliableChannel::flush()
+{
+    if(m_datagram.empty())
+        return true;
+
+    Uint32 sequence = m_sequence++;
+    auto data = EGEPacket::generateSBatch(std::move(m_datagram))->getEncodedData();
+    m_datagram = {};
+
+    Vector<Uint8> datagram { Uint8(sequence >> 24), Uint8(sequence >> 16), Uint8(sequence >> 8), Uint8(sequence) };
+    datagram.insert(datagram.end(), data->begin(), data->end());
+    if(m_socket.send(datagram.data(), datagram.size(), m_address, m_port) != sf::Socket::Done)
+    {
+        // Like a lost datagram, but it's worth knowing about.
+        err(LogLevel::Verbose) << "UnreliableChannel: Failed to send datagram to " << m_address << ":" << m_port;
+        return false;
+    }
+    m_datagramsSent++;
+    return true;
+}
+
+bool UnreliableChannel::parse(const Uint8* data, Size size, Uint32& sequence, Vector<SharedPtr<EGEPacket>>& packets)
+{
+    if(size < DatagramHeaderSize)
+        return false;
+    sequence = (Uint32(data[0]) << 24) | (Uint32(data[1]) << 16) | (Uint32(data[2]) << 8) | Uint32(data[3]);
+
+    sf::Packet sfPacket;
+    sfPacket.append(data + 4, size - 4);
+    EGEPacket batch(sfPacket);
+    if(batch.getType() != EGEPacket::Type::SBatch || !batch.unpackBatch(packets))
+        return false;
+
+    // Only state updates are allowed to be lost.
+    for(auto& packet: packets)
+    {
+        if(packet->getType() != EGEPacket::Type::SSceneObjectUpdate_Compact)
+            return false;
+    }
+    return true;
+}
+
+void UnreliableChannel::markSeen(Uint32 sequence)
+{
+    // Works also when sequence wraps around.
+    if(!m_anySequenceSeen || (Int32)(sequence - m_highestSequence) > 0)
+    {
+        m_highestSequence = sequence;
+        m_anySequenceSeen = true;
+    }
+}
+
+bool UnreliableChannel::accept(UidType id, Uint32 sequence)
+{
+    markSeen(sequence);
+    auto it = m_lastSequences.find(id);
+    if(it == m_lastSequences.end())
+    {
+        m_lastSequences.emplace(id, sequence);
+        return true;
+    }
+
+    if((Int32)(sequence - it->second) <= 0)
+        return false;
+    it->second = sequence;
+    return true;
+}
+
+void UnreliableChannel::forget(UidType id)
+{
+    if(!m_anySequenceSeen)
+    {
+        m_lastSequences.erase(id);
+        return;
+    }
+    m_lastSequences[id] = m_highestSequence;
+}
+
+bool UnreliableChannel::sendHello(Uint64 token)
+{
+    Uint8 hello[HelloSize];
+    for(Size s = 0; s < HelloSize; s++)
+        hello[s] = token >> (56 - s * 8);
+    return m_socket.send(hello, HelloSize, m_address, m_port) == sf::Socket::Done;
+}
+
+bool UnreliableChannel::parseHello(const Uint8* data, Size size, Uint64& token)
+{
+    if(size != HelloSize)
+        return false;
+    token = 0;
+    for(Size s = 0; s < HelloSize; s++)
+        token = (token << 8) | data[s];
+    return true;
+}
+
+}
@@ -0,0 +1,126 @@
+/*
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*      ,----  ,----  ,----
+*      |      |      |
+*      |----  | --,  |----
+*      |      |   |  |
+*      '----  '---'  '----
+*
+*     Framework Library for Hexagon
+*
+*    Copyright (c) Sppmacd 2020 - 2021
+*
+*    Permission is hereby granted, free of charge, to any person obtaining a copy
+*    of this software and associated documentation files (the "Software"), to deal
+*    in the Software without restriction, including without limitation the rights
+*    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*    copies of the Software, and to permit persons to whom the Software is
+*    furnished to do so, subject to the following conditions:
+*
+*    The above copyright notice and this permission notice shall be included in all
+*    copies or substantial portions of the Software.
+*
+*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*    SOFTWARE.
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*/
+
+#pragma once
+
+#include "EGEPacket.h"
+
+#include <ege/util/Types.h>
+#include <SFML/Network.hpp>
+#include <unordered_map>
+
+namespace EGE
+{
+
+// UDP channel that goes next to TCP session, for clients with protocol 5+.
+// Server sends whole main state of objects (SSceneObjectUpdate_Compact) on
+// it, so that lost datagram doesn't hold newer updates back like in TCP.
+// Lost updates are not resent, the next ones replace them. Everything else
+// stays on TCP.
+//
+// Server to client datagram: sequence number (Uint32, big endian), then
+// encoded SBatch. Client applies update only if it's from newer datagram
+// than the last update it applied for the same object.
+//
+// Client to server datagram (hello): token (Uint64, big endian) that server
+// sent in SUdpChannel. Client sends it until it gets the first datagram, so
+// that server knows its UDP address.
+//
+// Not thread-safe.
+class UnreliableChannel
+{
+public:
+    // Datagrams are kept below usual MTU so that they are not fragmented.
+    static const Size MaxDatagramSize = 1200;
+
+    static const Size HelloSize = 8;
+
+    UnreliableChannel(sf::UdpSocket& socket, sf::IpAddress address, unsigned short port)
+    : m_socket(socket), m_address(address), m_port(port) {}
+
+    sf::IpAddress getAddress() const { return m_address; }
+    unsigned short getPort() const { return m_port; }
+
+    // Sender. Packets are collected and sent in one datagram by flush(), or
+    // earlier if datagram would be bigger than MaxDatagramSize.
+    bool send(SFMLPacket& packet);
+    bool flush();
+
+    // Sequence number of the next datagram.
+    Uint32 getSequence() const { return m_sequence; }
+    Uint64 getDatagramsSent() const { return m_datagramsSent; }
+
+    // Receiver. Returns false if datagram is invalid.
+    static bool parse(const Uint8* data, Size size, Uint32& sequence, Vector<SharedPtr<EGEPacket>>& packets);
+
+    // Called for every valid datagram, also if it has no updates of known
+    // objects. accept() calls it too.
+    void markSeen(Uint32 sequence);
+
+    // Returns true, and remembers %sequence, if it's newer than sequence of
+    // the last accepted update of object %id.
+    bool accept(UidType id, Uint32 sequence);
+
+    // Called when object is created, so that its updates are not compared
+    // to these of the old object with the same id. Updates from datagrams
+    // that are not newer than all datagrams seen so far were sent before
+    // the object was created, so they are still rejected.
+    void forget(UidType id);
+
+    // Called when object is deleted.
+    void remove(UidType id) { m_lastSequences.erase(id); }
+
+    bool sendHello(Uint64 token);
+    static bool parseHello(const Uint8* data, Size size, Uint64& token);
+
+    bool hasReceived() const { return m_received; }
+    void setReceived() { m_received = true; }
+
+private:
+    sf::UdpSocket& m_socket;
+    sf::IpAddress m_address;
+    unsigned short m_port;
+
+    Vector<Uint8> m_datagram;
+    Uint32 m_sequence = 1;
+    Uint64 m_datagramsSent = 0;
+    std::unordered_map<UidType, Uint32> m_lastSequences;
+    Uint32 m_highestSequence = 0;
+    bool m_anySequenceSeen = false;
+    bool m_received = false;
+};
+
+}
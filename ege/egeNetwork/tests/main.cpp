@@ -1,23 +1,38 @@
 #include <testsuite/Tests.h>
 #include <ege/debug/Dump.h>
+#include <ege/egeNetwork/CompactEncoding.h>
+#include <ege/egeNetwork/Compression.h>
 #include <ege/egeNetwork/EGEClient.h>
+#include <ege/egeNetwork/EGEClientConnection.h>
 #include <ege/egeNetwork/EGEPacket.h>
 #include <ege/egeNetwork/EGEServer.h>
+#include <ege/egeNetwork/InterpolationBuffer.h>
 #include <ege/egeNetwork/ServerNetworkController.h>
+#include <ege/egeNetwork/UnreliableChannel.h>
 #include <ege/event/SystemEventHandler.h>
 #include <ege/event/SystemWindow.h>
 #include <ege/gui/GUIGameLoop.h>
 #include <ege/gui/GUIScreen.h>
+#include <ege/network/SendQueue.h>
 #include <ege/scene/Scene.h>
 #include <ege/scene/SceneWidget.h>
 #include <ege/scene/Plain2DCamera.h>
 #include <ege/util/ObjectInt.h>
 #include <ege/util/ObjectMap.h>
 #include <ege/util/ObjectString.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <deque>
 #include <functional>
 #include <iomanip>
 #include <iostream>
 #include <memory>
+#include <random>
+#ifdef EGE_API_UNIX
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
 
 using EGE::EventResult;
 
@@ -116,6 +131,697 @@ public:
     EGE::Vec2d m_origin;
 };
 
+class CompactTestObject : public EGE::SceneObject
+{
+public:
+    EGE_SCENEOBJECT("CompactTestObject")
+
+    CompactTestObject(EGE::Scene& owner)
+    : EGE::SceneObject(owner) {}
+
+    virtual bool allowCompactUpdates() const override { return true; }
+};
+
+TESTCASE(compactEncoding)
+{
+    sf::Packet packet;
+    EGE::CompactEncoding::writeVarUint(packet, 0);
+    EGE::CompactEncoding::writeVarUint(packet, 300);
+    EGE::CompactEncoding::writeVarInt(packet, -1);
+    EGE::CompactEncoding::writeVarInt(packet, -123456789012);
+    EXPECT_EQUAL(packet.getDataSize(), 1u + 2u + 1u + 6u);
+
+    EGE::Uint64 u;
+    EGE::Int64 i;
+    EXPECT(EGE::CompactEncoding::readVarUint(packet, u) && u == 0);
+    EXPECT(EGE::CompactEncoding::readVarUint(packet, u) && u == 300);
+    EXPECT(EGE::CompactEncoding::readVarInt(packet, i) && i == -1);
+    EXPECT(EGE::CompactEncoding::readVarInt(packet, i) && i == -123456789012);
+    EXPECT(!EGE::CompactEncoding::readVarUint(packet, u));
+
+    auto scene = make<EGE::Scene>(nullptr);
+    scene->getRegistry().addType<CompactTestObject>();
+    auto object = scene->addNewObject<CompactTestObject>();
+    object->setPosition(EGE::Vec3d(123.456, -78.9, 0.5));
+    object->setMotion(EGE::Vec3d(0.25, -1.5, 0.1));
+    object->setRotation(-90);
+    object->setRenderLayer(-3);
+
+    sf::Packet sfPacket = EGE::EGEPacket::generateSSceneObjectUpdate_Compact(*object)->toSFMLPacket();
+    EGE::EGEPacket received(sfPacket);
+    EXPECT(received.getType() == EGE::EGEPacket::Type::SSceneObjectUpdate_Compact);
+    EXPECT(!received.getArgs());
+    EXPECT_EQUAL(received.getObjectId(), object->getObjectId());
+
+    auto& state = received.getMainState();
+    EXPECT(std::abs(state.position.x - 123.456) <= EGE::CompactEncoding::PositionStep);
+    EXPECT(std::abs(state.position.y + 78.9) <= EGE::CompactEncoding::PositionStep);
+    // Motion is exact, so that client doesn't drift when applying it.
+    EXPECT_EQUAL(state.motion.y, -1.5);
+    EXPECT_EQUAL(state.motion.z, 0.1);
+    EXPECT(std::abs(state.yaw - 270) < 0.01);
+    EXPECT_EQUAL(state.layer, -3);
+
+    auto object2 = scene->addNewObject<CompactTestObject>();
+    object2->applyMainState(state);
+    EXPECT(std::abs(object2->getPosition().x - 123.456) <= EGE::CompactEncoding::PositionStep);
+    EXPECT_EQUAL(object2->getRenderLayer(), -3);
+    return 0;
+}
+
+TESTCASE(deltaEncoding)
+{
+    auto scene = make<EGE::Scene>(nullptr);
+    scene->getRegistry().addType<CompactTestObject>();
+    auto object = scene->addNewObject<CompactTestObject>();
+    object->setPosition(EGE::Vec3d(100, 200, 0));
+    object->setMotion(EGE::Vec3d(1, 0, 0));
+
+    auto baseline = EGE::CompactEncoding::quantizeMainState(object->getMainState());
+    EXPECT_EQUAL(EGE::CompactEncoding::diffMainState(object->getMainState(), baseline), 0u);
+
+    // Changes smaller than quantization step are not sent.
+    object->setPosition(EGE::Vec3d(100.001, 200, 0));
+    EXPECT_EQUAL(EGE::CompactEncoding::diffMainState(object->getMainState(), baseline), 0u);
+
+    object->setPosition(EGE::Vec3d(101, 200, 0));
+    object->setRotation(45);
+    EGE::Uint32 mask = EGE::CompactEncoding::diffMainState(object->getMainState(), baseline);
+    EXPECT_EQUAL(mask, (EGE::Uint32)(EGE::CompactEncoding::DeltaPositionX | EGE::CompactEncoding::DeltaYaw));
+
+    sf::Packet sfPacket = EGE::EGEPacket::generateSSceneObjectUpdate_Delta(object->getObjectId(), object->getMainState(), mask)->toSFMLPacket();
+    auto fullSize = EGE::EGEPacket::generateSSceneObjectUpdate_Compact(*object)->toSFMLPacket().getDataSize();
+    std::cerr << "delta: " << sfPacket.getDataSize() << " B, full: " << fullSize << " B" << std::endl;
+    EXPECT(sfPacket.getDataSize() < fullSize);
+
+    EGE::EGEPacket received(sfPacket);
+    EXPECT(received.getType() == EGE::EGEPacket::Type::SSceneObjectUpdate_Delta);
+    EXPECT_EQUAL(received.getDeltaMask(), mask);
+
+    // Receiver keeps fields that were not sent.
+    auto state = baseline;
+    EGE::CompactEncoding::mergeMainState(state, received.getMainState(), mask);
+    EXPECT_EQUAL(state.position.x, 101.0);
+    EXPECT_EQUAL(state.position.y, 200.0);
+    EXPECT_EQUAL(state.motion.x, 1.0);
+    EXPECT(std::abs(state.yaw - 45) < 0.01);
+
+    // But any change of motion is.
+    object->setMotion(EGE::Vec3d(1.00001, 0, 0));
+    EXPECT(EGE::CompactEncoding::diffMainState(object->getMainState(), baseline) & EGE::CompactEncoding::DeltaMotionX);
+    return 0;
+}
+
+class InterestTestServer : public EGE::EGEServer
+{
+public:
+    InterestTestServer()
+    : EGE::EGEServer(0) {}
+
+    using EGE::EGEServer::updateInterest;
+};
+
+TESTCASE(areaOfInterest)
+{
+    InterestTestServer server;
+    auto scene = make<EGE::Scene>(nullptr);
+    scene->getRegistry().addType<CompactTestObject>();
+    server.setScene(scene);
+    server.setInterestRadius(200);
+
+    // 100x100 objects, 100 units apart.
+    for(int x = 0; x < 100; x++)
+    for(int y = 0; y < 100; y++)
+        scene->addNewObject<CompactTestObject>()->setPosition(EGE::Vec3d(x * 100 + 50, y * 100 + 50, 0));
+    auto player = scene->addNewObject<CompactTestObject>();
+    player->setPosition(EGE::Vec3d(500, 500, 0));
+
+    EGE::EGEClientConnection client(server, make<sf::TcpSocket>());
+    client.setControlledSceneObject(player->getObjectId());
+    server.updateInterest(client);
+
+    // 4x4 objects around player, and player itself.
+    EXPECT_EQUAL(client.getKnownObjects().size(), 17u);
+    EXPECT(client.knowsObject(player->getObjectId()));
+
+    // Objects that are a bit outside area are not deleted yet.
+    player->setPosition(EGE::Vec3d(560, 500, 0));
+    server.updateInterest(client);
+    EXPECT_EQUAL(client.getKnownObjects().size(), 21u);
+
+    // World size doesn't matter, only objects around.
+    player->setPosition(EGE::Vec3d(5000, 5000, 0));
+    server.updateInterest(client);
+    EXPECT_EQUAL(client.getKnownObjects().size(), 17u);
+    for(auto id: client.getKnownObjects())
+    {
+        auto position = scene->getObject(id)->getPosition();
+        EXPECT(std::abs(position.x - 5000) <= 200 && std::abs(position.y - 5000) <= 200);
+    }
+
+    // Static parents are not sent. This one has the same ID as a dynamic
+    // object far away.
+    auto base = make<CompactTestObject>(*scene);
+    base->setType(scene->getRegistry().getType(CompactTestObject::type()));
+    base->setName("base");
+    scene->addStaticObject(base);
+    EXPECT(scene->getObject(base->getObjectId()));
+    auto child = scene->addNewObject<CompactTestObject>();
+    child->setPosition(EGE::Vec3d(5000, 5000, 0));
+    child->setParent(base.get());
+    server.updateInterest(client);
+    EXPECT_EQUAL(client.getKnownObjects().size(), 18u);
+    EXPECT(client.knowsObject(child->getObjectId()));
+    EXPECT(!client.knowsObject(base->getObjectId()));
+    return 0;
+}
+
+#ifdef EGE_API_UNIX
+TESTCASE(batching)
+{
+    const int COUNT = 100;
+
+    InterestTestServer server;
+    auto scene = make<EGE::Scene>(nullptr);
+    scene->getRegistry().addType<CompactTestObject>();
+
+    int fds[2];
+    EXPECT(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    EGE::EGEClientConnection client(server, make<sf::TcpSocket>());
+    auto queue = make<EGE::SendQueue>(fds[0]);
+    client.setSendQueue(queue);
+    client.setProtocolVersion(3);
+    client.setBatchLimit(server.getBatchLimit());
+
+    // Nothing is sent until batch is flushed (at the end of tick).
+    EGE::Size separateSize = 0;
+    for(int s = 0; s < COUNT; s++)
+    {
+        auto object = scene->addNewObject<CompactTestObject>();
+        object->setPosition(EGE::Vec3d(s, 0, 0));
+        auto packet = EGE::EGEPacket::generateSSceneObjectUpdate_Compact(*object);
+        separateSize += packet->getEncodedData()->size() + 4;
+        EXPECT(client.send(packet));
+    }
+    EXPECT_EQUAL(queue->getQueuedSize(), 0u);
+    EXPECT(client.flushBatch());
+    EGE::Size batchedSize = queue->getQueuedSize();
+    std::cerr << COUNT << " updates: 1 frame, " << batchedSize << " B (separately: " << COUNT << " frames, " << separateSize << " B)" << std::endl;
+    EXPECT(batchedSize < separateSize);
+    EXPECT(queue->flush() == EGE::SendQueue::FlushResult::Done);
+
+    // Client gets all packets, in order.
+    std::string data(batchedSize, 0);
+    EXPECT_EQUAL(::recv(fds[1], &data[0], data.size(), MSG_WAITALL), (ssize_t)batchedSize);
+    sf::Packet sfPacket;
+    sfPacket.append(data.data() + 4, data.size() - 4);
+    EGE::EGEPacket batch(sfPacket);
+    EXPECT(batch.getType() == EGE::EGEPacket::Type::SBatch);
+    EGE::Vector<EGE::SharedPtr<EGE::EGEPacket>> packets;
+    EXPECT(batch.unpackBatch(packets));
+    EXPECT_EQUAL(packets.size(), (EGE::Size)COUNT);
+    for(int s = 0; s < COUNT && s < (int)packets.size(); s++)
+    {
+        EXPECT(packets[s]->getType() == EGE::EGEPacket::Type::SSceneObjectUpdate_Compact);
+        EXPECT_EQUAL(packets[s]->getMainState().position.x, (double)s);
+    }
+
+    // Nested batch or unparsable packet fails the whole batch.
+    EGE::Vector<EGE::Uint8> inner;
+    EGE::EGEPacket::appendToBatch(inner, *EGE::EGEPacket::generate_Ping());
+    EGE::Vector<EGE::Uint8> outer = inner;
+    EGE::EGEPacket::appendToBatch(outer, *EGE::EGEPacket::generateSBatch(std::move(inner)));
+    packets.clear();
+    EXPECT(!EGE::EGEPacket::generateSBatch(std::move(outer))->unpackBatch(packets));
+    packets.clear();
+    EXPECT(!EGE::EGEPacket::generateSBatch({ 0x04, 0x00, 0x00, 0x00, 0x01 })->unpackBatch(packets));
+
+    // Big batches are sent earlier.
+    client.setBatchLimit(256);
+    for(int s = 0; s < COUNT; s++)
+        client.send(EGE::EGEPacket::generate_Ping());
+    EXPECT(queue->getQueuedSize() > 0);
+
+    ::close(fds[0]);
+    ::close(fds[1]);
+    return 0;
+}
+#endif
+
+TESTCASE(interpolation)
+{
+    EGE::InterpolationBuffer buffer;
+    EGE::SceneObject::MainState state;
+    EXPECT(!buffer.sample(0, state));
+
+    state.position = EGE::Vec3d(0, 0, 0);
+    state.yaw = 350;
+    buffer.push(1, state);
+    state.position = EGE::Vec3d(10, 20, 0);
+    state.yaw = 10;
+    state.layer = 5;
+    buffer.push(2, state);
+
+    EXPECT(buffer.sample(0, state) && state.position.x == 0);
+    EXPECT(buffer.sample(1.5, state));
+    EXPECT_EQUAL(state.position.x, 5.0);
+    EXPECT_EQUAL(state.position.y, 10.0);
+    EXPECT(std::abs(std::fmod(state.yaw + 360, 360)) < 0.001);
+    EXPECT_EQUAL(state.layer, 0);
+
+    // Extrapolation from motion (units per tick).
+    state.position = EGE::Vec3d(10, 20, 0);
+    state.motion = EGE::Vec3d(1, 0, 0);
+    buffer.push(3, state);
+    EXPECT(buffer.sample(3.5, state, 60));
+    EXPECT_EQUAL(state.position.x, 40.0);
+    EXPECT(buffer.sample(3.5, state));
+    EXPECT_EQUAL(state.position.x, 10.0);
+
+    buffer.discardBefore(2.5);
+    EXPECT_EQUAL(buffer.getStateCount(), 2u);
+    EXPECT(!buffer.isSettled(4));
+    state.motion = EGE::Vec3d();
+    buffer.push(4, state);
+    buffer.discardBefore(4);
+    EXPECT(buffer.isSettled(4));
+    return 0;
+}
+
+// Object goes around a circle, 1 unit per server tick (60 tps). Client shows
+// it at 60 fps, and gets its position 10 times per second, with up to 30 ms
+// of jitter. Measures the biggest jump of shown position between frames.
+TESTCASE(interpolationSmoothness)
+{
+    const double TICK = 1 / 60.0;
+    const int SEND_INTERVAL = 6;
+    const double DELAY = 0.15;
+
+    std::mt19937 random(1);
+    std::uniform_real_distribution<double> jitter(0, 0.03);
+    auto truePosition = [](int tick) {
+        return EGE::Vec3d(std::cos(tick / 100.0) * 100, std::sin(tick / 100.0) * 100, 0);
+    };
+    auto distance = [](EGE::Vec3d a, EGE::Vec3d b) {
+        return std::sqrt((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y));
+    };
+
+    // Arrival times of updates, in order.
+    EGE::Vector<std::pair<double, int>> updates;
+    double lastArrival = 0;
+    for(int tick = 0; tick < 3600; tick += SEND_INTERVAL)
+    {
+        lastArrival = std::max(lastArrival, tick * TICK + jitter(random));
+        updates.emplace_back(lastArrival, tick);
+    }
+
+    EGE::InterpolationBuffer buffer;
+    EGE::Vec3d lastDirect, lastInterpolated;
+    double maxDirectJump = 0, maxInterpolatedJump = 0, maxError = 0;
+    EGE::Size next = 0;
+    for(int frame = 60; frame < 3500; frame++)
+    {
+        double time = frame * TICK;
+        EGE::Vec3d direct = lastDirect;
+        while(next < updates.size() && updates[next].first <= time)
+        {
+            EGE::SceneObject::MainState state;
+            state.position = truePosition(updates[next].second);
+            buffer.push(updates[next].first, state);
+            direct = state.position;
+            next++;
+        }
+        EGE::SceneObject::MainState state;
+        EXPECT(buffer.sample(time - DELAY, state));
+        buffer.discardBefore(time - DELAY);
+
+        if(frame > 60)
+        {
+            maxDirectJump = std::max(maxDirectJump, distance(direct, lastDirect));
+            maxInterpolatedJump = std::max(maxInterpolatedJump, distance(state.position, lastInterpolated));
+        }
+        maxError = std::max(maxError, distance(state.position, truePosition((time - DELAY) / TICK)));
+        lastDirect = direct;
+        lastInterpolated = state.position;
+    }
+
+    std::cerr << "biggest jump between frames: " << maxDirectJump << " without interpolation, "
+              << maxInterpolatedJump << " with it (1 per server tick); biggest error " << maxError << std::endl;
+    EXPECT(maxInterpolatedJump < 2);
+    EXPECT(maxDirectJump > SEND_INTERVAL - 1);
+    EXPECT(maxError < 5);
+    return 0;
+}
+
+static bool compressionRoundTrip(const EGE::Vector<EGE::Uint8>& data)
+{
+    EGE::Vector<EGE::Uint8> compressed, decompressed;
+    EGE::Compression::compress(data.data(), data.size(), compressed);
+    return EGE::Compression::decompress(compressed.data(), compressed.size(), decompressed, data.size()) && decompressed == data;
+}
+
+TESTCASE(compression)
+{
+    EXPECT(compressionRoundTrip({}));
+    EXPECT(compressionRoundTrip({ 1, 2, 3 }));
+    EXPECT(compressionRoundTrip(EGE::Vector<EGE::Uint8>(13, 'a')));
+    EXPECT(compressionRoundTrip(EGE::Vector<EGE::Uint8>(100000, 'a')));
+
+    EGE::Vector<EGE::Uint8> random(10000);
+    for(auto& byte: random)
+        byte = rand();
+    EXPECT(compressionRoundTrip(random));
+
+    std::string text;
+    for(int s = 0; s < 1000; s++)
+        text += "{\"type\":\"CompactTestObject\",\"id\":" + std::to_string(s) + "}";
+    EGE::Vector<EGE::Uint8> textData(text.begin(), text.end());
+    EXPECT(compressionRoundTrip(textData));
+
+    // Corrupted data is rejected.
+    EGE::Vector<EGE::Uint8> compressed, decompressed;
+    EGE::Compression::compress(textData.data(), textData.size(), compressed);
+    EXPECT(compressed.size() < textData.size() / 4);
+    EXPECT(!EGE::Compression::decompress(compressed.data(), compressed.size() / 2, decompressed, textData.size()));
+    decompressed.clear();
+    EXPECT(!EGE::Compression::decompress(compressed.data(), compressed.size(), decompressed, textData.size() - 1));
+    decompressed.clear();
+    EGE::Uint8 badOffset[] = { 0x10, 'a', 0x05, 0x00 };
+    EXPECT(!EGE::Compression::decompress(badOffset, sizeof(badOffset), decompressed, 100));
+    return 0;
+}
+
+#ifdef EGE_API_UNIX
+TESTCASE(compressedSnapshot)
+{
+    const int COUNT = 500;
+
+    InterestTestServer server;
+    server.setCompressionThreshold(256);
+    auto scene = make<EGE::Scene>(nullptr);
+    scene->getRegistry().addType<CompactTestObject>();
+    for(int s = 0; s < COUNT; s++)
+        scene->addNewObject<CompactTestObject>()->setPosition(EGE::Vec3d(s * 10, 0, 0));
+
+    int fds[2];
+    EXPECT(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    auto client = std::static_pointer_cast<EGE::EGEClientConnection>(server.makeClient(server, make<sf::TcpSocket>()));
+    auto queue = make<EGE::SendQueue>(fds[0]);
+    client->setSendQueue(queue);
+    client->setProtocolVersion(4);
+
+    // The same as onLogin() does.
+    for(auto object: *scene)
+        client->send(EGE::EGEPacket::generateSSceneObjectCreation(*object.second, object.second->getType()->getId()));
+    EXPECT(client->flushBatch());
+
+    double ratio = (double)client->getBytesSent() / client->getUncompressedBytesSent();
+    std::cerr << "snapshot of " << COUNT << " objects: " << client->getBytesSent() << " B on wire, "
+              << client->getUncompressedBytesSent() << " B uncompressed (" << ratio * 100 << "%)" << std::endl;
+    EXPECT(ratio < 0.5);
+
+    // Client gets all objects.
+    std::string data;
+    char buffer[65536];
+    while(true)
+    {
+        queue->flush();
+        ssize_t count = ::recv(fds[1], buffer, sizeof(buffer), MSG_DONTWAIT);
+        if(count > 0)
+            data.append(buffer, count);
+        else if(queue->getQueuedSize() == 0)
+            break;
+    }
+    EXPECT_EQUAL(data.size(), (EGE::Size)client->getBytesSent());
+
+    EGE::Size created = 0;
+    for(EGE::Size offset = 0; offset + 4 <= data.size();)
+    {
+        auto header = (const EGE::Uint8*)data.data() + offset;
+        EGE::Size size = (header[0] << 24) | (header[1] << 16) | (header[2] << 8) | header[3];
+        sf::Packet sfPacket;
+        sfPacket.append(header + 4, size);
+        offset += size + 4;
+
+        EGE::EGEPacket frame(sfPacket);
+        EXPECT(frame.getType() == EGE::EGEPacket::Type::SCompressed);
+        auto batch = frame.decompress();
+        EXPECT(batch && batch->getType() == EGE::EGEPacket::Type::SBatch);
+        EGE::Vector<EGE::SharedPtr<EGE::EGEPacket>> packets;
+        EXPECT(batch && batch->unpackBatch(packets));
+        for(auto& packet: packets)
+            created += packet->getType() == EGE::EGEPacket::Type::SSceneObjectCreation;
+    }
+    EXPECT_EQUAL(created, (EGE::Size)COUNT);
+
+    // Compressed frame may contain batch, but not another compressed frame.
+    EGE::Vector<EGE::Uint8> batchData;
+    for(int s = 0; s < 100; s++)
+        EGE::EGEPacket::appendToBatch(batchData, *EGE::EGEPacket::generate_Ping());
+    auto compressed = EGE::EGEPacket::generateSCompressed(*EGE::EGEPacket::generateSBatch(std::move(batchData)));
+    EXPECT(compressed && compressed->decompress());
+    sf::Packet innerPacket;
+    innerPacket << (unsigned int)EGE::EGEPacket::Type::SCompressed;
+    for(int s = 0; s < 1000; s++)
+        innerPacket << (EGE::Uint8)0;
+    EGE::EGEPacket inner(innerPacket);
+    auto twice = EGE::EGEPacket::generateSCompressed(inner);
+    EXPECT(twice && !twice->decompress());
+
+    ::close(fds[0]);
+    ::close(fds[1]);
+    return 0;
+}
+
+TESTCASE(unreliableChannel)
+{
+    sf::UdpSocket serverSocket, clientSocket;
+    EXPECT(serverSocket.bind(sf::Socket::AnyPort) == sf::Socket::Done);
+    EXPECT(clientSocket.bind(sf::Socket::AnyPort) == sf::Socket::Done);
+    EGE::UnreliableChannel server(serverSocket, sf::IpAddress::LocalHost, clientSocket.getLocalPort());
+    EGE::UnreliableChannel client(clientSocket, sf::IpAddress::LocalHost, serverSocket.getLocalPort());
+
+    EGE::Uint8 data[sf::UdpSocket::MaxDatagramSize];
+    std::size_t size;
+    sf::IpAddress address;
+    unsigned short port;
+    EGE::Uint64 token;
+    EXPECT(client.sendHello(0x0123456789abcdefULL));
+    EXPECT(serverSocket.receive(data, sizeof(data), size, address, port) == sf::Socket::Done);
+    EXPECT(EGE::UnreliableChannel::parseHello(data, size, token) && token == 0x0123456789abcdefULL);
+    EXPECT_EQUAL(port, clientSocket.getLocalPort());
+
+    // Updates are split into datagrams that are not fragmented.
+    auto scene = make<EGE::Scene>(nullptr);
+    scene->getRegistry().addType<CompactTestObject>();
+    auto object = scene->addNewObject<CompactTestObject>();
+    for(int s = 0; s < 200; s++)
+    {
+        object->setPosition(EGE::Vec3d(s, 0, 0));
+        EXPECT(server.send(*EGE::EGEPacket::generateSSceneObjectUpdate_Compact(*object)));
+    }
+    EXPECT(server.flush());
+    EXPECT(server.getDatagramsSent() > 1);
+
+    EGE::Vector<EGE::Vector<EGE::Uint8>> datagrams;
+    for(EGE::Uint64 s = 0; s < server.getDatagramsSent(); s++)
+    {
+        EXPECT(clientSocket.receive(data, sizeof(data), size, address, port) == sf::Socket::Done);
+        EXPECT(size <= EGE::UnreliableChannel::MaxDatagramSize);
+        datagrams.emplace_back(data, data + size);
+    }
+
+    // Newest wins, also if datagrams come in different order.
+    EGE::Uint32 sequence1, sequence2;
+    EGE::Vector<EGE::SharedPtr<EGE::EGEPacket>> packets1, packets2;
+    EXPECT(EGE::UnreliableChannel::parse(datagrams.back().data(), datagrams.back().size(), sequence2, packets2));
+    EXPECT(EGE::UnreliableChannel::parse(datagrams[0].data(), datagrams[0].size(), sequence1, packets1));
+    EXPECT(sequence1 < sequence2);
+    EXPECT_EQUAL(packets2.back()->getMainState().position.x, 199.0);
+    EXPECT(client.accept(object->getObjectId(), sequence2));
+    EXPECT(!client.accept(object->getObjectId(), sequence1));
+    EXPECT(!client.accept(object->getObjectId(), sequence2));
+
+    // Object created again: updates sent before aren't applied to it, also
+    // if they come late. Deleted objects are not remembered.
+    client.forget(object->getObjectId());
+    EXPECT(!client.accept(object->getObjectId(), sequence1));
+    EXPECT(!client.accept(object->getObjectId(), sequence2));
+    EXPECT(client.accept(object->getObjectId(), sequence2 + 1));
+    client.markSeen(sequence2 + 5);
+    client.forget(object->getObjectId() + 1);
+    EXPECT(!client.accept(object->getObjectId() + 1, sequence2 + 5));
+    client.remove(object->getObjectId() + 1);
+    EXPECT(client.accept(object->getObjectId() + 1, sequence1));
+
+    // Sequence wraps around.
+    EGE::UnreliableChannel client2(clientSocket, sf::IpAddress::LocalHost, serverSocket.getLocalPort());
+    client2.forget(object->getObjectId());
+    EXPECT(client2.accept(object->getObjectId(), 0xfffffffe));
+    EXPECT(client2.accept(object->getObjectId(), 1));
+    EXPECT(!client2.accept(object->getObjectId(), 0xffffffff));
+    client2.forget(object->getObjectId());
+    EXPECT(!client2.accept(object->getObjectId(), 0xffffffff));
+    EXPECT(client2.accept(object->getObjectId(), 2));
+
+    // Reliable packets can't go there.
+    EGE::Vector<EGE::Uint8> invalid { 0, 0, 0, 1 };
+    auto sfPacket = EGE::EGEPacket::generateSBatch({})->getEncodedData();
+    invalid.insert(invalid.end(), sfPacket->begin(), sfPacket->end());
+    EGE::EGEPacket::appendToBatch(invalid, *EGE::EGEPacket::generateSSceneObjectDeletion(1));
+    EGE::Vector<EGE::SharedPtr<EGE::EGEPacket>> packets;
+    EXPECT(!EGE::UnreliableChannel::parse(invalid.data(), invalid.size(), sequence1, packets));
+    EXPECT(!EGE::UnreliableChannel::parse(invalid.data(), 3, sequence1, packets));
+    return 0;
+}
+
+// Object moves by 1 unit every tick (16 ms), and 5% of packets are lost.
+// Lost TCP segment is retransmitted after 200 ms, and everything sent after
+// it waits for it. Lost datagram is just gone. Measures how old the position
+// that client knows is.
+TESTCASE(unreliableChannelLatency)
+{
+    const int TICKS = 2000;
+    const double LOSS = 0.05;
+    const int RETRANSMIT_TICKS = 12;
+
+    std::mt19937 random(1);
+    std::bernoulli_distribution lost(LOSS);
+
+    InterestTestServer server;
+    auto scene = make<EGE::Scene>(nullptr);
+    scene->getRegistry().addType<CompactTestObject>();
+    auto object = scene->addNewObject<CompactTestObject>();
+
+    // TCP with delta updates.
+    int fds[2];
+    EXPECT(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    EGE::EGEClientConnection tcpClient(server, make<sf::TcpSocket>());
+    auto queue = make<EGE::SendQueue>(fds[0]);
+    tcpClient.setSendQueue(queue);
+    tcpClient.setProtocolVersion(3);
+    tcpClient.setBatchLimit(server.getBatchLimit());
+    tcpClient.resetBaseline(*object);
+    auto tcpState = object->getMainState();
+    std::deque<std::pair<int, std::string>> inFlight;
+    int lastArrival = 0;
+
+    // UDP.
+    sf::UdpSocket serverSocket, clientSocket;
+    EXPECT(serverSocket.bind(sf::Socket::AnyPort) == sf::Socket::Done);
+    EXPECT(clientSocket.bind(sf::Socket::AnyPort) == sf::Socket::Done);
+    EGE::UnreliableChannel udpServer(serverSocket, sf::IpAddress::LocalHost, clientSocket.getLocalPort());
+    EGE::UnreliableChannel udpClient(clientSocket, sf::IpAddress::LocalHost, serverSocket.getLocalPort());
+    double udpX = 0;
+
+    EGE::Vector<int> tcpAge, udpAge;
+    EGE::Uint8 data[sf::UdpSocket::MaxDatagramSize];
+    for(int tick = 1; tick <= TICKS; tick++)
+    {
+        object->setPosition(EGE::Vec3d(tick, 0, 0));
+        auto state = object->getMainState();
+
+        EXPECT(tcpClient.send(tcpClient.makeDeltaUpdate(object->getObjectId(), state)));
+        EXPECT(tcpClient.flushBatch());
+        EXPECT(queue->flush() == EGE::SendQueue::FlushResult::Done);
+        EGE::Uint8 header[4];
+        EXPECT_EQUAL(::recv(fds[1], header, 4, MSG_WAITALL), 4);
+        std::string frame((header[0] << 24) | (header[1] << 16) | (header[2] << 8) | header[3], 0);
+        EXPECT_EQUAL(::recv(fds[1], &frame[0], frame.size(), MSG_WAITALL), (ssize_t)frame.size());
+        lastArrival = std::max(lastArrival, lost(random) ? tick + RETRANSMIT_TICKS : tick);
+        inFlight.emplace_back(lastArrival, std::move(frame));
+        while(!inFlight.empty() && inFlight.front().first <= tick)
+        {
+            sf::Packet sfPacket;
+            sfPacket.append(inFlight.front().second.data(), inFlight.front().second.size());
+            EGE::EGEPacket packet(sfPacket);
+            EXPECT(packet.getType() == EGE::EGEPacket::Type::SSceneObjectUpdate_Delta);
+            EGE::CompactEncoding::mergeMainState(tcpState, packet.getMainState(), packet.getDeltaMask());
+            inFlight.pop_front();
+        }
+        tcpAge.push_back(tick - (int)tcpState.position.x);
+
+        EGE::EGEPacket udpPacket(object->getObjectId(), state);
+        EXPECT(udpServer.send(udpPacket));
+        EXPECT(udpServer.flush());
+        std::size_t size;
+        sf::IpAddress address;
+        unsigned short port;
+        EXPECT(clientSocket.receive(data, sizeof(data), size, address, port) == sf::Socket::Done);
+        EGE::Uint32 sequence;
+        EGE::Vector<EGE::SharedPtr<EGE::EGEPacket>> packets;
+        if(!lost(random) && EGE::UnreliableChannel::parse(data, size, sequence, packets))
+        {
+            for(auto& packet: packets)
+            {
+                if(udpClient.accept(packet->getObjectId(), sequence))
+                    udpX = packet->getMainState().position.x;
+            }
+        }
+        udpAge.push_back(tick - (int)udpX);
+    }
+
+    auto percentile = [](EGE::Vector<int> values, double p) {
+        std::sort(values.begin(), values.end());
+        return values[(EGE::Size)(p * (values.size() - 1))];
+    };
+    int tcp99 = percentile(tcpAge, 0.99), udp99 = percentile(udpAge, 0.99);
+    std::cerr << "position age in ticks (p50/p99/max): TCP " << percentile(tcpAge, 0.5) << "/" << tcp99 << "/" << percentile(tcpAge, 1)
+              << ", UDP " << percentile(udpAge, 0.5) << "/" << udp99 << "/" << percentile(udpAge, 1) << std::endl;
+    EXPECT(udp99 < tcp99);
+    EXPECT(udp99 <= 2);
+
+    ::close(fds[0]);
+    ::close(fds[1]);
+    return 0;
+}
+#endif
+
+TESTCASE(compactEncodingBenchmark)
+{
+    const int COUNT = 1000;
+    auto scene = make<EGE::Scene>(nullptr);
+    scene->getRegistry().addType<CompactTestObject>();
+    EGE::Vector<EGE::SharedPtr<CompactTestObject>> objects;
+    for(int s = 0; s < COUNT; s++)
+    {
+        auto object = scene->addNewObject<CompactTestObject>();
+        object->setPosition(EGE::Vec3d(rand() % 20000 / 10.0, rand() % 20000 / 10.0, 0));
+        object->setMotion(EGE::Vec3d(rand() % 100 / 10.0 - 5, rand() % 100 / 10.0 - 5, 0));
+        object->setRotation(rand() % 360);
+        objects.push_back(object);
+    }
+
+    using Clock = std::chrono::steady_clock;
+    auto measure = [&](auto generate, double& bytes, double& encodeNs, double& decodeNs) {
+        EGE::Vector<sf::Packet> packets;
+        auto start = Clock::now();
+        for(auto& object: objects)
+            packets.push_back(generate(*object)->toSFMLPacket());
+        auto encoded = Clock::now();
+        EGE::Size size = 0;
+        for(auto& packet: packets)
+        {
+            size += packet.getDataSize();
+            EGE::EGEPacket received(packet);
+        }
+        auto decoded = Clock::now();
+        bytes = (double)size / COUNT;
+        encodeNs = std::chrono::duration<double, std::nano>(encoded - start).count() / COUNT;
+        decodeNs = std::chrono::duration<double, std::nano>(decoded - encoded).count() / COUNT;
+    };
+
+    double legacyBytes, legacyEncode, legacyDecode;
+    double compactBytes, compactEncode, compactDecode;
+    measure(EGE::EGEPacket::generateSSceneObjectUpdate_Main, legacyBytes, legacyEncode, legacyDecode);
+    measure(EGE::EGEPacket::generateSSceneObjectUpdate_Compact, compactBytes, compactEncode, compactDecode);
+
+    std::cerr << "legacy:  " << legacyBytes << " B/update, encode " << legacyEncode << " ns, decode " << legacyDecode << " ns" << std::endl;
+    std::cerr << "compact: " << compactBytes << " B/update, encode " << compactEncode << " ns, decode " << compactDecode << " ns" << std::endl;
+    EXPECT(compactBytes * 4 < legacyBytes);
+    return 0;
+}
+
 class MyObjectServerController : public EGE::ServerNetworkController
 {
 public:
@@ -36,10 +36,13 @@
 
 #pragma once
 
+#include <ege/network/AsyncSender.h>
 #include <ege/network/ClientConnection.h>
 #include <ege/network/Client.h>
 #include <ege/network/NetworkEndpoint.h>
+#include <ege/network/NonBlockingConnection.h>
 #include <ege/network/Packet.h>
+#include <ege/network/SendQueue.h>
 #include <ege/network/Server.h>
 #include <ege/network/SFMLNetworkImpl.h>
 #include <ege/network/SFMLPacket.h>
@@ -0,0 +1,184 @@
+/*
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*      ,----  ,----  ,----
+*      |      |      |
+*      |----  | --,  |----
+*      |      |   |  |
+*      '----  '---'  '----
+*
+*     Framework Library for Hexagon
+*
+*    Copyright (c) Sppmacd 2020 - 2021
+*
+*    Permission is hereby granted, free of charge, to any person obtaining a copy
+*    of this software and associated documentation files (the "Software"), to deal
+*    in the Software without restriction, including without limitation the rights
+*    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*    copies of the Software, and to permit persons to whom the Software is
+*    furnished to do so, subject to the following conditions:
+*
+*    The above copyright notice and this permission notice shall be included in all
+*    copies or substantial portions of the Software.
+*
+*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*    SOFTWARE.
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*/
+
+#include "AsyncSender.h"
+
+#ifdef EGE_API_UNIX
+
+#include <ege/debug/Logger.h>
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+namespace EGE
+{
+
+AsyncSender::~AsyncSender()
+{
+    stop();
+}
+
+bool AsyncSender::start()
+{
+    if(m_running)
+        return true;
+
+    if(::pipe(m_wakePipe) < 0)
+    {
+        ege_log.error() << "AsyncSender: Failed to create wake pipe: " << strerror(errno);
+        return false;
+    }
+    for(int fd: m_wakePipe)
+    {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+
+    m_running = true;
+    m_thread = std::thread([this]() { run(); });
+    return true;
+}
+
+void AsyncSender::stop()
+{
+    if(!m_running)
+        return;
+
+    m_running = false;
+    m_wakePending = false;
+    wake();
+    m_thread.join();
+
+    ::close(m_wakePipe[0]);
+    ::close(m_wakePipe[1]);
+    m_wakePipe[0] = m_wakePipe[1] = -1;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_scheduled.clear();
+}
+
+void AsyncSender::add(SharedPtr<SendQueue> queue)
+{
+    std::lock_guard<std::mutex> lock(queue->m_mutex);
+    queue->m_sender = this;
+    if(!queue->m_frames.empty())
+        schedule(queue);
+}
+
+void AsyncSender::schedule(SharedPtr<SendQueue> queue)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_scheduled.push_back(std::move(queue));
+    }
+    wake();
+}
+
+void AsyncSender::wake()
+{
+    // One byte in pipe is enough to wake the thread.
+    if(m_wakePending.exchange(true))
+        return;
+    char byte = 0;
+    if(::write(m_wakePipe[1], &byte, 1) < 0 && errno != EAGAIN)
+        ege_log.error() << "AsyncSender: Failed to wake I/O thread: " << strerror(errno);
+}
+
+void AsyncSender::run()
+{
+    Vector<SharedPtr<SendQueue>> ready;
+    Vector<SharedPtr<SendQueue>> waiting;
+    Vector<pollfd> fds;
+
+    while(m_running)
+    {
+        // Cleared before taking queues, so that queue scheduled after that
+        // wakes us again.
+        m_wakePending = false;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ready.insert(ready.end(), m_scheduled.begin(), m_scheduled.end());
+            m_scheduled.clear();
+        }
+
+        for(auto& queue: ready)
+        {
+            if(queue->flush() == SendQueue::FlushResult::Pending)
+                waiting.push_back(queue);
+        }
+        ready.clear();
+
+        // Wait until something is scheduled or socket of waiting queue
+        // becomes writable. Closed queues have fd -1 and are ignored.
+        fds.clear();
+        fds.push_back({ m_wakePipe[0], POLLIN, 0 });
+        for(auto& queue: waiting)
+            fds.push_back({ queue->getFd(), POLLOUT, 0 });
+
+        if(::poll(fds.data(), fds.size(), -1) < 0 && errno != EINTR)
+        {
+            ege_log.error() << "AsyncSender: poll failed: " << strerror(errno);
+            break;
+        }
+
+        if(fds[0].revents & POLLIN)
+        {
+            char buffer[64];
+            while(::read(m_wakePipe[0], buffer, sizeof(buffer)) > 0)
+                ;
+        }
+
+        Vector<SharedPtr<SendQueue>> stillWaiting;
+        for(Size s = 0; s < waiting.size(); s++)
+        {
+            auto& fd = fds[s + 1];
+            if(fd.fd < 0)
+                continue;
+            if(fd.revents)
+                ready.push_back(waiting[s]);
+            else
+                stillWaiting.push_back(waiting[s]);
+        }
+        waiting.swap(stillWaiting);
+    }
+}
+
+}
+
+#endif
@@ -0,0 +1,85 @@
+/*
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*      ,----  ,----  ,----
+*      |      |      |
+*      |----  | --,  |----
+*      |      |   |  |
+*      '----  '---'  '----
+*
+*     Framework Library for Hexagon
+*
+*    Copyright (c) Sppmacd 2020 - 2021
+*
+*    Permission is hereby granted, free of charge, to any person obtaining a copy
+*    of this software and associated documentation files (the "Software"), to deal
+*    in the Software without restriction, including without limitation the rights
+*    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*    copies of the Software, and to permit persons to whom the Software is
+*    furnished to do so, subject to the following conditions:
+*
+*    The above copyright notice and this permission notice shall be included in all
+*    copies or substantial portions of the Software.
+*
+*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*    SOFTWARE.
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*/
+
+#pragma once
+
+#include "SendQueue.h"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+namespace EGE
+{
+
+// I/O thread that flushes SendQueues (Unix only), so that threads that send
+// packets never block on socket. Queues that can't be sent entirely wait
+// for their sockets to become writable, others are not delayed by them.
+class AsyncSender
+{
+public:
+    AsyncSender() = default;
+    ~AsyncSender();
+
+    AsyncSender(const AsyncSender&) = delete;
+    AsyncSender& operator=(const AsyncSender&) = delete;
+
+    bool start();
+
+    // Queues that were added must be closed before that.
+    void stop();
+
+    // %queue is sent by this thread until it's closed.
+    void add(SharedPtr<SendQueue> queue);
+
+private:
+    friend class SendQueue;
+
+    // Called by queue that got data when it was empty.
+    void schedule(SharedPtr<SendQueue> queue);
+    void wake();
+    void run();
+
+    std::thread m_thread;
+    std::atomic<bool> m_running { false };
+    std::atomic<bool> m_wakePending { false };
+    int m_wakePipe[2] = { -1, -1 };
+
+    std::mutex m_mutex;
+    Vector<SharedPtr<SendQueue>> m_scheduled;
+};
+
+}
@@ -55,6 +55,7 @@ bool Client::connect(sf::IpAddress ip, unsigned short port)
         err(LogLevel::Error) << "0019 EGE/network: Client: Connection failed to (" << ip << ":" << port << ")";
         return false;
     }
+    m_connected = true;
     return true;
 }
 
@@ -36,18 +36,38 @@
 
 #include "NetworkEndpoint.h"
 
+#include "SendQueue.h"
+
 #include <ege/debug/Logger.h>
 #include <iostream>
 
 namespace EGE
 {
 
+NetworkEndpoint::~NetworkEndpoint()
+{
+    // Queue may outlive us in I/O thread, and socket is closed now.
+#ifdef EGE_API_UNIX
+    if(m_sendQueue)
+        m_sendQueue->close();
+#endif
+}
+
 void NetworkEndpoint::disconnect()
 {
     if(!m_connected)
         return;
     m_connected = false;
 
+#ifdef EGE_API_UNIX
+    if(m_sendQueue)
+    {
+        // Try to deliver what's queued (e.g disconnect reason).
+        m_sendQueue->flush();
+        m_sendQueue->close();
+    }
+#endif
+
     if(m_socket)
     {
         err(LogLevel::Info) << "001A EGE/network: Disconnecting network endpoint: " << m_socket->getLocalPort() << " -> " << m_socket->getRemotePort();
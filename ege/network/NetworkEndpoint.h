@@ -36,6 +36,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <memory>
 #include <SFML/Network.hpp>
 
@@ -46,11 +47,14 @@
 namespace EGE
 {
 
+class NonBlockingConnection;
+class SendQueue;
+
 // abstract
 class NetworkEndpoint
 {
 public:
-    virtual ~NetworkEndpoint() {}
+    virtual ~NetworkEndpoint();
 
     // almost always synchronous
     virtual bool send(SharedPtr<Packet> packet) = 0;
@@ -74,10 +78,33 @@ public:
     // synchronous
     virtual void disconnect();
 
+    // Size of frames (with their size prefix) sent and received by this
+    // endpoint, i.e what goes on the wire, without TCP/IP headers.
+    Uint64 getBytesSent() const { return m_bytesSent; }
+    Uint64 getBytesReceived() const { return m_bytesReceived; }
+    void countBytesSent(Uint64 bytes) { m_bytesSent += bytes; }
+    void countBytesReceived(Uint64 bytes) { m_bytesReceived += bytes; }
+
+    // Set by Server with epoll backend. Packets are sent to and received
+    // from its buffers instead of socket.
+    void setBufferedIO(SharedPtr<NonBlockingConnection> io) { m_bufferedIO = io; }
+    SharedPtr<NonBlockingConnection> getBufferedIO() const { return m_bufferedIO; }
+
+    // Set by Server with asynchronous sending. Packets are queued instead of
+    // sent to socket.
+    void setSendQueue(SharedPtr<SendQueue> queue) { m_sendQueue = queue; }
+    SharedPtr<SendQueue> getSendQueue() const { return m_sendQueue; }
+
 protected:
     SharedPtr<sf::TcpSocket> m_socket;
+
+    // Must be destroyed before socket, because it unregisters it from epoll.
+    SharedPtr<NonBlockingConnection> m_bufferedIO;
+    SharedPtr<SendQueue> m_sendQueue;
     bool m_connected = true;
     sf::Mutex m_accessMutex;
+    std::atomic<Uint64> m_bytesSent { 0 };
+    std::atomic<Uint64> m_bytesReceived { 0 };
 };
 
 }
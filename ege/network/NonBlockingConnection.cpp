@@ -0,0 +1,232 @@
+/*
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*      ,----  ,----  ,----
+*      |      |      |
+*      |----  | --,  |----
+*      |      |   |  |
+*      '----  '---'  '----
+*
+*     Framework Library for Hexagon
+*
+*    Copyright (c) Sppmacd 2020 - 2021
+*
+*    Permission is hereby granted, free of charge, to any person obtaining a copy
+*    of this software and associated documentation files (the "Software"), to deal
+*    in the Software without restriction, including without limitation the rights
+*    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*    copies of the Software, and to permit persons to whom the Software is
+*    furnished to do so, subject to the following conditions:
+*
+*    The above copyright notice and this permission notice shall be included in all
+*    copies or substantial portions of the Software.
+*
+*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*    SOFTWARE.
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*/
+#include "NonBlockingConnection.h"
+
+#ifdef EGE_OS_LINUX
+
+#include <ege/debug/Logger.h>
+
+#include <cerrno>
+#include <cstring>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+namespace EGE
+{
+
+NonBlockingConnection::NonBlockingConnection(int fd, int epollFd, Uint64 epollData)
+: m_fd(fd), m_epollFd(epollFd), m_epollData(epollData), m_writeQueue(fd)
+{
+    std::lock_guard<std::mutex> lock(m_writeMutex);
+    m_writeQueue.setLimit(8 * 1024 * 1024, SendQueue::Policy::Disconnect);
+    epoll_event event {};
+    event.events = m_events = EPOLLIN | EPOLLRDHUP;
+    event.data.u64 = m_epollData;
+    if(epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_fd, &event) < 0)
+    {
+        ege_log.error() << "NonBlockingConnection: Failed to register socket in epoll: " << strerror(errno);
+        m_broken = true;
+    }
+}
+
+NonBlockingConnection::~NonBlockingConnection()
+{
+    close();
+}
+
+bool NonBlockingConnection::receive()
+{
+    const Size ChunkSize = 64 * 1024;
+
+    // Don't starve other connections if peer sends faster than we read.
+    // Epoll is level-triggered, so the rest is read next time.
+    const Size MaxChunks = 16;
+
+    // Drop already popped frames.
+    if(m_readOffset > 0)
+    {
+        m_readBuffer.erase(m_readBuffer.begin(), m_readBuffer.begin() + m_readOffset);
+        m_readOffset = 0;
+    }
+
+    for(Size chunks = 0; chunks < MaxChunks;)
+    {
+        Size oldSize = m_readBuffer.size();
+        m_readBuffer.resize(oldSize + ChunkSize);
+        ssize_t count = ::recv(m_fd, m_readBuffer.data() + oldSize, ChunkSize, 0);
+        m_readBuffer.resize(oldSize + (count > 0 ? count : 0));
+        if(count > 0)
+        {
+            if((Size)count < ChunkSize)
+                return true;
+            chunks++;
+            continue;
+        }
+        if(count == 0)
+            return false;
+        if(errno == EINTR)
+            continue;
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    return true;
+}
+
+bool NonBlockingConnection::popFrame(sf::Packet& packet)
+{
+    Size available = m_readBuffer.size() - m_readOffset;
+    if(available < 4)
+        return false;
+
+    const Uint8* header = m_readBuffer.data() + m_readOffset;
+    Size size = ((Uint32)header[0] << 24) | ((Uint32)header[1] << 16) | ((Uint32)header[2] << 8) | header[3];
+    if(size > MaxFrameSize)
+    {
+        ege_log.error() << "NonBlockingConnection: Frame too big (" << size << " bytes)";
+        std::lock_guard<std::mutex> lock(m_writeMutex);
+        m_broken = true;
+        return false;
+    }
+    if(available < size + 4)
+        return false;
+
+    packet.clear();
+    packet.append(header + 4, size);
+    m_readOffset += size + 4;
+    return true;
+}
+
+bool NonBlockingConnection::send(SendQueue::Buffer data, Uint64 coalesceKey)
+{
+    std::lock_guard<std::mutex> lock(m_writeMutex);
+    if(m_broken || m_fd < 0)
+        return false;
+
+    // Something is already waiting for EPOLLOUT, don't reorder.
+    bool waiting = m_writeQueue.getQueuedSize() > 0;
+    if(!m_writeQueue.push(data, coalesceKey))
+        return false;
+    if(waiting)
+    {
+        updateEventsLocked();
+        return true;
+    }
+    return flushLocked();
+}
+
+bool NonBlockingConnection::flush()
+{
+    std::lock_guard<std::mutex> lock(m_writeMutex);
+    return flushLocked();
+}
+
+bool NonBlockingConnection::flushLocked()
+{
+    if(m_broken || m_fd < 0)
+        return false;
+
+    if(m_writeQueue.flush() == SendQueue::FlushResult::Error)
+    {
+        m_broken = true;
+        return false;
+    }
+    updateEventsLocked();
+    return true;
+}
+
+void NonBlockingConnection::close()
+{
+    std::lock_guard<std::mutex> lock(m_writeMutex);
+    if(m_fd < 0)
+        return;
+    epoll_ctl(m_epollFd, EPOLL_CTL_DEL, m_fd, nullptr);
+    m_writeQueue.close();
+    m_fd = -1;
+}
+
+void NonBlockingConnection::setQueueLimits(Size lowWatermark, Size highWatermark, Size maxSize, SendQueue::Policy policy)
+{
+    std::lock_guard<std::mutex> lock(m_writeMutex);
+    m_lowWatermark = lowWatermark;
+    m_highWatermark = highWatermark;
+    m_writeQueue.setLimit(maxSize, policy);
+    updateEventsLocked();
+}
+
+bool NonBlockingConnection::isReadPaused() const
+{
+    std::lock_guard<std::mutex> lock(m_writeMutex);
+    return m_readPaused;
+}
+
+bool NonBlockingConnection::isBroken() const
+{
+    std::lock_guard<std::mutex> lock(m_writeMutex);
+    return m_broken || m_writeQueue.isBroken();
+}
+
+Size NonBlockingConnection::getQueuedSize() const
+{
+    return m_writeQueue.getQueuedSize();
+}
+
+void NonBlockingConnection::updateEventsLocked()
+{
+    if(m_fd < 0)
+        return;
+
+    Size queued = m_writeQueue.getQueuedSize();
+    if(queued > m_highWatermark)
+        m_readPaused = true;
+    else if(queued < m_lowWatermark)
+        m_readPaused = false;
+
+    Uint32 events = EPOLLRDHUP;
+    if(!m_readPaused)
+        events |= EPOLLIN;
+    if(queued > 0)
+        events |= EPOLLOUT;
+    if(events == m_events)
+        return;
+
+    epoll_event event {};
+    event.events = m_events = events;
+    event.data.u64 = m_epollData;
+    epoll_ctl(m_epollFd, EPOLL_CTL_MOD, m_fd, &event);
+}
+
+}
+
+#endif
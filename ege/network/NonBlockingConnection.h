@@ -0,0 +1,122 @@
+/*
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*      ,----  ,----  ,----
+*      |      |      |
+*      |----  | --,  |----
+*      |      |   |  |
+*      '----  '---'  '----
+*
+*     Framework Library for Hexagon
+*
+*    Copyright (c) Sppmacd 2020 - 2021
+*
+*    Permission is hereby granted, free of charge, to any person obtaining a copy
+*    of this software and associated documentation files (the "Software"), to deal
+*    in the Software without restriction, including without limitation the rights
+*    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*    copies of the Software, and to permit persons to whom the Software is
+*    furnished to do so, subject to the following conditions:
+*
+*    The above copyright notice and this permission notice shall be included in all
+*    copies or substantial portions of the Software.
+*
+*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*    SOFTWARE.
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*/
+
+#pragma once
+
+#include "SendQueue.h"
+
+#include <ege/util/OS.h>
+#include <ege/util/Types.h>
+
+#include <mutex>
+#include <SFML/Network.hpp>
+
+namespace EGE
+{
+
+// Buffered I/O of non-blocking TCP socket, used by Server with epoll backend
+// (Linux only). Frames are the same as sf::Packet over sf::TcpSocket uses
+// (32-bit big endian size, then data), so both sides don't need to use the
+// same backend.
+//
+// Sending is thread safe, receiving must be done by one thread.
+class NonBlockingConnection
+{
+public:
+    // Socket %fd must be non-blocking, and it's not owned by connection.
+    // It's registered in %epollFd with %epollData until close().
+    NonBlockingConnection(int fd, int epollFd, Uint64 epollData);
+    ~NonBlockingConnection();
+
+    NonBlockingConnection(const NonBlockingConnection&) = delete;
+    NonBlockingConnection& operator=(const NonBlockingConnection&) = delete;
+
+    // Reads all data that is available now. Returns false if connection was
+    // closed by peer, is broken or peer sent invalid frame. Complete frames
+    // received before that can still be popped.
+    bool receive();
+
+    // Takes next complete frame. Returns false if there is none.
+    bool popFrame(sf::Packet& packet);
+
+    // Queues frame with %data and sends as much as possible without blocking.
+    // Returns false if connection is broken or frame didn't fit in write
+    // queue (see SendQueue::push()).
+    bool send(SendQueue::Buffer data, Uint64 coalesceKey = 0);
+
+    // Sends as much of write queue as possible. Returns false on error.
+    bool flush();
+
+    // Unregisters socket from epoll. Sending fails after that.
+    void close();
+
+    // Peer that doesn't read what we send can't make us buffer unlimited
+    // amount of data: when queue exceeds high watermark, receiving from it is
+    // paused until it drops below low watermark. If it exceeds maximum size,
+    // %policy is applied.
+    void setQueueLimits(Size lowWatermark, Size highWatermark, Size maxSize,
+                        SendQueue::Policy policy = SendQueue::Policy::Disconnect);
+
+    bool isReadPaused() const;
+    bool isBroken() const;
+    Size getQueuedSize() const;
+
+    // Frames bigger than that are treated as protocol error.
+    static const Size MaxFrameSize = 16 * 1024 * 1024;
+
+private:
+    bool flushLocked();
+    void updateEventsLocked();
+
+    int m_fd;
+    int m_epollFd;
+    Uint64 m_epollData;
+    Uint32 m_events = 0;
+
+    // Receive side, used only by receiving thread.
+    Vector<Uint8> m_readBuffer;
+    Size m_readOffset = 0;
+
+    // Guards epoll state; queue has its own lock.
+    mutable std::mutex m_writeMutex;
+    SendQueue m_writeQueue;
+    Size m_lowWatermark = 256 * 1024;
+    Size m_highWatermark = 1024 * 1024;
+    bool m_readPaused = false;
+    bool m_broken = false;
+};
+
+}
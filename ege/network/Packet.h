@@ -36,6 +36,7 @@
 
 #pragma once
 
+#include <ege/util/Types.h>
 #include <SFML/Network.hpp>
 
 namespace EGE
@@ -43,6 +44,15 @@ namespace EGE
 
 class Packet
 {
+public:
+    // Queued packets with the same nonzero key replace each other if they
+    // weren't sent yet (SendQueue::Policy::Coalesce). Set it only for packets
+    // that contain whole state of something, e.g object updates.
+    void setCoalesceKey(Uint64 key) { m_coalesceKey = key; }
+    Uint64 getCoalesceKey() const { return m_coalesceKey; }
+
+private:
+    Uint64 m_coalesceKey = 0;
 };
 
 }
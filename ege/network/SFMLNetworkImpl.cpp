@@ -36,12 +36,23 @@
 
 #include "SFMLNetworkImpl.h"
 
+#include "NonBlockingConnection.h"
+#include "SendQueue.h"
+
 #include <ege/debug/Logger.h>
 #include <iostream>
 
 namespace EGE
 {
 
+// Frames are prefixed with 32-bit size.
+static bool countSent(NetworkEndpoint* endpoint, Size size, bool success)
+{
+    if(success)
+        endpoint->countBytesSent(size + 4);
+    return success;
+}
+
 bool SFMLNetworkImpl::sendTo(NetworkEndpoint* endpoint, SharedPtr<Packet> packet)
 {
     // Abort sending empty packet (or TO empty endpoint) with success state.
@@ -51,7 +62,21 @@ bool SFMLNetworkImpl::sendTo(NetworkEndpoint* endpoint, SharedPtr<Packet> packet
     //sf::Lock lock(endpoint->getMutex());
     SFMLPacket* packet2 = (SFMLPacket*)packet.get();
 
-    sf::Packet sfPacket = packet2->toSFMLPacket();
+    // Broadcast packets are encoded only once, queues share the data.
+    auto data = packet2->getEncodedData();
+
+#ifdef EGE_OS_LINUX
+    if(auto io = endpoint->getBufferedIO())
+        return countSent(endpoint, data->size(), io->send(data, packet->getCoalesceKey()));
+#endif
+
+#ifdef EGE_API_UNIX
+    if(auto queue = endpoint->getSendQueue())
+        return countSent(endpoint, data->size(), queue->push(data, packet->getCoalesceKey()));
+#endif
+
+    sf::Packet sfPacket;
+    sfPacket.append(data->data(), data->size());
     sf::Socket::Status status = endpoint->getSocket().lock()->send(sfPacket);
     if(status != sf::Socket::Done)
     {
@@ -59,7 +84,7 @@ bool SFMLNetworkImpl::sendTo(NetworkEndpoint* endpoint, SharedPtr<Packet> packet
         //endpoint->disconnect();
         return false;
     }
-    return true;
+    return countSent(endpoint, data->size(), true);
 }
 
 SharedPtr<Packet> SFMLNetworkImpl::receiveFrom(NetworkEndpoint* endpoint)
@@ -71,6 +96,18 @@ SharedPtr<Packet> SFMLNetworkImpl::receiveFrom(NetworkEndpoint* endpoint)
     //sf::Lock lock(endpoint->getMutex());
 
     sf::Packet sfPacket;
+
+#ifdef EGE_OS_LINUX
+    // Buffered connections don't block, there may be no complete packet yet.
+    if(auto io = endpoint->getBufferedIO())
+    {
+        if(!io->popFrame(sfPacket))
+            return nullptr;
+        endpoint->countBytesReceived(sfPacket.getDataSize() + 4);
+        return makePacket(sfPacket);
+    }
+#endif
+
     sf::Socket::Status status = endpoint->getSocket().lock()->receive(sfPacket);
     if(status != sf::Socket::Done)
     {
@@ -78,6 +115,7 @@ SharedPtr<Packet> SFMLNetworkImpl::receiveFrom(NetworkEndpoint* endpoint)
         //endpoint->disconnect();
         return nullptr;
     }
+    endpoint->countBytesReceived(sfPacket.getDataSize() + 4);
     return makePacket(sfPacket);
 }
 
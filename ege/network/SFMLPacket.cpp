@@ -36,7 +36,24 @@
 
 #include "SFMLPacket.h"
 
+#include <ege/util/PointerUtils.h>
+
 namespace EGE
 {
-    // currently nothing
+
+SharedPtr<const Vector<Uint8>> SFMLPacket::getEncodedData()
+{
+    // Packet may be sent from many threads at once. They may all encode
+    // it, but they will share one result after that.
+    auto data = std::atomic_load(&m_encodedData);
+    if(data)
+        return data;
+
+    sf::Packet packet = toSFMLPacket();
+    auto begin = (const Uint8*)packet.getData();
+    data = make<Vector<Uint8>>(begin, begin + packet.getDataSize());
+    std::atomic_store(&m_encodedData, data);
+    return data;
+}
+
 }
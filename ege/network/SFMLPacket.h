@@ -38,6 +38,8 @@
 
 #include <SFML/Network.hpp>
 
+#include <ege/util/Types.h>
+
 #include "Packet.h"
 
 namespace EGE
@@ -48,6 +50,14 @@ class SFMLPacket : public Packet
 {
 public:
     virtual sf::Packet toSFMLPacket() = 0;
+
+    // Data of toSFMLPacket(). It's encoded once, and shared by all
+    // connections the packet is sent to, so packet must not be modified
+    // after it was sent.
+    SharedPtr<const Vector<Uint8>> getEncodedData();
+
+private:
+    SharedPtr<const Vector<Uint8>> m_encodedData;
 };
 
 }
@@ -0,0 +1,238 @@
+/*
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*      ,----  ,----  ,----
+*      |      |      |
+*      |----  | --,  |----
+*      |      |   |  |
+*      '----  '---'  '----
+*
+*     Framework Library for Hexagon
+*
+*    Copyright (c) Sppmacd 2020 - 2021
+*
+*    Permission is hereby granted, free of charge, to any person obtaining a copy
+*    of this software and associated documentation files (the "Software"), to deal
+*    in the Software without restriction, including without limitation the rights
+*    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*    copies of the Software, and to permit persons to whom the Software is
+*    furnished to do so, subject to the following conditions:
+*
+*    The above copyright notice and this permission notice shall be included in all
+*    copies or substantial portions of the Software.
+*
+*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*    SOFTWARE.
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*/
+
+#include "SendQueue.h"
+
+#ifdef EGE_API_UNIX
+
+#include "AsyncSender.h"
+
+#include <ege/debug/Logger.h>
+
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace EGE
+{
+
+SendQueue::SendQueue(int fd)
+: m_fd(fd) {}
+
+bool SendQueue::push(Buffer data, Uint64 coalesceKey)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(m_broken || m_fd < 0)
+        return false;
+
+    Size size = data->size();
+    Frame frame { { (Uint8)(size >> 24), (Uint8)(size >> 16), (Uint8)(size >> 8), (Uint8)size }, data, coalesceKey };
+    bool coalesce = m_policy == Policy::Coalesce && coalesceKey != 0;
+
+    // Drop older frame with the same key if it wasn't started yet. The new
+    // one goes to the end, so that it's not overtaken by frames that were
+    // queued after the old one (e.g delta updates of the same object).
+    if(coalesce)
+    {
+        auto it = m_framesByKey.find(coalesceKey);
+        if(it != m_framesByKey.end() && (it->second != m_frontIndex || m_frontOffset == 0))
+        {
+            Frame& old = m_frames[it->second - m_frontIndex];
+            m_queuedSize -= old.data->size() + 4;
+            old.dropped = true;
+            old.data = nullptr;
+            m_framesByKey.erase(it);
+            m_coalesced++;
+        }
+    }
+
+    if(m_queuedSize + size + 4 > m_maxSize)
+    {
+        // Only frames with key can be dropped, the next one with the same
+        // key makes up for them. Others (e.g object creation) can't.
+        if(m_policy == Policy::Drop && coalesceKey != 0)
+        {
+            m_dropped++;
+            return false;
+        }
+        ege_log.error() << "SendQueue: Queue full (" << m_queuedSize << " bytes), peer is not reading";
+        m_broken = true;
+        return false;
+    }
+
+    bool wasEmpty = m_frames.empty();
+    if(coalesce)
+        m_framesByKey[coalesceKey] = m_frontIndex + m_frames.size();
+    m_frames.push_back(std::move(frame));
+    m_queuedSize += size + 4;
+
+    if(wasEmpty && m_sender)
+        m_sender->schedule(shared_from_this());
+    return true;
+}
+
+SendQueue::FlushResult SendQueue::flush()
+{
+    // Enough for most ticks, and below IOV_MAX everywhere.
+    const int MaxIov = 64;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(m_broken || m_fd < 0)
+        return FlushResult::Error;
+
+    popDroppedLocked();
+    while(!m_frames.empty())
+    {
+        iovec iov[MaxIov];
+        int count = 0;
+        Size skip = m_frontOffset;
+        for(auto it = m_frames.begin(); it != m_frames.end() && count + 2 <= MaxIov; it++)
+        {
+            if(it->dropped)
+                continue;
+            if(skip < 4)
+                iov[count++] = { it->header + skip, 4 - skip };
+            Size dataSkip = skip > 4 ? skip - 4 : 0;
+            if(it->data->size() > dataSkip)
+                iov[count++] = { (void*)(it->data->data() + dataSkip), it->data->size() - dataSkip };
+            skip = 0;
+        }
+
+        msghdr message {};
+        message.msg_iov = iov;
+        message.msg_iovlen = count;
+        ssize_t sent = ::sendmsg(m_fd, &message, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if(sent < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            if(errno == EAGAIN || errno == EWOULDBLOCK)
+                return FlushResult::Pending;
+            m_broken = true;
+            return FlushResult::Error;
+        }
+        consumeLocked(sent);
+    }
+    return FlushResult::Done;
+}
+
+void SendQueue::consumeLocked(Size count)
+{
+    m_queuedSize -= count;
+    while(count > 0)
+    {
+        Frame& frame = m_frames.front();
+        Size remaining = frame.data->size() + 4 - m_frontOffset;
+        if(count < remaining)
+        {
+            m_frontOffset += count;
+            return;
+        }
+        count -= remaining;
+        if(frame.key)
+        {
+            auto it = m_framesByKey.find(frame.key);
+            if(it != m_framesByKey.end() && it->second == m_frontIndex)
+                m_framesByKey.erase(it);
+        }
+        m_frames.pop_front();
+        m_frontIndex++;
+        m_frontOffset = 0;
+        popDroppedLocked();
+    }
+}
+
+void SendQueue::popDroppedLocked()
+{
+    // Front frame is never dropped once it's started.
+    while(!m_frames.empty() && m_frames.front().dropped)
+    {
+        m_frames.pop_front();
+        m_frontIndex++;
+    }
+}
+
+void SendQueue::close()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_fd = -1;
+    m_sender = nullptr;
+}
+
+void SendQueue::setLimit(Size maxSize, Policy policy)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_maxSize = maxSize;
+    m_policy = policy;
+}
+
+int SendQueue::getFd() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_fd;
+}
+
+bool SendQueue::isBroken() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_broken;
+}
+
+Size SendQueue::getQueuedSize() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_queuedSize;
+}
+
+Size SendQueue::getDroppedCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_dropped;
+}
+
+Size SendQueue::getCoalescedCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_coalesced;
+}
+
+}
+
+#endif
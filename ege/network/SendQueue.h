@@ -0,0 +1,138 @@
+/*
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*      ,----  ,----  ,----
+*      |      |      |
+*      |----  | --,  |----
+*      |      |   |  |
+*      '----  '---'  '----
+*
+*     Framework Library for Hexagon
+*
+*    Copyright (c) Sppmacd 2020 - 2021
+*
+*    Permission is hereby granted, free of charge, to any person obtaining a copy
+*    of this software and associated documentation files (the "Software"), to deal
+*    in the Software without restriction, including without limitation the rights
+*    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*    copies of the Software, and to permit persons to whom the Software is
+*    furnished to do so, subject to the following conditions:
+*
+*    The above copyright notice and this permission notice shall be included in all
+*    copies or substantial portions of the Software.
+*
+*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*    SOFTWARE.
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*/
+
+#pragma once
+
+#include <ege/util/OS.h>
+#include <ege/util/Types.h>
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace EGE
+{
+
+class AsyncSender;
+
+// Outbound frames of one connection, sent by AsyncSender (Unix only). Frames
+// are the same as sf::Packet over sf::TcpSocket uses (32-bit big endian size,
+// then data). Data buffers are shared, so that the same data queued for many
+// connections is stored once.
+//
+// Pushing is thread safe and never touches the socket.
+class SendQueue : public std::enable_shared_from_this<SendQueue>
+{
+public:
+    typedef SharedPtr<const Vector<Uint8>> Buffer;
+
+    // What to do with peer that doesn't read fast enough, i.e when queue
+    // would exceed its maximum size.
+    enum class Policy
+    {
+        Disconnect, // Connection is broken, server kicks it.
+        Drop,       // Frames with coalesce key that don't fit are discarded,
+                    // other frames break connection.
+        Coalesce    // Frames with coalesce key replace unsent frame with the
+                    // same key (and are moved to the end of queue); if it
+                    // still doesn't fit, disconnect.
+    };
+
+    enum class FlushResult
+    {
+        Done,    // Everything sent.
+        Pending, // Socket would block, wait until it's writable.
+        Error    // Connection is broken.
+    };
+
+    // Socket %fd is not owned by queue.
+    explicit SendQueue(int fd);
+
+    SendQueue(const SendQueue&) = delete;
+    SendQueue& operator=(const SendQueue&) = delete;
+
+    // Queues frame with %data. Returns false if connection is broken or
+    // frame was dropped. See Packet::getCoalesceKey().
+    bool push(Buffer data, Uint64 coalesceKey = 0);
+
+    // Sends as much as possible without blocking, using vectored writes.
+    // Called by AsyncSender.
+    FlushResult flush();
+
+    // Stops sending; nothing touches the socket after that.
+    void close();
+
+    void setLimit(Size maxSize, Policy policy);
+
+    int getFd() const;
+    bool isBroken() const;
+    Size getQueuedSize() const;
+    Size getDroppedCount() const;
+    Size getCoalescedCount() const;
+
+private:
+    friend class AsyncSender;
+
+    struct Frame
+    {
+        Uint8 header[4];
+        Buffer data;
+        Uint64 key;
+        bool dropped = false; // Replaced by newer frame, not sent.
+    };
+
+    void consumeLocked(Size count);
+    void popDroppedLocked();
+
+    int m_fd;
+    AsyncSender* m_sender = nullptr;
+
+    mutable std::mutex m_mutex;
+    std::deque<Frame> m_frames;
+    Uint64 m_frontIndex = 0; // Index of m_frames.front() since start
+    Size m_frontOffset = 0;  // Bytes of front frame that are already sent
+    Size m_queuedSize = 0;
+    std::unordered_map<Uint64, Uint64> m_framesByKey;
+
+    Size m_maxSize = 4 * 1024 * 1024;
+    Policy m_policy = Policy::Disconnect;
+    bool m_broken = false;
+    Size m_dropped = 0;
+    Size m_coalesced = 0;
+};
+
+}
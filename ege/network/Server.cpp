@@ -36,15 +36,81 @@
 
 #include "Server.h"
 
+#include "NonBlockingConnection.h"
+
 #include <ege/debug/Logger.h>
 #include <iostream>
 #include <string.h>
 
+#ifdef EGE_OS_LINUX
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
 namespace EGE
 {
 
+// Accepted sockets, their handles are used by buffered and asynchronous I/O.
+class ServerSocket : public sf::TcpSocket
+{
+public:
+    using sf::TcpSocket::getHandle;
+};
+
+#ifdef EGE_OS_LINUX
+// Epoll event data of listening socket. Clients use their IDs, that are
+// always greater than 0.
+static const Uint64 EPOLL_LISTENER = 0;
+
+// sf::TcpSocket that takes ownership of socket created outside of SFML.
+class AdoptedTcpSocket : public ServerSocket
+{
+public:
+    explicit AdoptedTcpSocket(int fd)
+    {
+        // SFML would make the socket blocking again.
+        setBlocking(false);
+        create(fd);
+    }
+};
+#endif
+
+Server::~Server()
+{
+    closeClients();
+#ifdef EGE_OS_LINUX
+    closeEpoll();
+#endif
+}
+
+bool Server::isAsyncSend() const
+{
+#ifdef EGE_API_UNIX
+    return m_asyncSend && m_ioBackend == IOBackend::Selector;
+#else
+    return false;
+#endif
+}
+
 bool Server::start()
 {
+    if(m_ioBackend == IOBackend::Epoll)
+    {
+#ifdef EGE_OS_LINUX
+        if(!startEpoll())
+            return false;
+        ege_log.info() << "Server listening on " << m_serverPort << " (epoll)";
+        return true;
+#else
+        ege_log.error() << "Epoll server backend is not supported on this platform";
+        return false;
+#endif
+    }
+
     sf::Socket::Status status = m_listener.listen(m_serverPort);
     if(status != sf::Socket::Done)
     {
@@ -52,6 +118,10 @@ bool Server::start()
         return false;
     }
     m_selector.add(m_listener);
+#ifdef EGE_API_UNIX
+    if(isAsyncSend() && !m_sender.start())
+        return false;
+#endif
     ege_log.info() << "Server listening on " << m_serverPort;
     return true;
 }
@@ -60,11 +130,15 @@ void Server::close()
 {
     ege_log.info() << "Closing server";
     m_selector.clear();
+    closeClients();
     {
         sf::Lock lock(m_clientsAccessMutex);
         m_clients.clear();
     }
     m_listener.close();
+#ifdef EGE_OS_LINUX
+    closeEpoll();
+#endif
 }
 
 // synchronous
@@ -116,6 +190,30 @@ std::vector<std::weak_ptr<ClientConnection>> Server::getClients(std::function<bo
 
 int Server::addClient(SharedPtr<ClientConnection> client)
 {
+    // Buffered connection is registered in epoll with client ID, and it
+    // must exist before onClientConnect() sends anything.
+    int id = m_lastClientUid + 1;
+    client->setID(id);
+#ifdef EGE_OS_LINUX
+    if(m_ioBackend == IOBackend::Epoll)
+    {
+        int fd = ((ServerSocket*)client->getSocket().lock().get())->getHandle();
+        auto io = make<NonBlockingConnection>(fd, m_epollFd, id);
+        io->setQueueLimits(256 * 1024, 1024 * 1024, m_sendQueueLimit, m_sendQueuePolicy);
+        client->setBufferedIO(io);
+    }
+#endif
+#ifdef EGE_API_UNIX
+    if(isAsyncSend())
+    {
+        int fd = ((ServerSocket*)client->getSocket().lock().get())->getHandle();
+        auto queue = make<SendQueue>(fd);
+        queue->setLimit(m_sendQueueLimit, m_sendQueuePolicy);
+        client->setSendQueue(queue);
+        m_sender.add(queue);
+    }
+#endif
+
     EventResult result = onClientConnect(*client);
     if(result == EventResult::Failure)
     {
@@ -123,16 +221,30 @@ int Server::addClient(SharedPtr<ClientConnection> client)
         return 0;
     }
 
-    m_lastClientUid++;
-    client->setID(m_lastClientUid);
+    m_lastClientUid = id;
     {
         sf::Lock lock(m_clientsAccessMutex);
         m_clients.insert(std::make_pair(m_lastClientUid, client));
     }
-    m_selector.add(*client->getSocket().lock().get());
+    if(m_ioBackend == IOBackend::Selector)
+        m_selector.add(*client->getSocket().lock().get());
     return m_lastClientUid;
 }
 
+void Server::acceptClient(SharedPtr<sf::TcpSocket> socket)
+{
+    SharedPtr<ClientConnection> client = makeClient(*this, socket);
+    if(client)
+    {
+        int id = addClient(client);
+        if(id)
+        {
+            // TODO: onClientSuccessfulConnect()
+            ege_log.info() << "Client connected (" << socket->getRemoteAddress() << ":" << socket->getRemotePort() << ")";
+        }
+    }
+}
+
 void Server::kickClient(ClientConnection& client)
 {
     // Don't kick already kicked clients!
@@ -143,93 +255,249 @@ void Server::kickClient(ClientConnection& client)
     onClientDisconnect(client);
 
     // close socket etc.
-    m_selector.remove(*client.getSocket().lock().get());
+#ifdef EGE_OS_LINUX
+    if(auto io = client.getBufferedIO())
+    {
+        // Try to deliver what's queued (e.g disconnect reason).
+        io->flush();
+        io->close();
+    }
+#endif
+#ifdef EGE_API_UNIX
+    if(auto queue = client.getSendQueue())
+    {
+        queue->flush();
+        queue->close();
+    }
+#endif
+    if(m_ioBackend == IOBackend::Selector)
+        m_selector.remove(*client.getSocket().lock().get());
     client.kick();
 
     // remove client from array
     sf::Lock lock(m_clientsAccessMutex);
-    m_clients.erase(m_clients.find(client.getID()));
+    auto it = m_clients.find(client.getID());
+    if(it != m_clients.end())
+        m_clients.erase(it);
 }
 
 // accepts new clients, removes disconnected clients, etc.
 void Server::select()
 {
-    strerror(errno);
+#ifdef EGE_OS_LINUX
+    if(m_ioBackend == IOBackend::Epoll)
+    {
+        selectEpoll();
+        return;
+    }
+#endif
+    selectSFML();
+}
+
+void Server::selectSFML()
+{
     if(m_selector.wait(sf::seconds(2)))
     {
         if(m_selector.isReady(m_listener))
         {
-            SharedPtr<sf::TcpSocket> socket = make<sf::TcpSocket>();
+            SharedPtr<sf::TcpSocket> socket = make<ServerSocket>();
             sf::Socket::Status status2 = m_listener.accept(*socket);
 
             if(status2 == sf::Socket::Done)
-            {
-                SharedPtr<ClientConnection> client = makeClient(*this, socket);
-                if(client)
-                {
-                    int id = addClient(client);
-                    if(id)
-                    {
-                        // TODO: onClientSuccessfulConnect()
-                        ege_log.info() << "Client connected (" << socket->getRemoteAddress() << ":" << socket->getRemotePort() << ")";
-                    }
-                }
-            }
+                acceptClient(socket);
         }
 
+        Vector<SharedPtr<ClientConnection>> clientsToKick;
         {
             sf::Lock lock(m_clientsAccessMutex);
-            if(!m_clients.empty())
+            for(auto& pr : m_clients)
             {
-                for(auto& pr : m_clients)
+                std::weak_ptr<sf::TcpSocket> sck = pr.second->getSocket();
+                if(m_selector.isReady(*sck.lock().get()))
                 {
-                    std::weak_ptr<sf::TcpSocket> sck = pr.second->getSocket();
-                    if(m_selector.isReady(*sck.lock().get()))
+                    SharedPtr<Packet> packet = pr.second->receive();
+                    if(packet)
                     {
-                        SharedPtr<Packet> packet = pr.second->receive();
-                        if(packet)
+                        EventResult result = onReceive(*pr.second, packet);
+                        if(result == EventResult::Failure)
                         {
-                            EventResult result = onReceive(*pr.second, packet);
-                            if(result == EventResult::Failure)
-                            {
-                                ege_log.error() << "Event Receive failed (rejected by EventHandler)";
-                                kickClient(*pr.second);
-
-                                // FIXME: update `it' instead of giving up on one client !! :)
-                                break;
-                            }
-                        }
-                        else
-                        {
-                            kickClient(*pr.second);
-
-                            // FIXME: update `it' instead of giving up on one client !! :)
-                            break;
+                            ege_log.error() << "Event Receive failed (rejected by EventHandler)";
+                            clientsToKick.push_back(pr.second);
                         }
                     }
+                    else
+                        clientsToKick.push_back(pr.second);
                 }
             }
         }
 
-        // check if any client disconnected itself explicitly
+        // Kicking modifies client list, so it's done after iteration.
+        for(auto& client: clientsToKick)
+            kickClient(*client);
+    }
+
+    // Send queues may break without any socket activity.
+    kickDisconnectedClients();
+}
+
+void Server::closeClients()
+{
+    // Sockets are closed with clients, so I/O thread must not use them
+    // anymore.
+#ifdef EGE_API_UNIX
+    {
+        sf::Lock lock(m_clientsAccessMutex);
+        for(auto& pr : m_clients)
+        {
+            if(auto queue = pr.second->getSendQueue())
+                queue->close();
+        }
+    }
+    m_sender.stop();
+#endif
+}
+
+void Server::kickDisconnectedClients()
+{
+    // check if any client disconnected itself explicitly
+    Vector<SharedPtr<ClientConnection>> clientsToKick;
+    {
+        sf::Lock lock(m_clientsAccessMutex);
+        for(auto& pr : m_clients)
+        {
+            bool broken = false;
+#ifdef EGE_OS_LINUX
+            auto io = pr.second->getBufferedIO();
+            broken = io && io->isBroken();
+#endif
+#ifdef EGE_API_UNIX
+            auto queue = pr.second->getSendQueue();
+            broken = broken || (queue && queue->isBroken());
+#endif
+            if(!pr.second->isConnected() || broken)
+                clientsToKick.push_back(pr.second);
+        }
+    }
+    for(auto& client: clientsToKick)
+    {
+        if(client->getSocket().expired())
+            continue;
+        ege_log.info() << "Kicking client " << client->getSocket().lock()->getRemoteAddress() << ":" << client->getSocket().lock()->getRemotePort() << " due to explicit disconnect";
+        kickClient(*client);
+    }
+}
+
+#ifdef EGE_OS_LINUX
+bool Server::startEpoll()
+{
+    m_listenFd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(m_listenFd < 0)
+    {
+        ege_log.error() << "Failed to create server socket: " << strerror(errno);
+        return false;
+    }
+
+    int yes = 1;
+    setsockopt(m_listenFd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+    sockaddr_in address {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(m_serverPort);
+    if(::bind(m_listenFd, (sockaddr*)&address, sizeof(address)) < 0 || ::listen(m_listenFd, SOMAXCONN) < 0)
+    {
+        ege_log.error() << "Failed to start server on " << m_serverPort << ": " << strerror(errno);
+        closeEpoll();
+        return false;
+    }
+
+    m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event event {};
+    event.events = EPOLLIN;
+    event.data.u64 = EPOLL_LISTENER;
+    if(m_epollFd < 0 || epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_listenFd, &event) < 0)
+    {
+        ege_log.error() << "Failed to initialize epoll: " << strerror(errno);
+        closeEpoll();
+        return false;
+    }
+    return true;
+}
+
+void Server::closeEpoll()
+{
+    if(m_listenFd >= 0)
+        ::close(m_listenFd);
+    if(m_epollFd >= 0)
+        ::close(m_epollFd);
+    m_listenFd = -1;
+    m_epollFd = -1;
+}
+
+void Server::selectEpoll()
+{
+    const int MaxEvents = 256;
+    epoll_event events[MaxEvents];
+    int count = epoll_wait(m_epollFd, events, MaxEvents, 2000);
+
+    Vector<SharedPtr<ClientConnection>> clientsToKick;
+    for(int s = 0; s < count; s++)
+    {
+        auto& event = events[s];
+        if(event.data.u64 == EPOLL_LISTENER)
+        {
+            // Accept everything that is waiting.
+            while(true)
+            {
+                int fd = ::accept4(m_listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if(fd < 0)
+                    break;
+                acceptClient(make<AdoptedTcpSocket>(fd));
+            }
+            continue;
+        }
+
+        // Client might be kicked in the meantime.
+        SharedPtr<ClientConnection> client;
         {
             sf::Lock lock(m_clientsAccessMutex);
-            if(!m_clients.empty())
+            auto it = m_clients.find((int)event.data.u64);
+            if(it == m_clients.end())
+                continue;
+            client = it->second;
+        }
+        auto io = client->getBufferedIO();
+        bool alive = !(event.events & EPOLLERR);
+
+        if(alive && (event.events & EPOLLOUT))
+            alive = io->flush();
+
+        if(alive && (event.events & (EPOLLIN | EPOLLHUP | EPOLLRDHUP)))
+        {
+            // Packets that came before connection was closed are still handled.
+            alive = io->receive();
+            while(auto packet = client->receive())
             {
-                for(auto& pr : m_clients)
+                sf::Lock lock(m_clientsAccessMutex);
+                if(onReceive(*client, packet) == EventResult::Failure)
                 {
-                    if(!pr.second->isConnected())
-                    {
-                        ege_log.info() << "Kicking client " << pr.second->getSocket().lock()->getRemoteAddress() << ":" << pr.second->getSocket().lock()->getRemotePort() << " due to explicit disconnect";
-                        kickClient(*pr.second);
-
-                        // FIXME: update `it' instead of giving up on one client !! :)
-                        break;
-                    }
+                    ege_log.error() << "Event Receive failed (rejected by EventHandler)";
+                    alive = false;
+                    break;
                 }
             }
         }
+
+        if(!alive)
+            clientsToKick.push_back(client);
     }
+
+    // Kicking modifies client list, so it's done after iteration.
+    for(auto& client: clientsToKick)
+        kickClient(*client);
+
+    kickDisconnectedClients();
 }
+#endif
 
 }
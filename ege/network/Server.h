@@ -36,11 +36,14 @@
 
 #pragma once
 
+#include "AsyncSender.h"
 #include "ClientConnection.h"
 #include "Packet.h"
+#include "SendQueue.h"
 
 #include <ege/core/EventResult.h>
 #include <ege/main/Config.h>
+#include <ege/util/OS.h>
 #include <ege/util/PointerUtils.h>
 #include <functional>
 #include <map>
@@ -57,10 +60,33 @@ public:
     Server(int port = 0)
     : m_serverPort(port) {}
 
+    virtual ~Server();
+
+    enum class IOBackend
+    {
+        Selector, // sf::SocketSelector and blocking sockets
+        Epoll     // epoll and non-blocking sockets with buffered I/O (Linux only)
+    };
+
+    // Must be called before start().
+    void setIOBackend(IOBackend backend) { m_ioBackend = backend; }
+    IOBackend getIOBackend() const { return m_ioBackend; }
+
+    // With Selector backend, packets are queued per client and sent by
+    // separate I/O thread, so that sending never blocks on socket of slow
+    // client (Unix only; epoll backend doesn't block anyway). Enabled by
+    // default. Must be called before start().
+    void setAsyncSend(bool async) { m_asyncSend = async; }
+    bool isAsyncSend() const;
+
+    // Maximum amount of data queued for a client, and what to do if it's
+    // exceeded (both backends). Applies to clients connected after that.
+    void setSendQueueLimit(Size maxSize, SendQueue::Policy policy) { m_sendQueueLimit = maxSize; m_sendQueuePolicy = policy; }
+
     bool start();
     void close();
 
-    // synchronous
+    // synchronous, unless asynchronous sending is enabled
     bool sendTo(SharedPtr<Packet> packet, int id);
     bool sendToAll(SharedPtr<Packet> packet);
     bool sendTo(SharedPtr<Packet> packet, std::function<bool(ClientConnection&)> predicate);
@@ -95,11 +121,29 @@ protected:
 
 private:
     int addClient(SharedPtr<ClientConnection>);
+    void acceptClient(SharedPtr<sf::TcpSocket> socket);
+    void kickDisconnectedClients();
+
+    void selectSFML();
+    void closeClients();
+
+#ifdef EGE_OS_LINUX
+    bool startEpoll();
+    void closeEpoll();
+    void selectEpoll();
+#endif
 
     ClientMap m_clients;
     sf::TcpListener m_listener;
     sf::SocketSelector m_selector;
     int m_lastClientUid = 1;
+    IOBackend m_ioBackend = IOBackend::Selector;
+    int m_epollFd = -1;
+    int m_listenFd = -1;
+    bool m_asyncSend = true;
+    Size m_sendQueueLimit = 4 * 1024 * 1024;
+    SendQueue::Policy m_sendQueuePolicy = SendQueue::Policy::Disconnect;
+    AsyncSender m_sender;
 };
 
 }
@@ -2,8 +2,21 @@
 
 #include <ege/network/Server.h>
 #include <ege/network/Client.h>
+#include <ege/network/NonBlockingConnection.h>
+#include <ege/network/SendQueue.h>
 #include <ege/network/SFMLNetworkImpl.h>
 
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#ifdef EGE_OS_LINUX
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
 int PORT;
 
 class MyPacket : public EGE::SFMLPacket
@@ -233,4 +246,371 @@ TESTCASE(abstract)
     return 0;
 }
 
+#ifdef EGE_OS_LINUX
+class EchoServer : public EGE::Server
+{
+public:
+    EchoServer(int port)
+    : EGE::Server(port) { setIOBackend(IOBackend::Epoll); }
+
+    EGE::SharedPtr<EGE::ClientConnection> makeClient(EGE::Server& server, EGE::SharedPtr<sf::TcpSocket> socket)
+    {
+        return make<MyClientConnection>(server, socket);
+    }
+
+    virtual EGE::EventResult onClientConnect(EGE::ClientConnection&) { return EGE::EventResult::Success; }
+    virtual EGE::EventResult onClientDisconnect(EGE::ClientConnection&) { return EGE::EventResult::Success; }
+
+    virtual EGE::EventResult onReceive(EGE::ClientConnection& client, EGE::SharedPtr<EGE::Packet> packet)
+    {
+        client.send(packet);
+        return EGE::EventResult::Success;
+    }
+
+    std::atomic<bool> running { true };
+};
+
+// Blocking client that speaks sf::Packet framing over plain socket.
+class LoadTestClient
+{
+public:
+    bool connect(int port)
+    {
+        m_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(port);
+        return ::connect(m_fd, (sockaddr*)&address, sizeof(address)) == 0;
+    }
+
+    ~LoadTestClient() { if(m_fd >= 0) ::close(m_fd); }
+
+    bool send(std::string message, int flags = 0)
+    {
+        sf::Packet packet;
+        packet << message;
+        EGE::Uint32 size = htonl(packet.getDataSize());
+        std::string frame((const char*)&size, 4);
+        frame.append((const char*)packet.getData(), packet.getDataSize());
+        return ::send(m_fd, frame.data(), frame.size(), flags | MSG_NOSIGNAL) == (ssize_t)frame.size();
+    }
+
+    bool receive(std::string& message)
+    {
+        EGE::Uint32 size;
+        if(!readAll(&size, 4))
+            return false;
+        std::string data(ntohl(size), 0);
+        if(!readAll(&data[0], data.size()))
+            return false;
+        sf::Packet packet;
+        packet.append(data.data(), data.size());
+        return (bool)(packet >> message);
+    }
+
+private:
+    bool readAll(void* buffer, size_t size)
+    {
+        size_t done = 0;
+        while(done < size)
+        {
+            ssize_t count = ::recv(m_fd, (char*)buffer + done, size - done, 0);
+            if(count <= 0)
+                return false;
+            done += count;
+        }
+        return true;
+    }
+
+    int m_fd = -1;
+};
+
+TESTCASE(epollLoad)
+{
+    const int CLIENTS = 1000;
+    const int MESSAGES = 20;
+
+    srand(time(NULL));
+    int port = rand() % 30000 + 20000;
+    EchoServer server(port);
+    EXPECT(server.start());
+
+    std::thread serverThread([&server]() {
+        while(server.running)
+            server.select();
+    });
+
+    // This one sends a lot and never reads. It must not stall others.
+    LoadTestClient slowClient;
+    EXPECT(slowClient.connect(port));
+    std::string bigMessage(1024, 'x');
+    for(int s = 0; s < 4096; s++)
+        slowClient.send(bigMessage, MSG_DONTWAIT);
+
+    auto start = std::chrono::steady_clock::now();
+    EGE::Vector<EGE::UniquePtr<LoadTestClient>> clients;
+    for(int s = 0; s < CLIENTS; s++)
+    {
+        clients.push_back(std::make_unique<LoadTestClient>());
+        EXPECT(clients.back()->connect(port));
+    }
+    for(int m = 0; m < MESSAGES; m++)
+    for(int s = 0; s < CLIENTS; s++)
+        EXPECT(clients[s]->send(std::to_string(s) + ":" + std::to_string(m)));
+
+    int received = 0;
+    for(int s = 0; s < CLIENTS; s++)
+    for(int m = 0; m < MESSAGES; m++)
+    {
+        std::string message;
+        if(clients[s]->receive(message) && message == std::to_string(s) + ":" + std::to_string(m))
+            received++;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << CLIENTS << " clients, " << received << " echoes in " << seconds << " s ("
+              << received / seconds << " msg/s)" << std::endl;
+    EXPECT_EQUAL(received, CLIENTS * MESSAGES);
+
+    // Server keeps at most its limit for the slow client.
+    auto slowConnections = server.getClients([](EGE::ClientConnection& client) {
+        return client.getBufferedIO()->getQueuedSize() > 0;
+    });
+    for(auto& client: slowConnections)
+    {
+        auto io = client.lock()->getBufferedIO();
+        std::cerr << "slow client: " << io->getQueuedSize() << " bytes queued, reading " << (io->isReadPaused() ? "paused" : "active") << std::endl;
+        EXPECT(io->getQueuedSize() <= 8 * 1024 * 1024);
+    }
+
+    server.running = false;
+    clients.clear();
+    serverThread.join();
+    server.close();
+    return 0;
+}
+
+static EGE::SendQueue::Buffer makeFrameData(std::string str)
+{
+    return make<EGE::Vector<EGE::Uint8>>(str.begin(), str.end());
+}
+
+static std::string readFrames(int fd)
+{
+    std::string result;
+    char buffer[4096];
+    ssize_t count;
+    while((count = ::recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0)
+        result.append(buffer, count);
+    return result;
+}
+
+TESTCASE(sendQueue)
+{
+    int fds[2];
+    EXPECT(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+    // Frames are sent with size prefix, in order.
+    {
+        auto queue = make<EGE::SendQueue>(fds[0]);
+        EXPECT(queue->push(makeFrameData("abc")));
+        EXPECT(queue->push(makeFrameData("")));
+        EXPECT(queue->push(makeFrameData("de")));
+        EXPECT_EQUAL(queue->getQueuedSize(), 17u);
+        EXPECT(queue->flush() == EGE::SendQueue::FlushResult::Done);
+        EXPECT_EQUAL(queue->getQueuedSize(), 0u);
+        EXPECT(readFrames(fds[1]) == std::string("\0\0\0\3abc\0\0\0\0\0\0\0\2de", 17));
+    }
+
+    // Newer frame with the same key replaces the queued one. It's queued at
+    // the end, so that frames pushed after the old one (like deltas) are not
+    // applied after it.
+    {
+        auto queue = make<EGE::SendQueue>(fds[0]);
+        queue->setLimit(1024, EGE::SendQueue::Policy::Coalesce);
+        EXPECT(queue->push(makeFrameData("a1"), 1));
+        EXPECT(queue->push(makeFrameData("b"), 2));
+        EXPECT(queue->push(makeFrameData("c"), 0));
+        EXPECT(queue->push(makeFrameData("a22"), 1));
+        EXPECT_EQUAL(queue->getCoalescedCount(), 1u);
+        EXPECT_EQUAL(queue->getQueuedSize(), 17u);
+        EXPECT(queue->flush() == EGE::SendQueue::FlushResult::Done);
+        EXPECT(readFrames(fds[1]) == std::string("\0\0\0\1b\0\0\0\1c\0\0\0\3a22", 17));
+
+        // Sent frames are not replaced.
+        EXPECT(queue->push(makeFrameData("a3"), 1));
+        EXPECT_EQUAL(queue->getCoalescedCount(), 1u);
+        EXPECT(queue->flush() == EGE::SendQueue::FlushResult::Done);
+        readFrames(fds[1]);
+
+        // Replaced frame at the front is skipped too.
+        EXPECT(queue->push(makeFrameData("d1"), 3));
+        EXPECT(queue->push(makeFrameData("d2"), 3));
+        EXPECT(queue->flush() == EGE::SendQueue::FlushResult::Done);
+        EXPECT(readFrames(fds[1]) == std::string("\0\0\0\2d2", 6));
+    }
+    readFrames(fds[1]);
+
+    // Frames with key over limit are dropped, other frames can't be.
+    {
+        auto queue = make<EGE::SendQueue>(fds[0]);
+        queue->setLimit(10, EGE::SendQueue::Policy::Drop);
+        EXPECT(queue->push(makeFrameData("1234")));
+        EXPECT(!queue->push(makeFrameData("5678"), 1));
+        EXPECT(!queue->isBroken());
+        EXPECT_EQUAL(queue->getDroppedCount(), 1u);
+        EXPECT(!queue->push(makeFrameData("5678")));
+        EXPECT(queue->isBroken());
+    }
+
+    // ...or break connection.
+    {
+        auto queue = make<EGE::SendQueue>(fds[0]);
+        queue->setLimit(10, EGE::SendQueue::Policy::Disconnect);
+        EXPECT(queue->push(makeFrameData("1234")));
+        EXPECT(!queue->push(makeFrameData("5678")));
+        EXPECT(queue->isBroken());
+        EXPECT(queue->flush() == EGE::SendQueue::FlushResult::Error);
+    }
+
+    // Closed queue doesn't touch socket.
+    {
+        auto queue = make<EGE::SendQueue>(fds[0]);
+        queue->close();
+        EXPECT(!queue->push(makeFrameData("x")));
+        EXPECT(queue->flush() == EGE::SendQueue::FlushResult::Error);
+    }
+
+    ::close(fds[0]);
+    ::close(fds[1]);
+    return 0;
+}
+
+class CountingPacket : public EGE::SFMLPacket
+{
+public:
+    virtual sf::Packet toSFMLPacket()
+    {
+        encodeCount++;
+        sf::Packet packet;
+        packet << std::string(1024, 'x');
+        return packet;
+    }
+
+    int encodeCount = 0;
+};
+
+class SinkServer : public EGE::Server
+{
+public:
+    SinkServer(int port)
+    : EGE::Server(port) {}
+
+    EGE::SharedPtr<EGE::ClientConnection> makeClient(EGE::Server& server, EGE::SharedPtr<sf::TcpSocket> socket)
+    {
+        return make<MyClientConnection>(server, socket);
+    }
+
+    virtual EGE::EventResult onClientConnect(EGE::ClientConnection&) { return EGE::EventResult::Success; }
+    virtual EGE::EventResult onClientDisconnect(EGE::ClientConnection&) { return EGE::EventResult::Success; }
+    virtual EGE::EventResult onReceive(EGE::ClientConnection&, EGE::SharedPtr<EGE::Packet>) { return EGE::EventResult::Success; }
+
+    std::atomic<bool> running { true };
+};
+
+TESTCASE(sharedEncoding)
+{
+    const int CLIENTS = 3;
+
+    // Broadcast packet is encoded once, and all queues share its data.
+    SinkServer server(0);
+    EGE::Vector<EGE::SharedPtr<MyClientConnection>> clients;
+    int fds[CLIENTS][2];
+    for(int s = 0; s < CLIENTS; s++)
+    {
+        EXPECT(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds[s]) == 0);
+        clients.push_back(make<MyClientConnection>(server, make<sf::TcpSocket>()));
+        clients.back()->setSendQueue(make<EGE::SendQueue>(fds[s][0]));
+    }
+
+    auto packet = make<CountingPacket>();
+    for(auto& client: clients)
+        EXPECT(client->send(packet));
+    EXPECT_EQUAL(packet->encodeCount, 1);
+    EXPECT_EQUAL(packet->getEncodedData().use_count(), CLIENTS + 2);
+
+    for(auto& client: clients)
+        EXPECT(client->getSendQueue()->flush() == EGE::SendQueue::FlushResult::Done);
+    EXPECT_EQUAL(packet->getEncodedData().use_count(), 2);
+
+    clients.clear();
+    for(auto& pair: fds)
+    {
+        ::close(pair[0]);
+        ::close(pair[1]);
+    }
+    return 0;
+}
+
+TESTCASE(asyncSend)
+{
+    const int TICKS = 1024;
+
+    srand(time(NULL));
+    int port = rand() % 30000 + 20000;
+    SinkServer server(port);
+    server.setSendQueueLimit(256 * 1024, EGE::SendQueue::Policy::Disconnect);
+    EXPECT(server.isAsyncSend());
+    EXPECT(server.start());
+
+    std::thread serverThread([&server]() {
+        while(server.running)
+            server.select();
+    });
+
+    // One client reads everything, the other one nothing.
+    LoadTestClient reader, slowClient;
+    EXPECT(reader.connect(port));
+    EXPECT(slowClient.connect(port));
+    while(server.getClients([](EGE::ClientConnection&) { return true; }).size() < 2)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    std::atomic<int> received { 0 };
+    std::thread readerThread([&reader, &received]() {
+        std::string message;
+        while(received < TICKS && reader.receive(message))
+            received++;
+    });
+
+    // Sending must not block on slow client, that's kicked when its queue
+    // is full.
+    std::string message(16 * 1024, 'x');
+    double maxSendTime = 0;
+    for(int s = 0; s < TICKS; s++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        server.sendToAll(make<MyPacket>(message));
+        maxSendTime = std::max(maxSendTime, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::cerr << "slowest sendToAll(): " << maxSendTime * 1000 << " ms" << std::endl;
+
+    readerThread.join();
+    EXPECT_EQUAL(received, TICKS);
+
+    for(int s = 0; s < 500; s++)
+    {
+        if(server.getClients([](EGE::ClientConnection&) { return true; }).size() == 1)
+            break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQUAL(server.getClients([](EGE::ClientConnection&) { return true; }).size(), 1u);
+
+    server.running = false;
+    serverThread.join();
+    server.close();
+    return 0;
+}
+#endif
+
 RUN_TESTS(network)
@@ -36,6 +36,7 @@
 
 #pragma once
 
+#include <ege/scene/BatchedParticleSystem2D.h>
 #include <ege/scene/Camera.h>
 #include <ege/scene/DummyObject2D.h>
 #include <ege/scene/ObjectRenderer.h>
@@ -44,9 +45,11 @@
 #include <ege/scene/SceneLoader.h>
 #include <ege/scene/SceneObject.h>
 #include <ege/scene/SceneObjectRegistry.h>
+#include <ege/scene/SceneObjectStorage.h>
 #include <ege/scene/SceneObjectType.h>
 #include <ege/scene/SceneWidget.h>
 #include <ege/scene/Plain2DCamera.h>
+#include <ege/scene/SpatialGrid.h>
 #include <ege/scene/TexturedRenderer2D.h>
 #include <ege/scene/TilemapRenderer2D.h>
 
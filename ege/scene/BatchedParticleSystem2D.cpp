@@ -0,0 +1,225 @@
+/*
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*      ,----  ,----  ,----
+*      |      |      |
+*      |----  | --,  |----
+*      |      |   |  |
+*      '----  '---'  '----
+*
+*     Framework Library for Hexagon
+*
+*    Copyright (c) Sppmacd 2020 - 2021
+*
+*    Permission is hereby granted, free of charge, to any person obtaining a copy
+*    of this software and associated documentation files (the "Software"), to deal
+*    in the Software without restriction, including without limitation the rights
+*    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*    copies of the Software, and to permit persons to whom the Software is
+*    furnished to do so, subject to the following conditions:
+*
+*    The above copyright notice and this permission notice shall be included in all
+*    copies or substantial portions of the Software.
+*
+*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*    SOFTWARE.
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*/
+
+#include "BatchedParticleSystem2D.h"
+#include "Scene.h"
+
+#include <algorithm>
+#include <cmath>
+#include <ege/util/system.h>
+
+namespace EGE
+{
+
+void BatchedParticleSystem2D::Particles::resize(Size count)
+{
+    x.resize(count);
+    y.resize(count);
+    motionX.resize(count);
+    motionY.resize(count);
+    ttl.resize(count);
+    color.resize(count);
+    size.resize(count);
+}
+
+void BatchedParticleSystem2D::Particles::reserve(Size count)
+{
+    x.reserve(count);
+    y.reserve(count);
+    motionX.reserve(count);
+    motionY.reserve(count);
+    ttl.reserve(count);
+    color.reserve(count);
+    size.reserve(count);
+}
+
+BatchedParticleSystem2D::BatchedParticleSystem2D(Scene& owner)
+: SceneObject(owner), m_random(System::exactTime().ns), m_vertexes(sf::Quads) {}
+
+void BatchedParticleSystem2D::setSpawnRect(RectD rect)
+{
+    m_spawnRect = rect;
+    getOwner().updateSpatialIndex(*this);
+}
+
+void BatchedParticleSystem2D::setMaxParticles(Size count)
+{
+    m_maxParticles = count;
+    m_particles.reserve(count);
+}
+
+void BatchedParticleSystem2D::render(Renderer& renderer) const
+{
+    SceneObject::render(renderer);
+
+    Size count = m_particles.count();
+    if(count == 0)
+        return;
+
+    m_vertexes.resize(count * 4);
+    for(Size s = 0; s < count; s++)
+    {
+        float x = m_particles.x[s];
+        float y = m_particles.y[s];
+        float halfSize = m_particles.size[s] / 2;
+        sf::Color color = m_particles.color[s];
+        sf::Vertex* quad = &m_vertexes[s * 4];
+        quad[0] = sf::Vertex({x - halfSize, y - halfSize}, color);
+        quad[1] = sf::Vertex({x + halfSize, y - halfSize}, color);
+        quad[2] = sf::Vertex({x + halfSize, y + halfSize}, color);
+        quad[3] = sf::Vertex({x - halfSize, y + halfSize}, color);
+    }
+    renderer.getTarget().draw(m_vertexes, renderer.getStates().sfStates());
+}
+
+void BatchedParticleSystem2D::onUpdate(long long tickCounter)
+{
+    if(!getOwner().isHeadless())
+        getOwner().getLoop()->getProfiler()->startSection("batchedParticleSystem");
+
+    SceneObject::onUpdate(tickCounter);
+
+    if(!getOwner().isHeadless())
+        getOwner().getLoop()->getProfiler()->startSection("update");
+
+    // Plain loops over arrays, so that compiler can vectorize them.
+    Size count = m_particles.count();
+    float* x = m_particles.x.data();
+    float* y = m_particles.y.data();
+    const float* motionX = m_particles.motionX.data();
+    const float* motionY = m_particles.motionY.data();
+    Uint32* ttl = m_particles.ttl.data();
+    for(Size s = 0; s < count; s++)
+    {
+        x[s] += motionX[s];
+        y[s] += motionY[s];
+        // TTL may be already 0 (set by spawn function), don't wrap it.
+        ttl[s] -= (ttl[s] > 0);
+    }
+
+    for(auto& updater: m_particleUpdaters)
+        updater(m_particles, 0, count);
+
+    removeDeadParticles();
+
+    if(!getOwner().isHeadless())
+        getOwner().getLoop()->getProfiler()->endStartSection("spawn");
+
+    if(m_spawnChance >= 1)
+        spawnParticles(std::ceil(m_spawnChance));
+    else if(m_random.nextFloat() < m_spawnChance)
+        spawnParticles(1);
+
+    if(!getOwner().isHeadless())
+        getOwner().getLoop()->getProfiler()->endSection();
+
+    if(!getOwner().isHeadless())
+        getOwner().getLoop()->getProfiler()->endSection();
+}
+
+void BatchedParticleSystem2D::spawnParticles(Size count)
+{
+    Size begin = m_particles.count();
+    count = std::min(count, m_maxParticles - std::min(begin, m_maxParticles));
+    if(count == 0)
+        return;
+
+    Size end = begin + count;
+    m_particles.resize(end);
+    for(Size s = begin; s < end; s++)
+    {
+        m_particles.x[s] = m_spawnRect.position.x + m_random.nextFloat(m_spawnRect.size.x);
+        m_particles.y[s] = m_spawnRect.position.y + m_random.nextFloat(m_spawnRect.size.y);
+        m_particles.motionX[s] = m_random.nextFloatRanged(m_motionMin.x, m_motionMax.x);
+        m_particles.motionY[s] = m_random.nextFloatRanged(m_motionMin.y, m_motionMax.y);
+        m_particles.ttl[s] = m_particleTTL;
+        m_particles.color[s] = m_particleColor;
+        m_particles.size[s] = m_particleSize;
+    }
+
+    if(m_particleOnSpawn)
+        m_particleOnSpawn(m_particles, begin, end);
+}
+
+void BatchedParticleSystem2D::removeDeadParticles()
+{
+    // Compact all arrays at once, keeping particle order (and so drawing order).
+    Size count = m_particles.count();
+    const Uint32* ttl = m_particles.ttl.data();
+    Size first = std::find(ttl, ttl + count, 0) - ttl;
+    if(first == count)
+        return;
+
+    Size out = first;
+    for(Size s = first + 1; s < count; s++)
+    {
+        if(ttl[s] == 0)
+            continue;
+        m_particles.x[out] = m_particles.x[s];
+        m_particles.y[out] = m_particles.y[s];
+        m_particles.motionX[out] = m_particles.motionX[s];
+        m_particles.motionY[out] = m_particles.motionY[s];
+        m_particles.ttl[out] = m_particles.ttl[s];
+        m_particles.color[out] = m_particles.color[s];
+        m_particles.size[out] = m_particles.size[s];
+        out++;
+    }
+    m_particles.resize(out);
+}
+
+BatchedParticleSystem2D::BatchFunction BatchedParticleSystem2D::acceleration(Vec2f value)
+{
+    return [value](Particles& particles, Size begin, Size end) {
+        float* motionX = particles.motionX.data();
+        float* motionY = particles.motionY.data();
+        for(Size s = begin; s < end; s++)
+        {
+            motionX[s] += value.x;
+            motionY[s] += value.y;
+        }
+    };
+}
+
+BatchedParticleSystem2D::BatchFunction BatchedParticleSystem2D::fadeOut(Uint32 lifeTime)
+{
+    ASSERT(lifeTime > 0);
+    return [lifeTime](Particles& particles, Size begin, Size end) {
+        for(Size s = begin; s < end; s++)
+            particles.color[s].a = std::min<Uint32>(particles.ttl[s], lifeTime) * 255 / lifeTime;
+    };
+}
+
+}
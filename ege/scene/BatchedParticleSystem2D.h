@@ -0,0 +1,143 @@
+/*
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*      ,----  ,----  ,----
+*      |      |      |
+*      |----  | --,  |----
+*      |      |   |  |
+*      '----  '---'  '----
+*
+*     Framework Library for Hexagon
+*
+*    Copyright (c) Sppmacd 2020 - 2021
+*
+*    Permission is hereby granted, free of charge, to any person obtaining a copy
+*    of this software and associated documentation files (the "Software"), to deal
+*    in the Software without restriction, including without limitation the rights
+*    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*    copies of the Software, and to permit persons to whom the Software is
+*    furnished to do so, subject to the following conditions:
+*
+*    The above copyright notice and this permission notice shall be included in all
+*    copies or substantial portions of the Software.
+*
+*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*    SOFTWARE.
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*/
+
+#pragma once
+
+#include "SceneObject.h"
+
+#include <ege/util/Random.h>
+#include <limits>
+#include <SFML/Graphics.hpp>
+#include <typeinfo>
+
+namespace EGE
+{
+
+/*
+    Batched Particle System
+
+    Like ParticleSystem2D, but particles are stored as structure of arrays
+    (one contiguous array per attribute) and updaters are called once per
+    tick for all particles, so that their loops can be vectorized. Particles
+    are rendered as one batch of colored squares.
+*/
+class BatchedParticleSystem2D : public SceneObject
+{
+public:
+    EGE_SCENEOBJECT("EGE::BatchedParticleSystem2D");
+
+    // Particle N is described by N-th element of every array.
+    struct Particles
+    {
+        Vector<float> x;
+        Vector<float> y;
+        Vector<float> motionX;
+        Vector<float> motionY;
+        Vector<Uint32> ttl;
+        Vector<sf::Color> color;
+        Vector<float> size;
+
+        Size count() const { return x.size(); }
+        void resize(Size count);
+        void reserve(Size count);
+    };
+
+    // Called with range of particles [begin, end).
+    typedef std::function<void(Particles&, Size begin, Size end)> BatchFunction;
+
+    BatchedParticleSystem2D(Scene& owner);
+
+    virtual RectD getBoundingBox() const override { return m_spawnRect; }
+
+    // Particles can fly away from spawn rect.
+    virtual bool allowCulling() const override { return false; }
+    virtual bool allowCompactUpdates() const override { return typeid(*this) == typeid(BatchedParticleSystem2D); }
+
+    RectD getSpawnRect() const { return m_spawnRect; }
+    void setSpawnRect(RectD rect);
+
+    // The same as ParticleSystem2D::setSpawnChance().
+    void setSpawnChance(double val) { ASSERT(val > 0); m_spawnChance = val; }
+    void setParticleLifeTime(Uint32 ttl) { ASSERT(ttl > 0); m_particleTTL = ttl; }
+
+    // Initial motion is random, between min and max.
+    void setParticleMotion(Vec2f min, Vec2f max) { m_motionMin = min; m_motionMax = max; }
+    void setParticleColor(sf::Color color) { m_particleColor = color; }
+    void setParticleSize(float size) { m_particleSize = size; }
+
+    // Particles over this limit are not spawned. Memory for them is allocated now.
+    void setMaxParticles(Size count);
+
+    void setRandomSeed(MaxUint seed) { m_random = Random(seed); }
+
+    // Called every tick for all particles, after they are moved by their motion.
+    void addParticleUpdater(BatchFunction func) { m_particleUpdaters.push_back(func); }
+
+    // Called for newly spawned particles, after attributes are set to defaults.
+    void setParticleOnSpawn(BatchFunction func) { m_particleOnSpawn = func; }
+
+    void spawnParticles(Size count);
+
+    Size getParticleCount() const { return m_particles.count(); }
+    const Particles& getParticles() const { return m_particles; }
+
+    virtual void render(Renderer& renderer) const override;
+    virtual void onUpdate(long long tickCounter) override;
+
+    // Common updaters.
+    static BatchFunction acceleration(Vec2f value);
+    static BatchFunction fadeOut(Uint32 lifeTime);
+
+private:
+    void removeDeadParticles();
+
+    Particles m_particles;
+    RectD m_spawnRect;
+    double m_spawnChance = 1.0;
+    Uint32 m_particleTTL = 60; // 1s
+    Vec2f m_motionMin;
+    Vec2f m_motionMax;
+    sf::Color m_particleColor = sf::Color::White;
+    float m_particleSize = 1.f;
+    Size m_maxParticles = std::numeric_limits<Size>::max();
+    Vector<BatchFunction> m_particleUpdaters;
+    BatchFunction m_particleOnSpawn;
+    Random m_random;
+
+    mutable sf::VertexArray m_vertexes;
+};
+
+}
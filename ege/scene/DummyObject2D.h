@@ -41,6 +41,7 @@
 
 #include <ege/gfx/RenderStates.h>
 #include <SFML/Graphics.hpp>
+#include <typeinfo>
 
 namespace EGE
 {
@@ -57,6 +58,7 @@ public:
     void setSize(Vec2d size)
     {
         m_size = size;
+        getOwner().updateSpatialIndex(*this);
     }
     Vec2d getSize() const
     {
@@ -66,6 +68,8 @@ public:
     {
         return RectD({getPosition().toVec2d()}, m_size);
     }
+    // Subclasses may extend serializeMain(), so they must opt in themselves.
+    virtual bool allowCompactUpdates() const override { return typeid(*this) == typeid(DummyObject2D); }
 
     virtual void render(Renderer&) const override {}
 
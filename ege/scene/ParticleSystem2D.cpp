@@ -37,11 +37,17 @@
 #include "ParticleSystem2D.h"
 #include "Scene.h"
 
-#include <cstdlib>
+#include <ege/util/Random.h>
 
 namespace EGE
 {
 
+void ParticleSystem2D::setSpawnRect(RectD rect)
+{
+    m_spawnRect = rect;
+    getOwner().updateSpatialIndex(*this);
+}
+
 void ParticleSystem2D::render(Renderer& renderer) const
 {
     SceneObject::render(renderer);
@@ -88,7 +94,7 @@ void ParticleSystem2D::onUpdate(long long tickCounter)
     }
     else
     {
-        double val = rand() % 1024 / 1024.0;
+        double val = Random::fastRandom().nextDouble();
         if(val < m_spawnChance)
             spawnParticle();
     }
@@ -101,8 +107,8 @@ void ParticleSystem2D::onUpdate(long long tickCounter)
 
 Vec2d ParticleSystem2D::randomPosition()
 {
-    int rand1 = rand() % 1024;
-    int rand2 = rand() % 1024;
+    int rand1 = Random::fastRandom().nextInt(1024);
+    int rand2 = Random::fastRandom().nextInt(1024);
 
     float randSize1 = rand1 / 1024.f * m_spawnRect.size.x;
     float randSize2 = rand2 / 1024.f * m_spawnRect.size.y;
@@ -40,6 +40,7 @@
 
 #include <ege/gfx/RenderStates.h>
 #include <list>
+#include <typeinfo>
 
 namespace EGE
 {
@@ -81,8 +82,12 @@ public:
 
     virtual RectD getBoundingBox() const override { return m_spawnRect; }
 
+    // Particles can fly away from spawn rect.
+    virtual bool allowCulling() const override { return false; }
+    virtual bool allowCompactUpdates() const override { return typeid(*this) == typeid(ParticleSystem2D); }
+
     RectD getSpawnRect() const { return m_spawnRect; }
-    void setSpawnRect(RectD rect) { m_spawnRect = rect; }
+    void setSpawnRect(RectD rect);
 
     virtual void render(Renderer& renderer) const override;
     virtual void onUpdate(long long tickCounter) override;
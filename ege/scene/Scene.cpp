@@ -39,9 +39,11 @@
 #include "SceneLoader.h"
 
 #include <algorithm>
+#include <cmath>
 #include <ege/debug/Dump.h>
 #include <ege/debug/Logger.h>
 
+#include "BatchedParticleSystem2D.h"
 #include "Plain2DCamera.h"
 #include "DummyObject2D.h"
 #include "ParticleSystem2D.h"
@@ -57,6 +59,7 @@ Scene::Scene(GUIGameLoop* loop)
 
     m_registry.addType<DummyObject2D>();
     m_registry.addType<ParticleSystem2D>();
+    m_registry.addType<BatchedParticleSystem2D>();
 }
 
 Scene::~Scene()
@@ -81,6 +84,13 @@ bool Scene::saveToFile(String saveFile, const IOStreamConverter& converter)
     return loader.saveScene(saveFile, converter);
 }
 
+void Scene::doRender(Renderer& renderer, const RenderStates& states)
+{
+    updateLayers();
+    applySpatialUpdates();
+    Renderable::doRender(renderer, states);
+}
+
 void Scene::render(Renderer& renderer) const
 {
     // The loop should NOT be specified for server-side
@@ -89,8 +99,23 @@ void Scene::render(Renderer& renderer) const
 
     if(!m_cameraObject.expired())
         m_cameraObject.lock()->applyTransform(renderer);
-    for(auto pr: m_objectsByLayer)
-        pr.second->doRender(renderer);
+
+    // Mark objects that are in view. The view may be rotated, so take
+    // a square that contains it.
+    const sf::View& view = renderer.getTarget().getView();
+    double halfSize = view.getRotation() == 0 ? 0 : std::hypot(view.getSize().x, view.getSize().y) / 2;
+    Vec2d halfExtent = halfSize == 0 ? Vec2d(view.getSize().x / 2, view.getSize().y / 2) : Vec2d(halfSize, halfSize);
+    Vec2d center(view.getCenter().x, view.getCenter().y);
+    Size frame = ++m_renderFrame;
+    m_spatialIndex.query(RectD(center - halfExtent, halfExtent * 2.0), [frame](SceneObject& object) {
+        object.m_visibleFrame = frame;
+    });
+
+    for(auto& pr: m_objectsByLayer)
+    {
+        if(pr.second->m_visibleFrame == frame || !pr.second->allowCulling())
+            pr.second->doRender(renderer);
+    }
 }
 
 void Scene::onUpdate(TickCount tickCounter)
@@ -98,56 +123,123 @@ void Scene::onUpdate(TickCount tickCounter)
     if(!isHeadless()) m_loop->getProfiler()->startSection("eventLoop");
     EventLoop::onUpdate();
 
-    auto doUpdateForObjectMap = [this, tickCounter](Scene::ObjectMapType& objects, bool allowDead) {
-        for(auto it = objects.begin(); it != objects.end();)
+    if(!isHeadless()) m_loop->getProfiler()->endStartSection("objectUpdate");
+    updateObjects(m_objects, tickCounter, true);
+
+    if(!isHeadless()) m_loop->getProfiler()->endStartSection("staticObjectUpdate");
+    updateObjects(m_staticObjects, tickCounter, false);
+
+    if(!isHeadless()) m_loop->getProfiler()->endStartSection("spatialIndex");
+    applySpatialUpdates();
+
+    if(!isHeadless()) m_loop->getProfiler()->endSection();
+}
+
+void Scene::updateObjects(ObjectMapType& objects, TickCount tickCounter, bool allowDead)
+{
+    if(m_updatePool)
+        updateObjectsInParallel(objects, tickCounter);
+
+    // Objects added during update are appended, so they are updated too. The
+    // storage keeps them alive, so no SharedPtr copies are needed here.
+    for(Size s = 0; s < objects.size();)
+    {
+        SceneObject& object = objects[s];
+        if(object.m_updatedInParallel)
+            object.m_updatedInParallel = false;
+        else
+            object.onUpdate(tickCounter);
+
+        if(!allowDead || !object.isDead())
         {
-            if(!isHeadless()) m_loop->getProfiler()->startSection("update");
-            auto object = *it;
-            auto oldIt = it;
-            auto nextIt = ++it;
-            object.second->onUpdate(tickCounter);
+            s++;
+            continue;
+        }
 
-            if(allowDead)
+        ege_log.debug() << "SceneObject is dead: " << object.getObjectId() << " @" << &object;
+        fire<RemoveObjectEvent>(object);
+
+        // Set all children dead
+        if(object.m_children.size() > 0)
+        {
+            ege_log.debug() << "SceneObject is dead: Removing " << object.m_children.size() << " children of " << &object;
+            for(auto& so: object.m_children)
             {
-                if(!isHeadless()) m_loop->getProfiler()->endStartSection("deadCheck");
-                if(object.second->isDead())
-                {
-                    ege_log.debug() << "SceneObject is dead: " << object.second->getObjectId() << " @" << object.second;
-                    fire<RemoveObjectEvent>(*object.second);
-
-                    // Set all children dead
-                    if(object.second->m_children.size() > 0)
-                    {
-                        ege_log.debug() << "SceneObject is dead: Removing " << object.second->m_children.size() << " children of " << object.second;
-                        for(auto& so: object.second->m_children)
-                        {
-                            so->setDead();
-                        }
-                    }
-
-                    // Remove object from its parent's children list
-                    if(object.second->m_parent)
-                        object.second->m_parent->m_children.erase(object.second.get());
-
-                    m_objectsByName.erase(object.second->getName());
-                    objects.erase(oldIt);
-
-                    if(objects.empty())
-                        return;
-                }
+                so->setDead();
             }
-            it = nextIt;
-            if(!isHeadless()) m_loop->getProfiler()->endSection();
         }
-    };
 
-    if(!isHeadless()) m_loop->getProfiler()->endStartSection("objectUpdate");
-    doUpdateForObjectMap(m_objects, true);
+        // Remove object from its parent's children list
+        if(object.m_parent)
+            object.m_parent->m_children.erase(&object);
 
-    if(!isHeadless()) m_loop->getProfiler()->endStartSection("staticObjectUpdate");
-    doUpdateForObjectMap(m_staticObjects, false);
+        removeFromLayers(object);
+        removeFromChangedObjects(object);
+        removeFromSpatialIndex(object);
+        m_objectsByName.erase(object.getName());
 
-    if(!isHeadless()) m_loop->getProfiler()->endSection();
+        // Last object is moved here, don't skip it.
+        objects.erase(objects.begin() + s);
+    }
+}
+
+void Scene::updateObjectsInParallel(ObjectMapType& objects, TickCount tickCounter)
+{
+    // Objects may read each other's transforms, so they must not be computed
+    // lazily by the workers.
+    for(auto& pr: m_objects)
+        pr.second->updateWorldTransform();
+    for(auto& pr: m_staticObjects)
+        pr.second->updateWorldTransform();
+
+    Vector<SceneObject*> parallelObjects;
+    for(auto& pr: objects)
+    {
+        // Objects in hierarchy share cached transforms, so update them serially.
+        auto& object = *pr.second;
+        if(object.allowParallelUpdate() && !object.m_parent && object.m_children.empty())
+            parallelObjects.push_back(&object);
+    }
+
+    m_parallelUpdateRunning = true;
+    m_updatePool->parallelFor(parallelObjects.size(), 256, [&parallelObjects, tickCounter](Size begin, Size end) {
+        for(Size s = begin; s < end; s++)
+        {
+            parallelObjects[s]->onUpdate(tickCounter);
+            parallelObjects[s]->m_updatedInParallel = true;
+        }
+    });
+    m_parallelUpdateRunning = false;
+
+    // Parallel objects could move.
+    for(auto object: parallelObjects)
+        updateSpatialIndex(*object);
+
+    // Commit structural changes. Dead objects are removed by updateObjects().
+    Vector<std::function<void()>> commitQueue;
+    std::swap(commitQueue, m_commitQueue);
+    for(auto& function: commitQueue)
+        function();
+}
+
+void Scene::setParallelUpdate(bool enabled, Size threadCount)
+{
+    ASSERT(!m_parallelUpdateRunning);
+    if(enabled)
+        m_updatePool = std::make_unique<ThreadPool>(threadCount);
+    else
+        m_updatePool.reset();
+}
+
+void Scene::deferUntilCommit(std::function<void()> function)
+{
+    if(!m_parallelUpdateRunning)
+    {
+        function();
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_commitMutex);
+    m_commitQueue.push_back(std::move(function));
 }
 
 UidType Scene::addObject(SharedPtr<SceneObject> object)
@@ -155,23 +247,43 @@ UidType Scene::addObject(SharedPtr<SceneObject> object)
     if(!object)
         return 0;
 
-    if(!object->getObjectId())
     {
-        // On server, give entities negative IDs to separate client and server objects.
-        if(!getLoop())
-            --m_greatestId;
+        // Objects may be added from parallel update, so we assign ID now
+        // and do the rest after it.
+        std::unique_lock<std::mutex> lock(m_commitMutex, std::defer_lock);
+        if(m_parallelUpdateRunning)
+            lock.lock();
+
+        if(!object->getObjectId())
+        {
+            // On server, give entities negative IDs to separate client and server objects.
+            if(!getLoop())
+                --m_greatestId;
+            else
+                ++m_greatestId;
+            object->setObjectId(m_greatestId);
+        }
         else
-            ++m_greatestId;
-        object->setObjectId(m_greatestId);
-    }
-    else
-    {
-        if(m_greatestId < object->getObjectId())
-            m_greatestId = object->getObjectId();
+        {
+            // Server IDs grow downwards.
+            if(getLoop() ? m_greatestId < object->getObjectId() : m_greatestId > object->getObjectId())
+                m_greatestId = object->getObjectId();
+        }
+
+        if(m_parallelUpdateRunning)
+        {
+            m_commitQueue.push_back([this, object]() { addObject(object); });
+            return object->getObjectId();
+        }
     }
 
     object->init();
 
+    // InspectorNode is not thread safe, so objects created by parallel update
+    // are attached here.
+    if(!object->isnParent())
+        object->isnSetParent(this);
+
     auto objIdDupe = m_objects.find(object->getObjectId());
     if(objIdDupe != m_objects.end())
     {
@@ -186,14 +298,16 @@ UidType Scene::addObject(SharedPtr<SceneObject> object)
         CRASH_WITH_MESSAGE("Duplicate SceneObject name");
     }
 
-    m_objects.insert(std::make_pair(object->getObjectId(), object));
+    m_objects.insert(object);
     if(object->getName().empty())
         object->setName("SO" + std::to_string(object->getObjectId()));
     m_objectsByName.insert(std::make_pair(object->getName(), object.get()));
 
     fire<AddObjectEvent>(*object);
-    // TODO: Do not rebuild layers if adding multiple objects in one tick
-    rebuildLayers();
+    scheduleLayerUpdate(*object);
+    if(object->getMainChangedFlag() || object->getExtendedChangedFlag())
+        scheduleChangedObject(*object);
+    m_spatialIndex.update(*object);
     return object->getObjectId();
 }
 
@@ -203,6 +317,7 @@ UidType Scene::addStaticObject(SharedPtr<SceneObject> object, bool overwrite)
         return 0;
 
     ASSERT_WITH_MESSAGE(!object->getName().empty(), "Static SceneObjects must have assigned name in scene data file");
+    ASSERT_WITH_MESSAGE(!m_parallelUpdateRunning, "Static SceneObjects cannot be added from parallel update");
 
     if(!object->getObjectId())
     {
@@ -215,7 +330,8 @@ UidType Scene::addStaticObject(SharedPtr<SceneObject> object, bool overwrite)
     }
     else
     {
-        if(m_greatestStaticId < object->getObjectId())
+        // Server IDs grow downwards.
+        if(getLoop() ? m_greatestStaticId < object->getObjectId() : m_greatestStaticId > object->getObjectId())
             m_greatestStaticId = object->getObjectId();
     }
 
@@ -237,8 +353,12 @@ UidType Scene::addStaticObject(SharedPtr<SceneObject> object, bool overwrite)
             auto& oldObject = m_objectsByName[it->second->getName()];
 
             // Remove old object and add new (with new ID etc.)
+            removeFromLayers(*oldObject);
+            removeFromSpatialIndex(*oldObject);
             m_staticObjects.erase(oldObject->getObjectId());
-            m_staticObjects.insert(std::make_pair(object->getObjectId(), object));
+            m_staticObjects.insert(object);
+            scheduleLayerUpdate(*object);
+            m_spatialIndex.update(*object);
 
             // Set another 'object by name'.
             oldObject = object.get();
@@ -246,17 +366,17 @@ UidType Scene::addStaticObject(SharedPtr<SceneObject> object, bool overwrite)
         return object->getObjectId();
     }
 
-    m_staticObjects.insert(std::make_pair(object->getObjectId(), object));
+    m_staticObjects.insert(object);
     m_objectsByName.insert(std::make_pair(object->getName(), object.get()));
-    // TODO: Do not rebuild layers if adding multiple objects in one tick
-    rebuildLayers();
+    scheduleLayerUpdate(*object);
+    m_spatialIndex.update(*object);
     return object->getObjectId();
 }
 
 std::vector<SceneObject*> Scene::getObjects(std::function<bool(SceneObject*)> predicate)
 {
     std::vector<SceneObject*> objects;
-    for(ObjectMapType::value_type it: m_objects)
+    for(auto& it: m_objects)
     {
         if(predicate(it.second.get()))
         {
@@ -295,6 +415,96 @@ SceneObject* Scene::getObjectByName(String id)
     return nullptr;
 }
 
+Vector<SceneObject*> Scene::getObjectsInRect(RectD rect)
+{
+    applySpatialUpdates();
+    Vector<SceneObject*> objects;
+    m_spatialIndex.query(rect, [&objects](SceneObject& object) { objects.push_back(&object); });
+    return objects;
+}
+
+Vector<SceneObject*> Scene::getObjectsInRadius(Vec2d center, double radius)
+{
+    applySpatialUpdates();
+    Vector<SceneObject*> objects;
+    m_spatialIndex.query(RectD(center - Vec2d(radius, radius), Vec2d(radius, radius) * 2.0), [&](SceneObject& object) {
+        // Distance from center to the nearest point of bounding box.
+        RectD box = object.getBoundingBox();
+        double dx = std::max({box.position.x - center.x, 0.0, center.x - box.position.x - box.size.x});
+        double dy = std::max({box.position.y - center.y, 0.0, center.y - box.position.y - box.size.y});
+        if(dx * dx + dy * dy <= radius * radius)
+            objects.push_back(&object);
+    });
+    return objects;
+}
+
+void Scene::updateSpatialIndex(SceneObject& object)
+{
+    // Objects that are not added yet are indexed by addObject(). Objects
+    // moved by parallel update are scheduled after it.
+    if(!object.m_spatialIndexed || object.m_spatialUpdatePending || m_parallelUpdateRunning)
+        return;
+    object.m_spatialUpdatePending = true;
+    object.m_spatialUpdateIndex = m_pendingSpatialUpdates.size();
+    m_pendingSpatialUpdates.push_back(&object);
+}
+
+void Scene::applySpatialUpdates()
+{
+    if(m_pendingSpatialUpdates.empty())
+        return;
+    m_spatialUpdateRound++;
+    for(auto object: m_pendingSpatialUpdates)
+    {
+        // Removed while pending.
+        if(!object)
+            continue;
+        object->m_spatialUpdatePending = false;
+        updateSpatialCells(*object);
+    }
+    m_pendingSpatialUpdates.clear();
+}
+
+void Scene::updateSpatialCells(SceneObject& object)
+{
+    // Objects whose parent is pending too are updated once.
+    if(!object.m_spatialIndexed || object.m_spatialUpdateRound == m_spatialUpdateRound)
+        return;
+    object.m_spatialUpdateRound = m_spatialUpdateRound;
+    m_spatialIndex.update(object);
+
+    // Children are positioned relative to parent.
+    for(auto child: object.m_children)
+        updateSpatialCells(*child);
+}
+
+void Scene::removeFromSpatialIndex(SceneObject& object)
+{
+    // Hole, like in removeFromLayers().
+    if(object.m_spatialUpdatePending)
+    {
+        ASSERT(m_pendingSpatialUpdates[object.m_spatialUpdateIndex] == &object);
+        m_pendingSpatialUpdates[object.m_spatialUpdateIndex] = nullptr;
+        object.m_spatialUpdatePending = false;
+    }
+    m_spatialIndex.remove(object);
+}
+
+void Scene::setSpatialCellSize(double size)
+{
+    applySpatialUpdates();
+    for(auto& pr: m_staticObjects)
+        m_spatialIndex.remove(*pr.second);
+    for(auto& pr: m_objects)
+        m_spatialIndex.remove(*pr.second);
+
+    m_spatialIndex = SpatialGrid(size);
+    for(auto& pr: m_staticObjects)
+        m_spatialIndex.update(*pr.second);
+    for(auto& pr: m_objects)
+        m_spatialIndex.update(*pr.second);
+}
+
 SharedPtr<SceneObject> Scene::addNewObject(String typeId, SharedPtr<ObjectMap> data)
 {
     SharedPtr<SceneObject> sceneObject = createObject(typeId, data);
@@ -343,13 +553,127 @@ SharedPtr<SceneObject> Scene::createObject(String typeId, SharedPtr<ObjectMap> d
 
 void Scene::rebuildLayers()
 {
+    for(auto object: m_pendingLayerUpdates)
+    {
+        if(object)
+            object->m_layerUpdatePending = false;
+    }
+    m_pendingLayerUpdates.clear();
     m_objectsByLayer.clear();
 
-    for(auto pr: m_staticObjects)
-        m_objectsByLayer.insert(std::make_pair(pr.second->getRenderLayer(), pr.second.get()));
+    for(auto& pr: m_staticObjects)
+        addToLayers(*pr.second);
 
-    for(auto pr: m_objects)
-        m_objectsByLayer.insert(std::make_pair(pr.second->getRenderLayer(), pr.second.get()));
+    for(auto& pr: m_objects)
+        addToLayers(*pr.second);
+}
+
+void Scene::updateLayers()
+{
+    for(auto object: m_pendingLayerUpdates)
+    {
+        // Removed while pending.
+        if(!object)
+            continue;
+        object->m_layerUpdatePending = false;
+        if(object->m_layerIndexed)
+        {
+            // Layer was changed and then restored in the same batch.
+            if(object->m_layerIterator->first == object->getRenderLayer())
+                continue;
+            m_objectsByLayer.erase(object->m_layerIterator);
+        }
+        addToLayers(*object);
+    }
+    m_pendingLayerUpdates.clear();
+}
+
+void Scene::scheduleLayerUpdate(SceneObject& object)
+{
+    if(m_parallelUpdateRunning)
+    {
+        deferUntilCommit([this, &object]() { scheduleLayerUpdate(object); });
+        return;
+    }
+
+    // Objects that are not added yet will be scheduled by addObject().
+    if(object.m_layerUpdatePending || !containsObject(object))
+        return;
+    object.m_layerUpdatePending = true;
+    object.m_layerUpdateIndex = m_pendingLayerUpdates.size();
+    m_pendingLayerUpdates.push_back(&object);
+}
+
+void Scene::removeFromLayers(SceneObject& object)
+{
+    // Leave a hole instead of erasing, so that killing many pending objects
+    // in one tick stays linear and order of the rest is kept.
+    if(object.m_layerUpdatePending)
+    {
+        ASSERT(m_pendingLayerUpdates[object.m_layerUpdateIndex] == &object);
+        m_pendingLayerUpdates[object.m_layerUpdateIndex] = nullptr;
+        object.m_layerUpdatePending = false;
+    }
+    if(object.m_layerIndexed)
+    {
+        m_objectsByLayer.erase(object.m_layerIterator);
+        object.m_layerIndexed = false;
+    }
+}
+
+void Scene::addToLayers(SceneObject& object)
+{
+    object.m_layerIterator = m_objectsByLayer.insert(std::make_pair(object.getRenderLayer(), &object));
+    object.m_layerIndexed = true;
+}
+
+Vector<SceneObject*> Scene::takeChangedObjects()
+{
+    Vector<SceneObject*> objects;
+    std::swap(objects, m_changedObjects);
+    objects.erase(std::remove(objects.begin(), objects.end(), nullptr), objects.end());
+    for(auto object: objects)
+        object->m_changeListed = false;
+    return objects;
+}
+
+void Scene::scheduleChangedObject(SceneObject& object)
+{
+    if(m_parallelUpdateRunning)
+    {
+        deferUntilCommit([this, &object]() { scheduleChangedObject(object); });
+        return;
+    }
+
+    // Objects that are not added yet will be scheduled by addObject().
+    if(object.m_changeListed)
+        return;
+    auto it = m_objects.find(object.getObjectId());
+    if(it == m_objects.end() || it->second.get() != &object)
+        return;
+    object.m_changeListed = true;
+    object.m_changeListIndex = m_changedObjects.size();
+    m_changedObjects.push_back(&object);
+}
+
+void Scene::removeFromChangedObjects(SceneObject& object)
+{
+    if(!object.m_changeListed)
+        return;
+    // Holes are removed by takeChangedObjects().
+    ASSERT(m_changedObjects[object.m_changeListIndex] == &object);
+    m_changedObjects[object.m_changeListIndex] = nullptr;
+    object.m_changeListed = false;
+}
+
+bool Scene::containsObject(const SceneObject& object) const
+{
+    // Static and dynamic objects have separate IDs, so check both.
+    auto it = m_objects.find(object.getObjectId());
+    if(it != m_objects.end() && it->second.get() == &object)
+        return true;
+    it = m_staticObjects.find(object.getObjectId());
+    return it != m_staticObjects.end() && it->second.get() == &object;
 }
 
 Vec2d Scene::mapToScreenCoords(Renderer& renderer, Vec3d scene) const
@@ -37,17 +37,21 @@
 #pragma once
 
 #include <SFML/Graphics.hpp>
+#include <ege/asyncLoop/ThreadPool.h>
 #include <ege/asyncLoop/ThreadSafeEventLoop.h>
 #include <ege/gfx/RenderStates.h>
 #include <ege/gui/GUIGameLoop.h>
 #include <ege/scene/SceneLoader.h>
 #include <ege/scene/SceneObject.h>
+#include <ege/scene/SceneObjectStorage.h>
+#include <ege/scene/SpatialGrid.h>
 #include <ege/scene/Camera.h>
 #include <ege/util/Converter.h>
 #include <ege/util/JSONConverter.h>
 #include <functional>
 #include <map>
 #include <memory>
+#include <mutex>
 
 #define SCENE_DEBUG 0
 
@@ -88,7 +92,8 @@ public:
     Scene(GUIGameLoop* loop);
     virtual ~Scene();
 
-    typedef IdMap<SharedPtr<SceneObject>> ObjectMapType;
+    typedef SceneObjectStorage ObjectMapType;
+    typedef SceneObjectStorage::Handle ObjectHandle;
     typedef StringMap<SceneObject*> ObjectMapByName;
     typedef std::multimap<int, SceneObject*> ObjectMapByLayer;
 
@@ -141,8 +146,29 @@ public:
     SharedPtr<SceneObject> getObject(UidType id);
     SharedPtr<SceneObject> getStaticObject(UidType id);
 
+    // Handles are cheaper to resolve than IDs. They don't keep object alive.
+    ObjectHandle getObjectHandle(UidType id) const { return m_objects.getHandle(id); }
+    SceneObject* getObject(ObjectHandle handle) const { return m_objects.get(handle); }
+
     SceneObject* getObjectByName(String name);
 
+    // Spatial queries, based on SceneObject::getBoundingBox(). Objects with
+    // empty bounding box are treated as points. Pending index updates are
+    // applied first.
+    Vector<SceneObject*> getObjectsInRect(RectD rect);
+    Vector<SceneObject*> getObjectsInRadius(Vec2d center, double radius);
+
+    // Schedules update of object (and its children) in spatial index. It's
+    // applied at the end of tick, or before query or rendering, so that
+    // objects that move many times per tick are reindexed (and their world
+    // transform computed) once. Called automatically when object transform
+    // changes. Objects that have other things affecting their bounding box
+    // must call it themselves.
+    void updateSpatialIndex(SceneObject& object);
+
+    // Should be about size of typical object.
+    void setSpatialCellSize(double size);
+
     ObjectMapType::const_iterator begin() const { return m_objects.begin(); }
     ObjectMapType::const_iterator end() const { return m_objects.end(); }
 
@@ -164,12 +190,38 @@ public:
     Vec2d mapToScreenCoords(Renderer& renderer, Vec3d scene) const;
     Vec3d mapToSceneCoords(Renderer& renderer, Vec2d screen) const;
 
+    // Objects that allowParallelUpdate() are updated on %threadCount threads
+    // (0 = one per core) before other objects. Changes to scene structure made
+    // by them are applied after all of them are updated.
+    void setParallelUpdate(bool enabled, Size threadCount = 0);
+    bool isParallelUpdateRunning() const { return m_parallelUpdateRunning; }
+
+    // Runs %function after parallel update phase, or now if it's not running.
+    void deferUntilCommit(std::function<void()> function);
+
+    // Dynamic objects that have main or extended changed flag set, each
+    // listed once since last call. Flags are not cleared.
+    Vector<SceneObject*> takeChangedObjects();
+
+    // Applies pending render layer changes before rendering.
+    virtual void doRender(Renderer& renderer, const RenderStates& states = {}) override;
+
 protected:
     friend class SceneLoader;
+    friend class SceneObject;
 
     virtual void render(Renderer& renderer) const override;
+
+    // Rebuilds whole render order from scratch.
     virtual void rebuildLayers();
 
+    // Updates objects and removes dead ones (if allowed).
+    void updateObjects(ObjectMapType& objects, TickCount tickCounter, bool allowDead);
+
+    // Re-sorts objects that were added or changed layer since last call.
+    // Every object is moved in O(log n), the rest of index is untouched.
+    void updateLayers();
+
     ObjectMapType m_objects;
     ObjectMapType m_staticObjects;
     ObjectMapByName m_objectsByName;
@@ -179,6 +231,32 @@ protected:
     WeakPtr<Camera> m_cameraObject;
 
 private:
+    void scheduleLayerUpdate(SceneObject& object);
+    void removeFromLayers(SceneObject& object);
+    void addToLayers(SceneObject& object);
+    bool containsObject(const SceneObject& object) const;
+
+    void scheduleChangedObject(SceneObject& object);
+    void removeFromChangedObjects(SceneObject& object);
+
+    void updateObjectsInParallel(ObjectMapType& objects, TickCount tickCounter);
+
+    void applySpatialUpdates();
+    void updateSpatialCells(SceneObject& object);
+    void removeFromSpatialIndex(SceneObject& object);
+
+    Vector<SceneObject*> m_pendingLayerUpdates;
+    Vector<SceneObject*> m_pendingSpatialUpdates;
+    Size m_spatialUpdateRound = 0;
+    Vector<SceneObject*> m_changedObjects;
+
+    SpatialGrid m_spatialIndex;
+    mutable Size m_renderFrame = 0;
+
+    UniquePtr<ThreadPool> m_updatePool;
+    bool m_parallelUpdateRunning = false;
+    std::mutex m_commitMutex;
+    Vector<std::function<void()>> m_commitQueue;
     UidType m_greatestId = 0;
     UidType m_greatestStaticId = 0;
     Vec2d m_size;
@@ -46,6 +46,9 @@
 namespace EGE
 {
 
+SceneObject::SceneObject(Scene& owner)
+: Animatable(owner.isParallelUpdateRunning() ? nullptr : &owner, "SceneObject"), m_owner(owner) {}
+
 SceneObject::~SceneObject()
 {
     ege_log.debug() << "SceneObject::~SceneObject() " << this;
@@ -54,54 +57,111 @@ SceneObject::~SceneObject()
 
 Vec3d SceneObject::getPosition() const
 {
-    if(m_parent)
-    {
-        return VectorOperations::rotateYawPitchRoll(m_position + m_parent->getPosition(),
-                                                    -m_parent->getYaw(),
-                                                    -m_parent->getPitch(),
-                                                    -m_parent->getRoll(), 
-                                                    m_parent->getPosition());
-    }
-    return m_position;
+    updateWorldTransform();
+    return m_worldPosition;
 }
 
 Vec3d SceneObject::getMotion() const
 {
-    if(m_parent)
-        return m_parent->getMotion() + m_motion;
-    return m_motion;
+    updateWorldTransform();
+    return m_worldMotion;
 }
 
 double SceneObject::getYaw() const
 {
-    if(m_parent)
-    {
-        if(m_yawMode == RotationMode::Inherit)
-            return m_yaw + m_parent->getYaw();
-    }
-    return m_yaw;
+    updateWorldTransform();
+    return m_worldYaw;
 }
 
 double SceneObject::getPitch() const
 {
-    if(m_parent)
-    {
-        if(m_pitchMode == RotationMode::Inherit)
-            return m_pitch + m_parent->getPitch();
-    }
-    return m_pitch;
+    updateWorldTransform();
+    return m_worldPitch;
 }
 
 double SceneObject::getRoll() const
 {
+    updateWorldTransform();
+    return m_worldRoll;
+}
+
+void SceneObject::updateWorldTransform() const
+{
+    if(!m_worldTransformDirty)
+        return;
+
     if(m_parent)
     {
-        if(m_rollMode == RotationMode::Inherit)
-            return m_roll + m_parent->getRoll();
+        // Updates parent's cached transform.
+        Vec3d parentPosition = m_parent->getPosition();
+        m_worldPosition = VectorOperations::rotateYawPitchRoll(m_position + parentPosition,
+                                                               -m_parent->m_worldYaw,
+                                                               -m_parent->m_worldPitch,
+                                                               -m_parent->m_worldRoll,
+                                                               parentPosition);
+        m_worldMotion = m_parent->m_worldMotion + m_motion;
+        m_worldYaw = m_yawMode == RotationMode::Inherit ? m_yaw + m_parent->m_worldYaw : m_yaw;
+        m_worldPitch = m_pitchMode == RotationMode::Inherit ? m_pitch + m_parent->m_worldPitch : m_pitch;
+        m_worldRoll = m_rollMode == RotationMode::Inherit ? m_roll + m_parent->m_worldRoll : m_roll;
+    }
+    else
+    {
+        m_worldPosition = m_position;
+        m_worldMotion = m_motion;
+        m_worldYaw = m_yaw;
+        m_worldPitch = m_pitch;
+        m_worldRoll = m_roll;
     }
-    return m_roll;
+    m_worldTransformDirty = false;
 }
 
+void SceneObject::setMainChanged()
+{
+    m_mainChanged = true;
+    setChanged();
+    m_owner.scheduleChangedObject(*this);
+}
+
+void SceneObject::setExtendedChanged()
+{
+    m_extendedChanged = true;
+    setChanged();
+    m_owner.scheduleChangedObject(*this);
+}
+
+void SceneObject::setTransformChanged()
+{
+    invalidateWorldTransform();
+
+    // Rotation and parent change move bounding box too. Children are
+    // updated with it.
+    m_owner.updateSpatialIndex(*this);
+}
+
+void SceneObject::invalidateWorldTransform()
+{
+    // Children of dirty object are always dirty, because they
+    // update their parent first.
+    if(m_worldTransformDirty)
+        return;
+    m_worldTransformDirty = true;
+    for(auto child: m_children)
+        child->invalidateWorldTransform();
+}
+
+void SceneObject::setPosition(Vec3d position)
+{
+    m_position = position;
+    setTransformChanged();
+}
+
+void SceneObject::setRenderLayer(int layer)
+{
+    if(m_renderLayer == layer)
+        return;
+    m_renderLayer = layer;
+    m_owner.scheduleLayerUpdate(*this);
+}
 
 bool SceneObject::moveTo(Vec3d pos)
 {
@@ -154,19 +214,53 @@ SharedPtr<ObjectMap> SceneObject::serializeMain() const
 bool SceneObject::deserializeMain(SharedPtr<ObjectMap> object)
 {
     ASSERT(object);
-    m_position = Serializers::toVector3(object->getObject("p").to<ObjectMap>().valueOr({}));
-    m_motion = Serializers::toVector3(object->getObject("m").to<ObjectMap>().valueOr({}));
-    m_yaw = object->getObject("yaw").asFloat().valueOr(0);
-    m_pitch = object->getObject("pitch").asFloat().valueOr(0);
-    m_roll = object->getObject("roll").asFloat().valueOr(0);
-    m_yawMode = (RotationMode)object->getObject("yawMode").asUnsignedInt().valueOr(m_yawMode);
-    m_pitchMode = (RotationMode)object->getObject("pitchMode").asUnsignedInt().valueOr(m_pitchMode);
-    m_rollMode = (RotationMode)object->getObject("rollMode").asUnsignedInt().valueOr(m_rollMode);
-    m_parentId = object->getObject("parent").asString().valueOr("");
-    m_renderLayer = object->getObject("layer").asInt().valueOr(0);
+    MainState state = getMainState();
+    state.position = Serializers::toVector3(object->getObject("p").to<ObjectMap>().valueOr({}));
+    state.motion = Serializers::toVector3(object->getObject("m").to<ObjectMap>().valueOr({}));
+    state.yaw = object->getObject("yaw").asFloat().valueOr(0);
+    state.pitch = object->getObject("pitch").asFloat().valueOr(0);
+    state.roll = object->getObject("roll").asFloat().valueOr(0);
+    state.yawMode = (RotationMode)object->getObject("yawMode").asUnsignedInt().valueOr(m_yawMode);
+    state.pitchMode = (RotationMode)object->getObject("pitchMode").asUnsignedInt().valueOr(m_pitchMode);
+    state.rollMode = (RotationMode)object->getObject("rollMode").asUnsignedInt().valueOr(m_rollMode);
+    state.parent = object->getObject("parent").asString().valueOr("");
+    state.layer = object->getObject("layer").asInt().valueOr(0);
+    applyMainState(state);
     return true;
 }
 
+SceneObject::MainState SceneObject::getMainState() const
+{
+    MainState state;
+    if(m_parent)
+        state.parent = m_parent->getName();
+    state.layer = m_renderLayer;
+    state.position = m_position;
+    state.motion = m_motion;
+    state.yaw = m_yaw;
+    state.pitch = m_pitch;
+    state.roll = m_roll;
+    state.yawMode = m_yawMode;
+    state.pitchMode = m_pitchMode;
+    state.rollMode = m_rollMode;
+    return state;
+}
+
+void SceneObject::applyMainState(const MainState& state)
+{
+    m_position = state.position;
+    m_motion = state.motion;
+    m_yaw = state.yaw;
+    m_pitch = state.pitch;
+    m_roll = state.roll;
+    m_yawMode = state.yawMode;
+    m_pitchMode = state.pitchMode;
+    m_rollMode = state.rollMode;
+    setTransformChanged();
+    m_parentId = state.parent;
+    setRenderLayer(state.layer);
+}
+
 void SceneObject::onUpdate(long long tickCounter)
 {
     if(!m_parentId.empty() && !m_parent)
@@ -250,12 +344,18 @@ bool SceneObject::deserializeExtended(SharedPtr<ObjectMap>)
 
 void SceneObject::setParent(SceneObject* object)
 {
+    if(m_owner.isParallelUpdateRunning())
+    {
+        m_owner.deferUntilCommit([this, object]() { setParent(object); });
+        return;
+    }
     ege_log.debug() << "SceneObject::setParent(" << object << ")";
     if(m_parent)
         m_parent->m_children.erase(this);
 
     setMainChanged();
     m_parent = object;
+    setTransformChanged();
     if(!object)
         return;
 
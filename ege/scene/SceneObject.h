@@ -61,8 +61,9 @@ class Scene;
 class SceneObject : public Animatable, public Controllable, public Renderable, public Serializable
 {
 public:
-    SceneObject(Scene& owner)
-    : Animatable((InspectorNode*)&owner, "SceneObject"), m_owner(owner) {}
+    // Objects created during parallel update phase are attached to Scene
+    // inspector node when they are added.
+    SceneObject(Scene& owner);
 
     enum Type
     {
@@ -107,6 +108,7 @@ public:
     Scene& getOwner() const { return m_owner; }
 
     void setParent(SceneObject* object);
+    SceneObject* getParent() const { return m_parent; }
 
     void addPart(String name, SharedPtr<Part> part);
     SharedPtrStringMap<Part>& getParts() { return m_parts; }
@@ -127,21 +129,37 @@ public:
     // The higher number is rendered on top of the lower number.
     // e.g. layer 1 objects are covered by layer 2 objects.
     int getRenderLayer() const { return m_renderLayer; }
-    void setRenderLayer(int layer) { m_renderLayer = layer; }
+    // Scene re-sorts only this object, right before next render.
+    void setRenderLayer(int layer);
 
     virtual String isnInfo() const override { return m_type->getId() + ": " + m_name; }
 
     virtual bool allowSave() const { return true; }
 
-    void setPosition(Vec3d position) { m_position = position; }
+    // If true, onUpdate() may be called from parallel update phase (see
+    // Scene::setParallelUpdate()), concurrently with other such objects. It may
+    // then modify only this object. Adding objects, setParent() and setRenderLayer()
+    // are deferred by Scene until the phase ends. Objects that have parent or
+    // children are always updated serially. World transforms are computed before
+    // the phase, so it may read objects that are updated serially, but not other
+    // objects that are updated in parallel.
+    virtual bool allowParallelUpdate() const { return false; }
+
+    // Scene doesn't render objects whose bounding box is outside of view.
+    // Objects that draw outside of their bounding box should return false.
+    virtual bool allowCulling() const { return !getBoundingBox().empty(); }
+
+    // Object (and its children) is moved in Scene spatial index later, see
+    // Scene::updateSpatialIndex().
+    void setPosition(Vec3d position);
     Vec3d getPosition() const;
 
-    void setMotion(Vec3d motion) { m_motion = motion; }
+    void setMotion(Vec3d motion) { m_motion = motion; setTransformChanged(); }
 
     // This motion is absolute (relative to scene, NOT to parent).
     Vec3d getMotion() const;
 
-    virtual RectD getBoundingBox() const { return RectD({m_position.x, m_position.y}, {}); }
+    virtual RectD getBoundingBox() const { return RectD(getPosition().toVec2d(), {}); }
 
     enum RotationMode
     {
@@ -149,17 +167,17 @@ public:
         Lock     // Parent angle is ignored
     };
 
-    void setYawRotationMode(RotationMode mode) { m_yawMode = mode; setGeometryNeedUpdate(); }
-    void setPitchRotationMode(RotationMode mode) { m_pitchMode = mode; setGeometryNeedUpdate(); }
-    void setRollRotationMode(RotationMode mode) { m_rollMode = mode; setGeometryNeedUpdate(); }
-    void setRotationMode(RotationMode mode) { m_yawMode = mode; setGeometryNeedUpdate(); }
+    void setYawRotationMode(RotationMode mode) { m_yawMode = mode; setGeometryNeedUpdate(); setTransformChanged(); }
+    void setPitchRotationMode(RotationMode mode) { m_pitchMode = mode; setGeometryNeedUpdate(); setTransformChanged(); }
+    void setRollRotationMode(RotationMode mode) { m_rollMode = mode; setGeometryNeedUpdate(); setTransformChanged(); }
+    void setRotationMode(RotationMode mode) { m_yawMode = mode; setGeometryNeedUpdate(); setTransformChanged(); }
 
-    void setYaw(double value) { m_yaw = value; setGeometryNeedUpdate(); }
-    void setPitch(double value) { m_pitch = value; setGeometryNeedUpdate(); }
-    void setRoll(double value) { m_roll = value; setGeometryNeedUpdate(); }
+    void setYaw(double value) { m_yaw = value; setGeometryNeedUpdate(); setTransformChanged(); }
+    void setPitch(double value) { m_pitch = value; setGeometryNeedUpdate(); setTransformChanged(); }
+    void setRoll(double value) { m_roll = value; setGeometryNeedUpdate(); setTransformChanged(); }
 
     // Alias for setYaw in 2D coordinates.
-    void setRotation(double value) { m_yaw = value; setGeometryNeedUpdate(); }
+    void setRotation(double value) { m_yaw = value; setGeometryNeedUpdate(); setTransformChanged(); }
 
     double getYaw() const;
     double getPitch() const;
@@ -171,11 +189,37 @@ public:
     bool moveTo(Vec3d targetPos);
     bool flyTo(Vec3d targetPos, double time, std::function<double(double)> easing = AnimationEasingFunctions::linear);
 
+    // Main data (the same as in serializeMain()) in plain form. Used by
+    // egeNetwork to send updates without building ObjectMaps. Values are
+    // local (relative to parent).
+    struct MainState
+    {
+        String parent;
+        int layer = 0;
+        Vec3d position;
+        Vec3d motion;
+        double yaw = 0;
+        double pitch = 0;
+        double roll = 0;
+        RotationMode yawMode = RotationMode::Inherit;
+        RotationMode pitchMode = RotationMode::Inherit;
+        RotationMode rollMode = RotationMode::Inherit;
+    };
+
+    MainState getMainState() const;
+    void applyMainState(const MainState& state);
+
+    // If true, main data is sent to clients as MainState fields that changed,
+    // instead of whole serializeMain(). Only objects that don't extend
+    // serializeMain() may return true.
+    virtual bool allowCompactUpdates() const { return false; }
+
 protected:
     friend class Scene;
+    friend class SpatialGrid;
 
-    void setMainChanged() { m_mainChanged = true; setChanged(); }
-    void setExtendedChanged() { m_extendedChanged = true; setChanged(); }
+    void setMainChanged();
+    void setExtendedChanged();
     void setChanged() { m_changedSinceLoad = true; }
 
     void init();
@@ -208,6 +252,43 @@ private:
     RotationMode m_pitchMode = RotationMode::Inherit;
     RotationMode m_rollMode = RotationMode::Inherit;
     bool m_deserialized = false;
+
+    // World transform, cached until local transform of this object
+    // or any of its parents changes.
+    void updateWorldTransform() const;
+    // Also schedules spatial index update of object and its children.
+    void setTransformChanged();
+    void invalidateWorldTransform();
+
+    mutable Vec3d m_worldPosition;
+    mutable Vec3d m_worldMotion;
+    mutable double m_worldYaw = 0;
+    mutable double m_worldPitch = 0;
+    mutable double m_worldRoll = 0;
+    mutable bool m_worldTransformDirty = true;
+
+    // Position in Scene render order. Managed by Scene.
+    std::multimap<int, SceneObject*>::iterator m_layerIterator;
+    bool m_layerIndexed = false;
+    bool m_layerUpdatePending = false;
+    Size m_layerUpdateIndex = 0;
+
+    bool m_updatedInParallel = false;
+
+    // In Scene changed object list. Managed by Scene.
+    bool m_changeListed = false;
+    Size m_changeListIndex = 0;
+
+    // Cells in Scene spatial index. Managed by SpatialGrid.
+    RectI m_spatialCells;
+    Size m_spatialSlot = 0;
+    bool m_spatialIndexed = false;
+
+    // In Scene pending spatial index updates. Managed by Scene.
+    bool m_spatialUpdatePending = false;
+    Size m_spatialUpdateIndex = 0;
+    Size m_spatialUpdateRound = 0;
+    Size m_visibleFrame = 0;
 };
 
 }
@@ -0,0 +1,142 @@
+/*
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*      ,----  ,----  ,----
+*      |      |      |
+*      |----  | --,  |----
+*      |      |   |  |
+*      '----  '---'  '----
+*
+*     Framework Library for Hexagon
+*
+*    Copyright (c) Sppmacd 2020 - 2021
+*
+*    Permission is hereby granted, free of charge, to any person obtaining a copy
+*    of this software and associated documentation files (the "Software"), to deal
+*    in the Software without restriction, including without limitation the rights
+*    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*    copies of the Software, and to permit persons to whom the Software is
+*    furnished to do so, subject to the following conditions:
+*
+*    The above copyright notice and this permission notice shall be included in all
+*    copies or substantial portions of the Software.
+*
+*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*    SOFTWARE.
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*/
+
+#include "SceneObjectStorage.h"
+
+#include "SceneObject.h"
+
+namespace EGE
+{
+
+SceneObjectStorage::Handle SceneObjectStorage::insert(SharedPtr<SceneObject> object)
+{
+    ASSERT(object);
+    Size slot;
+    if(!m_freeSlots.empty())
+    {
+        slot = m_freeSlots.back();
+        m_freeSlots.pop_back();
+    }
+    else
+    {
+        slot = m_slots.size();
+        m_slots.emplace_back();
+    }
+
+    UidType id = object->getObjectId();
+    bool inserted = m_slotById.insert(std::make_pair(id, slot)).second;
+    ASSERT_WITH_MESSAGE(inserted, "Duplicate SceneObject ID in storage");
+
+    m_slots[slot].index = m_objects.size();
+    m_objects.push_back(std::make_pair(id, std::move(object)));
+    m_slotByIndex.push_back(slot);
+
+    Handle handle;
+    handle.slot = slot;
+    handle.generation = m_slots[slot].generation;
+    return handle;
+}
+
+SceneObjectStorage::iterator SceneObjectStorage::erase(iterator it)
+{
+    Size index = it - m_objects.begin();
+    Size lastIndex = m_objects.size() - 1;
+    Size slot = m_slotByIndex[index];
+
+    m_slotById.erase(it->first);
+    if(index != lastIndex)
+    {
+        // Move last object into freed place.
+        *it = std::move(m_objects[lastIndex]);
+        m_slotByIndex[index] = m_slotByIndex[lastIndex];
+        m_slots[m_slotByIndex[index]].index = index;
+    }
+    m_objects.pop_back();
+    m_slotByIndex.pop_back();
+
+    // Invalidate all handles to removed object.
+    m_slots[slot].generation++;
+    m_freeSlots.push_back(slot);
+    return m_objects.begin() + index;
+}
+
+bool SceneObjectStorage::erase(UidType id)
+{
+    auto it = find(id);
+    if(it == end())
+        return false;
+    erase(it);
+    return true;
+}
+
+SceneObjectStorage::iterator SceneObjectStorage::find(UidType id)
+{
+    auto it = m_slotById.find(id);
+    if(it == m_slotById.end())
+        return end();
+    return m_objects.begin() + m_slots[it->second].index;
+}
+
+SceneObjectStorage::const_iterator SceneObjectStorage::find(UidType id) const
+{
+    auto it = m_slotById.find(id);
+    if(it == m_slotById.end())
+        return end();
+    return m_objects.begin() + m_slots[it->second].index;
+}
+
+SceneObjectStorage::Handle SceneObjectStorage::getHandle(UidType id) const
+{
+    Handle handle;
+    auto it = m_slotById.find(id);
+    if(it == m_slotById.end())
+        return handle;
+    handle.slot = it->second;
+    handle.generation = m_slots[it->second].generation;
+    return handle;
+}
+
+SceneObject* SceneObjectStorage::get(Handle handle) const
+{
+    if(handle.slot >= m_slots.size())
+        return nullptr;
+    auto& slot = m_slots[handle.slot];
+    if(slot.generation != handle.generation)
+        return nullptr;
+    return m_objects[slot.index].second.get();
+}
+
+}
@@ -0,0 +1,108 @@
+/*
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*      ,----  ,----  ,----
+*      |      |      |
+*      |----  | --,  |----
+*      |      |   |  |
+*      '----  '---'  '----
+*
+*     Framework Library for Hexagon
+*
+*    Copyright (c) Sppmacd 2020 - 2021
+*
+*    Permission is hereby granted, free of charge, to any person obtaining a copy
+*    of this software and associated documentation files (the "Software"), to deal
+*    in the Software without restriction, including without limitation the rights
+*    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*    copies of the Software, and to permit persons to whom the Software is
+*    furnished to do so, subject to the following conditions:
+*
+*    The above copyright notice and this permission notice shall be included in all
+*    copies or substantial portions of the Software.
+*
+*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*    SOFTWARE.
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*/
+
+#pragma once
+
+#include <ege/util/Types.h>
+
+#include <unordered_map>
+
+namespace EGE
+{
+
+class SceneObject;
+
+// Dense storage for SceneObjects. Objects are kept in one contiguous array,
+// so iterating them doesn't jump over tree nodes and doesn't touch refcounts.
+// Removing swaps the last object into the freed place, so iteration order
+// is NOT stable.
+class SceneObjectStorage
+{
+public:
+    typedef std::pair<UidType, SharedPtr<SceneObject>> value_type;
+    typedef Vector<value_type>::iterator iterator;
+    typedef Vector<value_type>::const_iterator const_iterator;
+
+    // Stays valid until object is removed. Slots are reused, so the generation
+    // number is used to tell that handle refers to object that doesn't exist anymore.
+    struct Handle
+    {
+        Size slot = 0;
+        Uint32 generation = 0;
+
+        bool isValid() const { return generation != 0; }
+    };
+
+    // Object with the same ID must not be already stored.
+    Handle insert(SharedPtr<SceneObject> object);
+
+    // Swap-and-pop. Returns iterator to the object that took place of the removed one.
+    iterator erase(iterator it);
+    bool erase(UidType id);
+
+    iterator find(UidType id);
+    const_iterator find(UidType id) const;
+
+    Handle getHandle(UidType id) const;
+
+    // Returns nullptr if object was removed.
+    SceneObject* get(Handle handle) const;
+
+    SceneObject& operator[](Size index) const { return *m_objects[index].second; }
+
+    iterator begin() { return m_objects.begin(); }
+    iterator end() { return m_objects.end(); }
+    const_iterator begin() const { return m_objects.begin(); }
+    const_iterator end() const { return m_objects.end(); }
+
+    Size size() const { return m_objects.size(); }
+    bool empty() const { return m_objects.empty(); }
+
+private:
+    struct Slot
+    {
+        Size index = 0;
+        Uint32 generation = 1;
+    };
+
+    Vector<value_type> m_objects;
+    Vector<Size> m_slotByIndex;
+    Vector<Slot> m_slots;
+    Vector<Size> m_freeSlots;
+    std::unordered_map<UidType, Size> m_slotById;
+};
+
+}
@@ -0,0 +1,191 @@
+/*
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*      ,----  ,----  ,----
+*      |      |      |
+*      |----  | --,  |----
+*      |      |   |  |
+*      '----  '---'  '----
+*
+*     Framework Library for Hexagon
+*
+*    Copyright (c) Sppmacd 2020 - 2021
+*
+*    Permission is hereby granted, free of charge, to any person obtaining a copy
+*    of this software and associated documentation files (the "Software"), to deal
+*    in the Software without restriction, including without limitation the rights
+*    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*    copies of the Software, and to permit persons to whom the Software is
+*    furnished to do so, subject to the following conditions:
+*
+*    The above copyright notice and this permission notice shall be included in all
+*    copies or substantial portions of the Software.
+*
+*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*    SOFTWARE.
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*/
+
+#include "SpatialGrid.h"
+
+#include "SceneObject.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace EGE
+{
+
+// Objects occupying more cells are treated as large.
+static const int MAX_CELLS_PER_OBJECT = 64;
+
+SpatialGrid::SpatialGrid(double cellSize)
+: m_cellSize(cellSize)
+{
+    ASSERT(cellSize > 0);
+}
+
+void SpatialGrid::update(SceneObject& object)
+{
+    RectI cells = cellsFor(object.getBoundingBox());
+    if(object.m_spatialIndexed)
+    {
+        if(cells == object.m_spatialCells)
+            return;
+        removeFromCells(object);
+    }
+    object.m_spatialCells = cells;
+    object.m_spatialIndexed = true;
+    addToCells(object);
+}
+
+void SpatialGrid::remove(SceneObject& object)
+{
+    if(!object.m_spatialIndexed)
+        return;
+    removeFromCells(object);
+    object.m_spatialIndexed = false;
+}
+
+void SpatialGrid::query(RectD rect, const std::function<void(SceneObject&)>& callback) const
+{
+    for(auto object: m_largeObjects)
+    {
+        if(intersects(object->getBoundingBox(), rect))
+            callback(*object);
+    }
+
+    RectI queryCells = cellsFor(rect);
+    Vec2i end = queryCells.position + queryCells.size;
+    for(int x = queryCells.position.x; x <= end.x; x++)
+    for(int y = queryCells.position.y; y <= end.y; y++)
+    {
+        auto it = m_cells.find({x, y});
+        if(it == m_cells.end())
+            continue;
+        for(auto object: it->second)
+        {
+            // Report object only from its first cell inside query,
+            // so that objects spanning multiple cells are reported once.
+            auto& cells = object->m_spatialCells;
+            if(x != std::max(cells.position.x, queryCells.position.x) || y != std::max(cells.position.y, queryCells.position.y))
+                continue;
+            if(intersects(object->getBoundingBox(), rect))
+                callback(*object);
+        }
+    }
+}
+
+bool SpatialGrid::intersects(const RectD& _1, const RectD& _2)
+{
+    // Inclusive, so that objects with empty bounding box work like points.
+    return _1.position.x <= _2.position.x + _2.size.x && _2.position.x <= _1.position.x + _1.size.x
+        && _1.position.y <= _2.position.y + _2.size.y && _2.position.y <= _1.position.y + _1.size.y;
+}
+
+RectI SpatialGrid::cellsFor(const RectD& rect) const
+{
+    Vec2i begin(std::floor(rect.position.x / m_cellSize), std::floor(rect.position.y / m_cellSize));
+    Vec2i end(std::floor((rect.position.x + rect.size.x) / m_cellSize), std::floor((rect.position.y + rect.size.y) / m_cellSize));
+    return RectI(begin, end - begin);
+}
+
+bool SpatialGrid::isLarge(const RectI& cells) const
+{
+    return (cells.size.x + 1) * (cells.size.y + 1) > MAX_CELLS_PER_OBJECT;
+}
+
+bool SpatialGrid::isSingleCell(const RectI& cells) const
+{
+    return cells.size.x == 0 && cells.size.y == 0;
+}
+
+void SpatialGrid::addToCells(SceneObject& object)
+{
+    auto& cells = object.m_spatialCells;
+    if(isLarge(cells))
+    {
+        m_largeObjects.push_back(&object);
+        return;
+    }
+
+    if(isSingleCell(cells))
+    {
+        auto& objects = m_cells[cells.position];
+        object.m_spatialSlot = objects.size();
+        objects.push_back(&object);
+        return;
+    }
+
+    Vec2i end = cells.position + cells.size;
+    for(int x = cells.position.x; x <= end.x; x++)
+    for(int y = cells.position.y; y <= end.y; y++)
+        m_cells[{x, y}].push_back(&object);
+}
+
+void SpatialGrid::removeFromCells(SceneObject& object)
+{
+    // Most objects occupy one cell and know their place in it, the rest is searched for.
+    auto removeFrom = [this, &object](Vector<SceneObject*>& objects) {
+        Size index;
+        if(isSingleCell(object.m_spatialCells))
+            index = object.m_spatialSlot;
+        else
+            index = std::find(objects.begin(), objects.end(), &object) - objects.begin();
+        ASSERT(index < objects.size() && objects[index] == &object);
+
+        SceneObject* moved = objects.back();
+        objects[index] = moved;
+        objects.pop_back();
+        if(isSingleCell(moved->m_spatialCells))
+            moved->m_spatialSlot = index;
+    };
+
+    auto& cells = object.m_spatialCells;
+    if(isLarge(cells))
+    {
+        removeFrom(m_largeObjects);
+        return;
+    }
+
+    Vec2i end = cells.position + cells.size;
+    for(int x = cells.position.x; x <= end.x; x++)
+    for(int y = cells.position.y; y <= end.y; y++)
+    {
+        auto it = m_cells.find({x, y});
+        ASSERT(it != m_cells.end());
+        removeFrom(it->second);
+        if(it->second.empty())
+            m_cells.erase(it);
+    }
+}
+
+}
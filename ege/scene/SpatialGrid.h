@@ -0,0 +1,86 @@
+/*
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*      ,----  ,----  ,----
+*      |      |      |
+*      |----  | --,  |----
+*      |      |   |  |
+*      '----  '---'  '----
+*
+*     Framework Library for Hexagon
+*
+*    Copyright (c) Sppmacd 2020 - 2021
+*
+*    Permission is hereby granted, free of charge, to any person obtaining a copy
+*    of this software and associated documentation files (the "Software"), to deal
+*    in the Software without restriction, including without limitation the rights
+*    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*    copies of the Software, and to permit persons to whom the Software is
+*    furnished to do so, subject to the following conditions:
+*
+*    The above copyright notice and this permission notice shall be included in all
+*    copies or substantial portions of the Software.
+*
+*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*    SOFTWARE.
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*/
+
+#pragma once
+
+#include <ege/tilemap/TileMap2D.h>
+#include <ege/util/Rect.h>
+#include <ege/util/Types.h>
+#include <ege/util/Vector.h>
+
+#include <functional>
+#include <unordered_map>
+
+namespace EGE
+{
+
+class SceneObject;
+
+// Uniform grid of SceneObjects, based on their bounding boxes. Used by Scene
+// for area queries and culling. Objects that would occupy too many cells
+// are kept in separate list and checked on every query.
+class SpatialGrid
+{
+public:
+    explicit SpatialGrid(double cellSize = 128);
+
+    // Inserts object or moves it to its current cells. It's cheap if object
+    // didn't leave its cells.
+    void update(SceneObject& object);
+    void remove(SceneObject& object);
+
+    // Calls %callback once for every object whose bounding box intersects %rect.
+    void query(RectD rect, const std::function<void(SceneObject&)>& callback) const;
+
+    double getCellSize() const { return m_cellSize; }
+
+    static bool intersects(const RectD& _1, const RectD& _2);
+
+private:
+    typedef std::unordered_map<Vec2i, Vector<SceneObject*>, ChunkCoordsHash, ChunkCoordsEqual> CellMap;
+
+    RectI cellsFor(const RectD& rect) const;
+    bool isLarge(const RectI& cells) const;
+    bool isSingleCell(const RectI& cells) const;
+    void addToCells(SceneObject& object);
+    void removeFromCells(SceneObject& object);
+
+    CellMap m_cells;
+    Vector<SceneObject*> m_largeObjects;
+    double m_cellSize;
+};
+
+}
@@ -45,6 +45,8 @@
 #include <ege/tilemap/TileMap2D.h>
 #include <ege/util.h>
 
+#include <unordered_map>
+
 namespace EGE
 {
 
@@ -75,11 +77,15 @@ public:
     typedef std::function<void(const typename TMap::TileType&, Vector2<MaxInt>, Size, AtlasInfo&)> AtlasMapper;
 
     // The function maps tile type (in tilemap) to atlas coords to render (in pixels).
-    void setTileAtlasMapper(AtlasMapper mapper) { m_tileMapper = mapper; }
-
-    // Use ensureTile() instead of getTile(). The tilemap will be resized
-    // if possible and necessary. DO NOT USE IT WITH FIXED TILEMAPS, otherwise
-    // assertion will be triggered.
+    // Results are cached per chunk, so the mapper is called again only for chunks
+    // that were marked dirty. If the mapping depends on anything else than tile
+    // itself (e.g neighbouring tiles in other chunks), call invalidateChunk() or
+    // invalidateCache() when it changes.
+    void setTileAtlasMapper(AtlasMapper mapper) { m_tileMapper = mapper; invalidateCache(); }
+
+    // Request missing chunks from tilemap (requestChunk()) instead of skipping
+    // them. Tilemaps with async generation return chunks that are not ready
+    // yet as nullptr, and these are skipped until generated.
     void setUseEnsure(bool ensure = true) { m_useEnsure = ensure; }
 
     // Useful for shadows.
@@ -89,13 +95,65 @@ public:
         m_layerCount = lc;
         m_atlasNames.resize(lc);
         m_atlasses.resize(lc);
+        invalidateCache();
         setGeometryNeedUpdate();
     }
 
-    virtual void renderLayer(Size layer, Vec2d objPos, Vector2<MaxInt> beginChunk, Vector2<MaxInt> endChunk, Renderer& renderer) const
+    // Drop cached geometry of all chunks.
+    void invalidateCache() { m_meshCache.clear(); }
+
+    // Drop cached geometry of specified chunk.
+    void invalidateChunk(Vector2<MaxInt> chunkCoords) { m_meshCache.erase(Vec2i(chunkCoords)); }
+
+    // Returns geometry of specified chunk and layer, rebuilding it if the chunk
+    // was modified since last call. Vertex positions are relative to the chunk
+    // origin. Returns nullptr if the chunk doesn't exist.
+    const sf::VertexArray* getChunkMesh(Vector2<MaxInt> chunkCoords, Size layer) const
     {
-        sf::VertexArray vertexes(sf::Quads);
+        ASSERT(layer < m_layerCount);
+        ASSERT(m_tileMapper);
+
+        const typename TMap::ChunkType* chunk = (m_useEnsure
+                                                        ? m_tileMap->requestChunk({(typename TMap::SizeType)chunkCoords.x, (typename TMap::SizeType)chunkCoords.y})
+                                                        : m_tileMap->getChunk({(typename TMap::SizeType)chunkCoords.x, (typename TMap::SizeType)chunkCoords.y})
+                                                    );
+        Vec2i cacheKey(chunkCoords);
+        if(!chunk)
+        {
+            m_meshCache.erase(cacheKey);
+            return nullptr;
+        }
+
+        Vec2u tileSize = m_tileMap->getTileSize();
+        if(tileSize.x != m_meshTileSize.x || tileSize.y != m_meshTileSize.y)
+        {
+            m_meshCache.clear();
+            m_meshTileSize = tileSize;
+        }
+
+        ChunkMesh& mesh = m_meshCache[cacheKey];
+        mesh.lastUsedFrame = m_frame;
+        if(mesh.chunk != chunk || mesh.layers.size() != m_layerCount)
+        {
+            mesh.chunk = chunk;
+            mesh.layers.clear();
+            mesh.layers.resize(m_layerCount);
+        }
+
+        LayerMesh& layerMesh = mesh.layers[layer];
+        if(!layerMesh.valid || layerMesh.revision != chunk->getRevision())
+        {
+            buildChunkMesh(*chunk, chunkCoords, layer, layerMesh.vertexes);
+            layerMesh.revision = chunk->getRevision();
+            layerMesh.valid = true;
+        }
+        return &layerMesh.vertexes;
+    }
+
+    Size getCachedChunkCount() const { return m_meshCache.size(); }
 
+    virtual void renderLayer(Size layer, Vec2d objPos, Vector2<MaxInt> beginChunk, Vector2<MaxInt> endChunk, Renderer& renderer) const
+    {
         Vec2u tileSize = m_tileMap->getTileSize();
         Vec2s chunkSize = m_tileMap->getChunkSize();
 
@@ -104,139 +162,33 @@ public:
         ASSERT(chunkSize.x != 0);
         ASSERT(chunkSize.y != 0);
 
-        Size arraySize = (endChunk.x - beginChunk.x + 1) * (endChunk.y - beginChunk.y + 1) * chunkSize.x * chunkSize.y * 4;
-        vertexes.resize(arraySize);
-        Size index = 0;
-        Size realIndex;
+        // TODO: use triangles?
+        auto texture = m_atlasses[layer];
+        ASSERT(texture);
+        RenderStates newStates = renderer.getStates();
+        newStates.sfStates().texture = &texture->getTexture();
+        sf::Transform baseTransform = newStates.sfStates().transform;
 
-        // TODO: calculate and reserve required space
-        // TODO: don't check tiles outside the bounds
         // TODO: allow checking bounds inside tilemap if it's applicable
         for(MaxInt cx = beginChunk.x; cx <= endChunk.x; cx++)
         {
             for(MaxInt cy = beginChunk.y; cy <= endChunk.y; cy++)
             {
-                const typename TMap::ChunkType* chunk = (m_useEnsure
-                                                                ? &m_tileMap->ensureChunk({(typename TMap::SizeType)cx, (typename TMap::SizeType)cy})
-                                                                : m_tileMap->getChunk({(typename TMap::SizeType)cx, (typename TMap::SizeType)cy})
-                                                            );
-                if(!chunk)
+                const sf::VertexArray* mesh = getChunkMesh({cx, cy}, layer);
+                if(!mesh)
                     continue;
 
-                for(Size x = 0; x < chunkSize.x; x++)
-                {
-                    for(Size y = 0; y < chunkSize.y; y++)
-                    {
-                        const typename TMap::TileType& tile = chunk->getTile({x, y});
-
-                        MaxInt vx = cx * (MaxInt)chunkSize.x + (MaxInt)x;
-                        MaxInt vy = cy * (MaxInt)chunkSize.y + (MaxInt)y;
-
-                        AtlasInfo info;
-                        m_tileMapper(tile, {vx, vy}, layer, info);
-
-                        // tex coords
-                        Size index2 = index;
-                        {
-                            sf::Vertex& vertex = vertexes[index2++];
-                            vertex.texCoords.x = info.texCoords.x;
-                            vertex.texCoords.y = info.texCoords.y;
-                        }
-
-                        {
-                            sf::Vertex& vertex = vertexes[index2++];
-                            vertex.texCoords.x = info.texCoords.x + tileSize.x - 1;
-                            vertex.texCoords.y = info.texCoords.y;
-                        }
-
-                        {
-                            sf::Vertex& vertex = vertexes[index2++];
-                            vertex.texCoords.x = info.texCoords.x + tileSize.x - 1;
-                            vertex.texCoords.y = info.texCoords.y + tileSize.y - 1;
-                        }
-
-                        {
-                            sf::Vertex& vertex = vertexes[index2++];
-                            vertex.texCoords.x = info.texCoords.x;
-                            vertex.texCoords.y = info.texCoords.y + tileSize.y - 1;
-                        }
-
-                        // position & color
-                        {
-                            realIndex = (index / 4 * 4) + (index + info.rotation) % 4;
-                            sf::Vertex& vertex = vertexes[realIndex];
-                            vertex.position.x = vx * tileSize.x + objPos.x;
-                            vertex.position.y = vy * tileSize.y + objPos.y;
-
-                            // color
-                            vertex.color.r = 255;
-                            vertex.color.g = 255;
-                            vertex.color.b = 255;
-                            vertex.color.a = 255;
-
-                            index++;
-                        }
-
-                        {
-                            realIndex = (index / 4 * 4) + (index + info.rotation) % 4;
-                            sf::Vertex& vertex = vertexes[realIndex];
-                            vertex.position.x = (vx + 1) * tileSize.x + objPos.x;
-                            vertex.position.y = vy * tileSize.y + objPos.y;
-
-                            // color
-                            vertex.color.r = 255;
-                            vertex.color.g = 255;
-                            vertex.color.b = 255;
-                            vertex.color.a = 255;
-
-                            index++;
-                        }
-
-                        {
-                            realIndex = (index / 4 * 4) + (index + info.rotation) % 4;
-                            sf::Vertex& vertex = vertexes[realIndex];
-                            vertex.position.x = (vx + 1) * tileSize.x + objPos.x;
-                            vertex.position.y = (vy + 1) * tileSize.y + objPos.y;
-
-                            // color
-                            vertex.color.r = 255;
-                            vertex.color.g = 255;
-                            vertex.color.b = 255;
-                            vertex.color.a = 255;
-
-                            index++;
-                        }
-
-                        {
-                            realIndex = (index / 4 * 4) + (index + info.rotation) % 4;
-                            sf::Vertex& vertex = vertexes[realIndex];
-                            vertex.position.x = vx * tileSize.x + objPos.x;
-                            vertex.position.y = (vy + 1) * tileSize.y + objPos.y;
-
-                            // color
-                            vertex.color.r = 255;
-                            vertex.color.g = 255;
-                            vertex.color.b = 255;
-                            vertex.color.a = 255;
-
-                            index++;
-                        }
-                    }
-                }
+                sf::Transform transform = baseTransform;
+                transform.translate(objPos.x + cx * (MaxInt)chunkSize.x * tileSize.x,
+                                    objPos.y + cy * (MaxInt)chunkSize.y * tileSize.y);
+                newStates.sfStates().transform = transform;
+                renderer.getTarget().draw(*mesh, newStates.sfStates());
             }
         }
-
-        // TODO: use triangles?
-        auto texture = m_atlasses[layer];
-        ASSERT(texture);
-        RenderStates newStates = renderer.getStates();
-        newStates.sfStates().texture = &texture->getTexture();
-        renderer.getTarget().draw(vertexes, newStates.sfStates());
     }
 
     virtual void render(Renderer& renderer) const override
     {
-        // TODO: tilemap render cache (it should go to updateGeometry)
         ASSERT(m_tileMapper);
 
         Vec2u tileSize = m_tileMap->getTileSize();
@@ -263,8 +215,18 @@ public:
             (MaxInt)((endCoord.y - objPos.y) / ((MaxInt)tileSize.y * chunkSize.y) + 1)
         };
 
+        m_frame++;
         for(Size s = 0; s < m_layerCount; s++)
             renderLayer(s, objPos, beginChunk, endChunk, renderer);
+
+        // Forget chunks that went out of view.
+        for(auto it = m_meshCache.begin(); it != m_meshCache.end();)
+        {
+            if(it->second.lastUsedFrame != m_frame)
+                it = m_meshCache.erase(it);
+            else
+                ++it;
+        }
     }
 
     virtual void updateGeometry(Renderer&) override
@@ -286,12 +248,101 @@ public:
     }
 
 private:
+    void buildChunkMesh(const typename TMap::ChunkType& chunk, Vector2<MaxInt> chunkCoords, Size layer, sf::VertexArray& vertexes) const
+    {
+        Vec2u tileSize = m_tileMap->getTileSize();
+        Vec2s chunkSize = m_tileMap->getChunkSize();
+
+        vertexes.setPrimitiveType(sf::Quads);
+        vertexes.resize(chunkSize.x * chunkSize.y * 4);
+        Size index = 0;
+        Size realIndex;
+
+        for(Size x = 0; x < chunkSize.x; x++)
+        {
+            for(Size y = 0; y < chunkSize.y; y++)
+            {
+                const typename TMap::TileType& tile = chunk.getTile({x, y});
+
+                MaxInt vx = chunkCoords.x * (MaxInt)chunkSize.x + (MaxInt)x;
+                MaxInt vy = chunkCoords.y * (MaxInt)chunkSize.y + (MaxInt)y;
+
+                AtlasInfo info;
+                m_tileMapper(tile, {vx, vy}, layer, info);
+
+                // tex coords
+                Size index2 = index;
+                {
+                    sf::Vertex& vertex = vertexes[index2++];
+                    vertex.texCoords.x = info.texCoords.x;
+                    vertex.texCoords.y = info.texCoords.y;
+                }
+
+                {
+                    sf::Vertex& vertex = vertexes[index2++];
+                    vertex.texCoords.x = info.texCoords.x + tileSize.x - 1;
+                    vertex.texCoords.y = info.texCoords.y;
+                }
+
+                {
+                    sf::Vertex& vertex = vertexes[index2++];
+                    vertex.texCoords.x = info.texCoords.x + tileSize.x - 1;
+                    vertex.texCoords.y = info.texCoords.y + tileSize.y - 1;
+                }
+
+                {
+                    sf::Vertex& vertex = vertexes[index2++];
+                    vertex.texCoords.x = info.texCoords.x;
+                    vertex.texCoords.y = info.texCoords.y + tileSize.y - 1;
+                }
+
+                // position (relative to chunk) & color
+                float px = x * tileSize.x;
+                float py = y * tileSize.y;
+                const float positions[4][2] = {
+                    {px, py},
+                    {px + tileSize.x, py},
+                    {px + tileSize.x, py + tileSize.y},
+                    {px, py + tileSize.y}
+                };
+
+                for(Size s = 0; s < 4; s++)
+                {
+                    realIndex = (index / 4 * 4) + (index + info.rotation) % 4;
+                    sf::Vertex& vertex = vertexes[realIndex];
+                    vertex.position.x = positions[s][0];
+                    vertex.position.y = positions[s][1];
+                    vertex.color = sf::Color::White;
+                    index++;
+                }
+            }
+        }
+    }
+
+    struct LayerMesh
+    {
+        sf::VertexArray vertexes;
+        Size revision = 0;
+        bool valid = false;
+    };
+
+    struct ChunkMesh
+    {
+        const void* chunk = nullptr;
+        Vector<LayerMesh> layers;
+        Size lastUsedFrame = 0;
+    };
+
     SharedPtr<TMap> m_tileMap;
     SharedPtrVector<Texture> m_atlasses;
     Vector<std::string> m_atlasNames;
     AtlasMapper m_tileMapper;
     bool m_useEnsure = false;
     EGE::Size m_layerCount = 1;
+
+    mutable std::unordered_map<Vec2i, ChunkMesh, ChunkCoordsHash, ChunkCoordsEqual> m_meshCache;
+    mutable Vec2u m_meshTileSize;
+    mutable Size m_frame = 0;
 };
 
 }
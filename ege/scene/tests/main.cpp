@@ -5,15 +5,25 @@
 #include <ege/gui/AnimationEasingFunctions.h>
 #include <ege/gui/GUIGameLoop.h>
 #include <ege/gui/Label.h>
+#include <ege/scene/BatchedParticleSystem2D.h>
+#include <ege/scene/DummyObject2D.h>
 #include <ege/scene/ParticleSystem2D.h>
 #include <ege/scene/Scene.h>
 #include <ege/scene/SceneLoader.h>
 #include <ege/scene/SceneWidget.h>
+#include <ege/scene/TilemapRenderer2D.h>
 #include <ege/scene/Plain2DCamera.h>
 #include <ege/tilemap/ChunkedTileMap2D.h>
 #include <ege/tilemap/FixedTileMap2D.h>
+#include <ege/util/Random.h>
 #include <ege/util/system.h>
 
+// mallinfo2() is in glibc 2.33+.
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+#define HAVE_MALLINFO2 1
+#include <malloc.h>
+#endif
+
 // my object definition
 class MyObject : public EGE::SceneObject
 {
@@ -425,4 +435,521 @@ TESTCASE(parenting)
     return 0;
 }
 
+class HeadlessScene : public EGE::Scene
+{
+public:
+    HeadlessScene()
+    : EGE::Scene(nullptr) {}
+
+    using EGE::Scene::rebuildLayers;
+    using EGE::Scene::updateLayers;
+
+    template<class SO = EGE::DummyObject2D>
+    void spawn(int count, bool rebuildEveryObject)
+    {
+        if(!getRegistry().getType(SO::type()))
+            getRegistry().addType<SO>();
+        auto type = getRegistry().getType(SO::type());
+        for(int s = 0; s < count; s++)
+        {
+            auto object = make<SO>(*this);
+            object->setType(type);
+            object->setRenderLayer(s % 10);
+            addObject(object);
+
+            // This is what Scene did before render order was incremental.
+            if(rebuildEveryObject)
+                rebuildLayers();
+        }
+        updateLayers();
+    }
+
+    bool isRenderOrderValid()
+    {
+        updateLayers();
+        if(m_objectsByLayer.size() != m_objects.size() + m_staticObjects.size())
+            return false;
+        int lastLayer = std::numeric_limits<int>::min();
+        for(auto& pr: m_objectsByLayer)
+        {
+            if(pr.first != pr.second->getRenderLayer() || pr.first < lastLayer)
+                return false;
+            lastLayer = pr.first;
+        }
+        return true;
+    }
+};
+
+// Compare CPU time of these two.
+TESTCASE(layerBulkSpawn)
+{
+    HeadlessScene scene;
+    scene.spawn(2000, false);
+    EXPECT(scene.isRenderOrderValid());
+
+    // Move some objects between layers and kill some.
+    int counter = 0;
+    for(auto& pr: scene)
+    {
+        if(counter % 3 == 0)
+            pr.second->setRenderLayer(-pr.second->getRenderLayer());
+        if(counter % 7 == 0)
+            pr.second->setDead();
+        counter++;
+    }
+    scene.onUpdate(0);
+    scene.updateLayers();
+    EXPECT(scene.isRenderOrderValid());
+    return 0;
+}
+
+// Objects spawned and killed before they are rendered.
+TESTCASE(layerSpawnKillBurst)
+{
+    HeadlessScene scene;
+    scene.getRegistry().addType<EGE::DummyObject2D>();
+    auto type = scene.getRegistry().getType(EGE::DummyObject2D::type());
+    for(int s = 0; s < 100000; s++)
+    {
+        auto object = make<EGE::DummyObject2D>(scene);
+        object->setType(type);
+        object->setRenderLayer(s % 10);
+        scene.addObject(object);
+        if(s % 2 == 0)
+            object->setDead();
+    }
+    scene.onUpdate(0);
+    EXPECT_EQUAL(std::distance(scene.begin(), scene.end()), 50000);
+    EXPECT(scene.isRenderOrderValid());
+    EXPECT_EQUAL(scene.takeChangedObjects().size(), 50000u);
+    return 0;
+}
+
+TESTCASE(layerBulkSpawnFullRebuild)
+{
+    HeadlessScene scene;
+    scene.spawn(2000, true);
+    EXPECT(scene.isRenderOrderValid());
+    return 0;
+}
+
+TESTCASE(headlessUpdate100k)
+{
+    HeadlessScene scene;
+    scene.spawn(100000, false);
+
+    for(int s = 0; s < 10; s++)
+        scene.onUpdate(s);
+
+    // Kill every 10th object, the rest must stay reachable by ID and handle.
+    auto handle = scene.getObjectHandle(-5);
+    EXPECT(scene.getObject(handle) == scene.getObject(-5).get());
+    for(auto& pr: scene)
+    {
+        if(-pr.first % 10 == 0)
+            pr.second->setDead();
+    }
+    scene.onUpdate(10);
+    EXPECT_EQUAL(std::distance(scene.begin(), scene.end()), 90000);
+    EXPECT(!scene.getObject(-10));
+    EXPECT(scene.getObject(-5));
+    EXPECT(scene.getObject(handle) == scene.getObject(-5).get());
+
+    handle = scene.getObjectHandle(-15);
+    scene.getObject(-15)->setDead();
+    scene.onUpdate(11);
+    EXPECT(!scene.getObject(handle));
+    EXPECT(scene.isRenderOrderValid());
+    return 0;
+}
+
+// 0 if it can't be measured.
+static size_t heapInUse()
+{
+#ifdef HAVE_MALLINFO2
+    return mallinfo2().uordblks;
+#else
+    return 0;
+#endif
+}
+
+TESTCASE(objectFootprint)
+{
+    HeadlessScene scene;
+    const size_t count = 100000;
+    std::vector<EGE::SharedPtr<EGE::DummyObject2D>> objects;
+    objects.reserve(count);
+
+    size_t heapBefore = heapInUse();
+    auto start = EGE::System::exactTime();
+    for(size_t s = 0; s < count; s++)
+        objects.push_back(make<EGE::DummyObject2D>(scene));
+    auto end = EGE::System::exactTime();
+    size_t heapAfter = heapInUse();
+
+    double seconds = (end.s - start.s) + (end.ns - start.ns) / 1000000000.0;
+    std::cerr << "sizeof(SceneObject) = " << sizeof(EGE::SceneObject) << ", sizeof(EventLoop) = " << sizeof(EGE::EventLoop) << std::endl;
+    std::cerr << "heap per DummyObject2D: " << (heapAfter - heapBefore) / count << " B, "
+              << (size_t)(count / seconds) << " objects/s" << std::endl;
+
+    // Budget with some headroom (now ~800 B and ~900 B on 64-bit glibc), so
+    // that object doesn't grow unnoticed.
+    EXPECT(sizeof(EGE::SceneObject) <= 1024);
+    if(heapBefore > 0)
+        EXPECT((heapAfter - heapBefore) / count <= 1280);
+    objects.clear();
+    return 0;
+}
+
+// Moves in a box, sometimes dies and spawns a successor.
+class BouncingObject : public EGE::DummyObject2D
+{
+public:
+    EGE_SCENEOBJECT("BouncingObject");
+
+    BouncingObject(EGE::Scene& owner)
+    : EGE::DummyObject2D(owner) {}
+
+    virtual bool allowParallelUpdate() const override { return true; }
+
+    virtual void onUpdate(long long tickCounter) override
+    {
+        if(tickCounter == 0)
+            setMotion({(double)(getObjectId() % 7), (double)(getObjectId() % 5)});
+
+        EGE::DummyObject2D::onUpdate(tickCounter);
+
+        auto position = getPosition();
+        auto motion = getMotion();
+        if(position.x < -1000 || position.x > 0)
+            motion.x = -motion.x;
+        if(position.y < -1000 || position.y > 0)
+            motion.y = -motion.y;
+        setMotion(motion);
+
+        if(!isDead() && (getObjectId() + tickCounter) % 1000 == 0)
+        {
+            setDead();
+            auto successor = make<BouncingObject>(getOwner());
+            successor->setType(getType());
+            getOwner().addObject(successor);
+        }
+    }
+};
+
+// More threads than cores, so that objects are really updated concurrently
+// also on small machines.
+static EGE::Vec3d runBouncingScene(bool parallel)
+{
+    HeadlessScene scene;
+    scene.getRegistry().addType<BouncingObject>();
+    scene.spawn<BouncingObject>(50000, false);
+    scene.setParallelUpdate(parallel, 4);
+
+    auto start = EGE::System::exactTime();
+    for(int s = 0; s < 50; s++)
+        scene.onUpdate(s);
+    auto end = EGE::System::exactTime();
+    std::cerr << (parallel ? "parallel" : "serial") << ": 50 ticks of 50k objects took "
+              << (end.s - start.s) * 1000.0 + (end.ns - start.ns) / 1000000.0 << " ms" << std::endl;
+
+    EGE::Vec3d sum;
+    for(auto& pr: scene)
+        sum += pr.second->getPosition();
+    EXPECT_EQUAL(std::distance(scene.begin(), scene.end()), 50000);
+    EXPECT(scene.isRenderOrderValid());
+
+    // Successors created by workers are attached to inspector on commit.
+    bool attached = true;
+    for(auto& pr: scene)
+        attached &= (pr.second->isnParent() == &scene);
+    EXPECT(attached);
+    return sum;
+}
+
+TESTCASE(parallelUpdate50k)
+{
+    // Parallel update must give the same result, only faster.
+    EXPECT(runBouncingScene(false) == runBouncingScene(true));
+
+    // Subclasses may serialize more, so they don't inherit compact updates.
+    HeadlessScene scene;
+    EXPECT(make<EGE::DummyObject2D>(scene)->allowCompactUpdates());
+    EXPECT(!make<BouncingObject>(scene)->allowCompactUpdates());
+    return 0;
+}
+
+// Point object that counts how many times its bounding box was computed.
+class CountingObject : public EGE::SceneObject
+{
+public:
+    EGE_SCENEOBJECT("CountingObject");
+
+    CountingObject(EGE::Scene& owner)
+    : EGE::SceneObject(owner) {}
+
+    virtual EGE::RectD getBoundingBox() const override { boxCount++; return EGE::SceneObject::getBoundingBox(); }
+    virtual void render(EGE::Renderer&) const override {}
+
+    mutable int boxCount = 0;
+};
+
+TESTCASE(spatialQueries)
+{
+    HeadlessScene scene;
+    scene.spawn(20000, false);
+
+    // Scatter objects, some of them bigger than a cell.
+    EGE::Random random(1234);
+    for(auto& pr: scene)
+    {
+        auto object = EGE::SceneObject::cast<EGE::DummyObject2D>(pr.second);
+        object->setPosition({random.nextFloatRanged(-5000, 5000), random.nextFloatRanged(-5000, 5000)});
+        object->setSize({random.nextFloatRanged(0, 300), random.nextFloatRanged(0, 300)});
+    }
+
+    auto bruteForce = [&scene](EGE::RectD rect) {
+        std::set<EGE::SceneObject*> objects;
+        for(auto& pr: scene)
+        {
+            auto box = pr.second->getBoundingBox();
+            if(box.position.x <= rect.position.x + rect.size.x && rect.position.x <= box.position.x + box.size.x
+            && box.position.y <= rect.position.y + rect.size.y && rect.position.y <= box.position.y + box.size.y)
+                objects.insert(pr.second.get());
+        }
+        return objects;
+    };
+
+    for(int s = 0; s < 100; s++)
+    {
+        EGE::RectD rect({random.nextFloatRanged(-6000, 5000), random.nextFloatRanged(-6000, 5000)},
+                        {random.nextFloatRanged(0, 1000), random.nextFloatRanged(0, 1000)});
+        auto found = scene.getObjectsInRect(rect);
+        std::set<EGE::SceneObject*> foundSet(found.begin(), found.end());
+        EXPECT_EQUAL(found.size(), foundSet.size());
+        EXPECT(foundSet == bruteForce(rect));
+    }
+
+    // Radius query returns subset of bounding rect query.
+    auto inRadius = scene.getObjectsInRadius({0, 0}, 500);
+    auto inRect = bruteForce(EGE::RectD({-500, -500}, {1000, 1000}));
+    EXPECT(!inRadius.empty());
+    for(auto object: inRadius)
+        EXPECT(inRect.count(object));
+
+    // Objects that moved are found at new position only.
+    auto object = scene.begin()->second;
+    object->setPosition({100000, 100000});
+    auto found = scene.getObjectsInRect(EGE::RectD({99990, 99990}, {20, 20}));
+    EXPECT(found.size() == 1 && found[0] == object.get());
+
+    // Children follow parent moves and rotations.
+    auto child = std::next(scene.begin())->second;
+    child->setPosition({10, 0});
+    child->setParent(object.get());
+    auto isAt = [&scene, &child](EGE::Vec2d position) {
+        auto found = scene.getObjectsInRect(EGE::RectD(position - EGE::Vec2d(1, 1), {2, 2}));
+        return std::count(found.begin(), found.end(), child.get()) == 1;
+    };
+    EXPECT(isAt({100010, 100000}));
+    object->setYaw(180);
+    EXPECT(isAt({99990, 100000}));
+    object->setPosition({-100000, -100000});
+    EXPECT(isAt({-100010, -100000}));
+
+    // Object is reindexed once, however many times it moved, and at its
+    // world position.
+    scene.getRegistry().addType<CountingObject>();
+    auto counting = scene.addNewObject<CountingObject>();
+    counting->setParent(object.get());
+    counting->boxCount = 0;
+    for(int s = 1; s <= 100; s++)
+        counting->setPosition({(double)s, 0});
+    object->setPosition({0, 0});
+    EXPECT_EQUAL(counting->boxCount, 0);
+    scene.onUpdate(0);
+    EXPECT_EQUAL(counting->boxCount, 1);
+    found = scene.getObjectsInRect(EGE::RectD({-100.5, -0.5}, {1, 1}));
+    EXPECT(std::count(found.begin(), found.end(), counting.get()) == 1);
+    return 0;
+}
+
+TESTCASE(worldTransformCache)
+{
+    HeadlessScene scene;
+    scene.spawn(50, false);
+
+    // Each object is 1 unit right of its parent. Without cached transforms,
+    // the leaf of this chain would cost 2^50 getPosition() calls.
+    EGE::SceneObject* parent = nullptr;
+    EGE::SceneObject* leaf = nullptr;
+    for(auto& pr: scene)
+    {
+        auto object = pr.second.get();
+        object->setPosition({parent ? 1.0 : 0.0, 0});
+        object->setParent(parent);
+        parent = leaf = object;
+    }
+    EXPECT(leaf->getPosition().x == 49 && leaf->getPosition().y == 0);
+
+    // Moving root moves the whole chain.
+    auto root = scene.begin()->second;
+    root->setPosition({100, 50});
+    EXPECT(leaf->getPosition().x == 149 && leaf->getPosition().y == 50);
+    root->setMotion({2, 0});
+    EXPECT(leaf->getMotion().x == 2);
+
+    // Rotating root by 180 degrees mirrors the chain around it.
+    root->setYaw(180);
+    EXPECT(std::abs(leaf->getPosition().x - 51) < 1e-6 && std::abs(leaf->getPosition().y - 50) < 1e-6);
+    EXPECT(leaf->getYaw() == 180);
+
+    // Locked rotation doesn't inherit.
+    leaf->setYawRotationMode(EGE::SceneObject::RotationMode::Lock);
+    EXPECT(leaf->getYaw() == 0);
+    return 0;
+}
+
+TESTCASE(changedObjectList)
+{
+    HeadlessScene scene;
+    scene.spawn(100, false);
+
+    // New objects are always changed.
+    auto changed = scene.takeChangedObjects();
+    EXPECT_EQUAL(changed.size(), 100u);
+    for(auto object: changed)
+    {
+        object->clearMainChangedFlag();
+        object->clearExtendedChangedFlag();
+    }
+    EXPECT(scene.takeChangedObjects().empty());
+
+    // Object is listed once, however many times it changed.
+    auto object = scene.getObject(-1);
+    auto parent = scene.getObject(-2);
+    object->setParent(parent.get());
+    object->setParent(nullptr);
+    changed = scene.takeChangedObjects();
+    EXPECT_EQUAL(changed.size(), 1u);
+    EXPECT(changed[0] == object.get());
+    EXPECT(object->getMainChangedFlag());
+
+    // Dead objects are removed from list.
+    parent->setParent(object.get());
+    parent->setDead();
+    scene.onUpdate(0);
+    EXPECT(scene.takeChangedObjects().empty());
+    return 0;
+}
+
+TESTCASE(tilemapChunkMeshCache)
+{
+    struct Tile { int id = 0; };
+    typedef EGE::FixedTileMap2D<Tile, 64, 64> TileMap;
+
+    HeadlessScene scene;
+    scene.spawn(1, false);
+    auto tileMap = make<TileMap>();
+    tileMap->setTileSize({16, 16});
+    tileMap->initialize();
+
+    EGE::TilemapRenderer2D<TileMap> renderer(*scene.begin()->second, tileMap);
+    renderer.setLayerCount(2);
+    EGE::Size mapperCalls = 0;
+    renderer.setTileAtlasMapper([&](const Tile& tile, EGE::Vector2<EGE::MaxInt>, EGE::Size, EGE::TilemapRenderer2D<TileMap>::AtlasInfo& info) {
+        mapperCalls++;
+        info.texCoords = {tile.id * 16, 0};
+    });
+
+    // Geometry is built once per layer and then reused.
+    for(int s = 0; s < 1000; s++)
+    {
+        EXPECT(renderer.getChunkMesh({0, 0}, 0));
+        EXPECT(renderer.getChunkMesh({0, 0}, 1));
+    }
+    EXPECT_EQUAL(mapperCalls, 64 * 64 * 2);
+    EXPECT(!renderer.getChunkMesh({1, 0}, 0));
+
+    // Modifying tiles rebuilds only after marking chunk dirty.
+    tileMap->ensureTile({1, 0}).id = 3;
+    EXPECT_EQUAL((*renderer.getChunkMesh({0, 0}, 0))[64 * 4].texCoords.x, 0);
+    tileMap->markDirty();
+    EXPECT_EQUAL((*renderer.getChunkMesh({0, 0}, 0))[64 * 4].texCoords.x, 48);
+    EXPECT_EQUAL((*renderer.getChunkMesh({0, 0}, 0))[64 * 4].position.x, 16);
+    EXPECT_EQUAL(mapperCalls, 64 * 64 * 3);
+    return 0;
+}
+
+TESTCASE(tilemapAsyncChunks)
+{
+    struct Tile { int id = 0; };
+    typedef EGE::ChunkedTileMap2D<Tile, 16, 16> TileMap;
+
+    HeadlessScene scene;
+    scene.spawn(1, false);
+    auto tileMap = make<TileMap>();
+    tileMap->setTileSize({16, 16});
+    tileMap->setAsyncGeneration(2);
+
+    EGE::TilemapRenderer2D<TileMap> renderer(*scene.begin()->second, tileMap);
+    renderer.setUseEnsure();
+    renderer.setTileAtlasMapper([](const Tile&, EGE::Vector2<EGE::MaxInt>, EGE::Size, EGE::TilemapRenderer2D<TileMap>::AtlasInfo&) {});
+
+    // Chunks that are not generated yet are skipped.
+    EXPECT(!renderer.getChunkMesh({-1, 2}, 0));
+    while(tileMap->getPendingGenerationCount() > 0)
+        tileMap->update();
+    EXPECT(renderer.getChunkMesh({-1, 2}, 0));
+    return 0;
+}
+
+TESTCASE(batchedParticles200k)
+{
+    HeadlessScene scene;
+    auto particles = scene.addNewObject<EGE::BatchedParticleSystem2D>();
+    particles->setSpawnRect(EGE::RectD(0, 0, 1000, 10));
+    particles->setSpawnChance(3400);
+    particles->setParticleLifeTime(60);
+    particles->setParticleMotion({-1, 0}, {1, 2});
+    particles->setMaxParticles(250000);
+    particles->setRandomSeed(1234);
+    particles->addParticleUpdater(EGE::BatchedParticleSystem2D::acceleration({0, 0.1}));
+    particles->addParticleUpdater(EGE::BatchedParticleSystem2D::fadeOut(30));
+
+    // Warm up to full population.
+    for(int s = 0; s < 60; s++)
+        scene.onUpdate(s);
+    EXPECT_EQUAL(particles->getParticleCount(), 3400 * 60);
+
+    auto start = EGE::System::exactTime();
+    for(int s = 60; s < 180; s++)
+        scene.onUpdate(s);
+    auto end = EGE::System::exactTime();
+    std::cerr << particles->getParticleCount() << " particles: "
+              << ((end.s - start.s) * 1000.0 + (end.ns - start.ns) / 1000000.0) / 120 << " ms per tick" << std::endl;
+
+    // Oldest particles are first, they have the least TTL and are faded.
+    auto& data = particles->getParticles();
+    EXPECT(data.ttl.front() == 1 && data.ttl.back() == 60);
+    EXPECT(data.color.front().a < 10 && data.color.back().a == 255);
+
+    particles->setMaxParticles(100);
+    particles->spawnParticles(10);
+    EXPECT_EQUAL(particles->getParticleCount(), 3400 * 60);
+
+    // Particles spawned with TTL 0 die, instead of wrapping TTL around.
+    auto killer = scene.addNewObject<EGE::BatchedParticleSystem2D>();
+    killer->setParticleOnSpawn([](EGE::BatchedParticleSystem2D::Particles& particles, EGE::Size begin, EGE::Size end) {
+        for(EGE::Size s = begin; s < end; s++)
+            particles.ttl[s] = 0;
+    });
+    killer->spawnParticles(100);
+    EXPECT_EQUAL(killer->getParticleCount(), 100u);
+    scene.onUpdate(180);
+    // The only one is spawned in this tick.
+    EXPECT_EQUAL(killer->getParticleCount(), 1u);
+    return 0;
+}
+
 RUN_TESTS(scene);
@@ -38,7 +38,10 @@
 
 #include <ege/tilemap/ChunkedTileMap2D.cpp>
 #include <ege/tilemap/ChunkedTileMap2D.h>
+#include <ege/tilemap/ChunkStreamer.h>
+#include <ege/tilemap/ChunkWorkerPool.h>
 #include <ege/tilemap/FixedChunk.h>
 #include <ege/tilemap/FixedTileMap2D.h>
+#include <ege/tilemap/RegionFile.h>
 #include <ege/tilemap/TileMap2D.h>
 
@@ -0,0 +1,401 @@
+/*
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*      ,----  ,----  ,----
+*      |      |      |
+*      |----  | --,  |----
+*      |      |   |  |
+*      '----  '---'  '----
+*
+*     Framework Library for Hexagon
+*
+*    Copyright (c) Sppmacd 2020 - 2021
+*
+*    Permission is hereby granted, free of charge, to any person obtaining a copy
+*    of this software and associated documentation files (the "Software"), to deal
+*    in the Software without restriction, including without limitation the rights
+*    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*    copies of the Software, and to permit persons to whom the Software is
+*    furnished to do so, subject to the following conditions:
+*
+*    The above copyright notice and this permission notice shall be included in all
+*    copies or substantial portions of the Software.
+*
+*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*    SOFTWARE.
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*/
+
+#pragma once
+
+#include "ChunkWorkerPool.h"
+#include "RegionFile.h"
+#include "TileMap2D.h"
+
+#include <ege/debug/Logger.h>
+#include <ege/util/PointerUtils.h>
+#include <ege/util/Types.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace EGE
+{
+
+// Keeps only part of ChunkedTileMap2D in memory. Chunks around viewers are
+// kept loaded (and loaded in background if they were saved before). When
+// the tilemap exceeds memory budget, least recently used chunks that are
+// not near any viewer are saved to region files and removed from tilemap.
+//
+// Everything except disk I/O happens in thread calling update(), which
+// should be called once per tick.
+template<class TMap>
+class ChunkStreamer
+{
+public:
+    typedef typename TMap::ChunkType ChunkType;
+    typedef typename TMap::TileType TileType;
+
+    // Serialized chunk format must not depend on chunk position.
+    typedef std::function<void(const ChunkType&, Vector<Uint8>&)> Serializer;
+    typedef std::function<bool(const Vector<Uint8>&, ChunkType&)> Deserializer;
+
+    ChunkStreamer(TMap& tileMap, std::string directory)
+    : m_tileMap(tileMap), m_storage(directory)
+    {
+        setDefaultSerializer(std::is_trivially_copyable<TileType>());
+        m_tileMap.setLoader([this](Vec2i chunkCoords, ChunkType& chunk) { return loadChunkNow(chunkCoords, chunk); });
+        m_tileMap.setAsyncLoader([this](Vec2i chunkCoords) { requestChunk(chunkCoords); });
+    }
+
+    // Waits for pending writes. Doesn't save chunks that are still in memory,
+    // call saveAll() for that.
+    ~ChunkStreamer()
+    {
+        m_tileMap.setLoader(nullptr);
+        m_tileMap.setAsyncLoader(nullptr);
+        m_ioWorker.waitForIdle();
+    }
+
+    ChunkStreamer(const ChunkStreamer&) = delete;
+    ChunkStreamer& operator=(const ChunkStreamer&) = delete;
+
+    // Must be set if TileType is not trivially copyable.
+    void setSerializer(Serializer serializer, Deserializer deserializer)
+    {
+        m_serializer = serializer;
+        m_deserializer = deserializer;
+    }
+
+    // In bytes of chunk data. 0 means no limit. Chunks near viewers are never
+    // evicted, so the budget may be exceeded if viewers see too much.
+    void setMemoryBudget(Size bytes) { m_memoryBudget = bytes; }
+    Size getMemoryBudget() const { return m_memoryBudget; }
+    Size getMemoryUsage() const { return m_tileMap.size() * sizeof(ChunkType); }
+
+    // Chunks in square of (2 * %radius + 1) chunks around %chunkCoords are
+    // kept loaded as long as the viewer exists.
+    void setViewer(UidType id, Vec2i chunkCoords, int radius) { m_viewers[id] = {chunkCoords, radius}; }
+    void removeViewer(UidType id) { m_viewers.erase(id); }
+
+    // Returns chunk if it's loaded. Otherwise, starts loading it in background
+    // (or generates it if it was never saved) and returns nullptr.
+    const ChunkType* requestChunk(Vec2i chunkCoords)
+    {
+        const ChunkType* chunk = m_tileMap.getChunk(chunkCoords);
+        if(chunk)
+        {
+            touch(chunkCoords);
+            return chunk;
+        }
+        if(m_pendingLoads.count(chunkCoords))
+            return nullptr;
+
+        m_pendingLoads.insert(chunkCoords);
+        m_ioWorker.post([this, chunkCoords]() {
+            auto blob = make<Vector<Uint8>>();
+            if(!readBlob(chunkCoords, *blob))
+                blob = nullptr;
+            return [this, chunkCoords, blob]() { finishLoad(chunkCoords, blob); };
+        });
+        return nullptr;
+    }
+
+    // Installs chunks loaded in background, keeps chunks near viewers
+    // loaded and evicts chunks if memory budget is exceeded.
+    void update()
+    {
+        m_tick++;
+        m_ioWorker.processCompletions();
+
+        for(auto& pr: m_viewers)
+        {
+            const Viewer& viewer = pr.second;
+            for(int x = viewer.center.x - viewer.radius; x <= viewer.center.x + viewer.radius; x++)
+            for(int y = viewer.center.y - viewer.radius; y <= viewer.center.y + viewer.radius; y++)
+                requestChunk(Vec2i(x, y));
+        }
+
+        evictChunks();
+    }
+
+    // Saves all modified chunks and waits until they are written.
+    void saveAll()
+    {
+        for(auto& pr: m_tileMap)
+        {
+            ChunkState& state = m_states[pr.first];
+            if(state.saved && state.savedRevision == pr.second->getRevision())
+                continue;
+            queueWrite(pr.first, *pr.second);
+            state.saved = true;
+            state.savedRevision = pr.second->getRevision();
+        }
+        m_ioWorker.waitForIdle();
+    }
+
+    // Blocks until all pending loads and writes are finished, then installs
+    // loaded chunks.
+    void flush()
+    {
+        m_ioWorker.waitForIdle();
+        m_ioWorker.processCompletions();
+    }
+
+    Size getPendingLoadCount() const { return m_pendingLoads.size(); }
+    Size getEvictedChunkCount() const { return m_evictedChunkCount; }
+
+    // Chunks that were ensured (e.g by setting a tile) before they were
+    // loaded in background. Use requestChunk() or viewers to avoid them.
+    Size getLoadStallCount() const { return m_loadStallCount; }
+
+private:
+    // In milliseconds.
+    static constexpr double SlowLoadWarningTime = 2;
+
+    struct Viewer
+    {
+        Vec2i center;
+        int radius = 0;
+    };
+
+    struct ChunkState
+    {
+        Size lastUsedTick = 0;
+        Size savedRevision = 0;
+        bool saved = false;
+    };
+
+    // Blob format: Uint32 chunk size x, chunk size y, tile size; then raw tiles.
+    void setDefaultSerializer(std::true_type)
+    {
+        m_serializer = [](const ChunkType& chunk, Vector<Uint8>& blob) {
+            const Size tileCount = ChunkType::SizeX * ChunkType::SizeY;
+            Uint32 header[3] = {(Uint32)ChunkType::SizeX, (Uint32)ChunkType::SizeY, (Uint32)sizeof(TileType)};
+            blob.resize(sizeof(header) + tileCount * sizeof(TileType));
+            memcpy(blob.data(), header, sizeof(header));
+            Uint8* data = blob.data() + sizeof(header);
+            for(Size x = 0; x < ChunkType::SizeX; x++)
+            for(Size y = 0; y < ChunkType::SizeY; y++)
+            {
+                memcpy(data, &chunk.getTile(Vec2s(x, y)), sizeof(TileType));
+                data += sizeof(TileType);
+            }
+        };
+        m_deserializer = [](const Vector<Uint8>& blob, ChunkType& chunk) {
+            const Size tileCount = ChunkType::SizeX * ChunkType::SizeY;
+            Uint32 header[3];
+            if(blob.size() != sizeof(header) + tileCount * sizeof(TileType))
+                return false;
+            memcpy(header, blob.data(), sizeof(header));
+            if(header[0] != ChunkType::SizeX || header[1] != ChunkType::SizeY || header[2] != sizeof(TileType))
+                return false;
+            const Uint8* data = blob.data() + sizeof(header);
+            for(Size x = 0; x < ChunkType::SizeX; x++)
+            for(Size y = 0; y < ChunkType::SizeY; y++)
+            {
+                memcpy(&chunk.getTile(Vec2s(x, y)), data, sizeof(TileType));
+                data += sizeof(TileType);
+            }
+            return true;
+        };
+    }
+
+    void setDefaultSerializer(std::false_type) {}
+
+    void touch(Vec2i chunkCoords) { m_states[chunkCoords].lastUsedTick = m_tick; }
+
+    bool isNearViewer(Vec2i chunkCoords) const
+    {
+        for(auto& pr: m_viewers)
+        {
+            const Viewer& viewer = pr.second;
+            if(std::abs(chunkCoords.x - viewer.center.x) <= viewer.radius && std::abs(chunkCoords.y - viewer.center.y) <= viewer.radius)
+                return true;
+        }
+        return false;
+    }
+
+    // Can be called from any thread. Chunks that are waiting for write are
+    // taken from memory, so that they are never read in outdated state.
+    bool readBlob(Vec2i chunkCoords, Vector<Uint8>& blob)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_writeMutex);
+            auto it = m_pendingWrites.find(chunkCoords);
+            if(it != m_pendingWrites.end())
+            {
+                blob = *it->second;
+                return true;
+            }
+        }
+        return m_storage.read(chunkCoords, blob);
+    }
+
+    bool deserialize(Vec2i chunkCoords, const Vector<Uint8>& blob, ChunkType& chunk)
+    {
+        ASSERT_WITH_MESSAGE(m_deserializer, "ChunkStreamer needs a deserializer for non-trivial tiles");
+        if(!m_deserializer(blob, chunk))
+        {
+            ege_log.error() << "ChunkStreamer: Chunk (" << chunkCoords.x << ", " << chunkCoords.y << ") is corrupted, it will be regenerated";
+            return false;
+        }
+        ChunkState& state = m_states[chunkCoords];
+        state.lastUsedTick = m_tick;
+        state.saved = true;
+        state.savedRevision = chunk.getRevision();
+        return true;
+    }
+
+    // Tilemap loader, used when chunk is ensured before background load
+    // finished. Blocks tick thread on disk (and on writes in progress),
+    // so it's counted and slow loads are logged.
+    bool loadChunkNow(Vec2i chunkCoords, ChunkType& chunk)
+    {
+        m_loadStallCount++;
+        auto start = std::chrono::steady_clock::now();
+        Vector<Uint8> blob;
+        bool found = readBlob(chunkCoords, blob);
+        double time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if(time > SlowLoadWarningTime)
+            ege_log.warning() << "ChunkStreamer: Chunk (" << chunkCoords.x << ", " << chunkCoords.y << ") was ensured before it was loaded, tick was blocked for " << time << " ms";
+        if(!found)
+            return false;
+        return deserialize(chunkCoords, blob, chunk);
+    }
+
+    void finishLoad(Vec2i chunkCoords, SharedPtr<Vector<Uint8>> blob)
+    {
+        m_pendingLoads.erase(chunkCoords);
+
+        // Someone ensured the chunk in the meantime.
+        if(m_tileMap.getChunk(chunkCoords))
+            return;
+
+        if(blob)
+        {
+            auto chunk = std::make_unique<ChunkType>();
+            if(deserialize(chunkCoords, *blob, *chunk))
+            {
+                m_tileMap.insertChunk(chunkCoords, std::move(chunk));
+                return;
+            }
+        }
+
+        // Never saved, generate it (in background if tilemap supports it).
+        m_tileMap.requestGeneration(chunkCoords);
+        touch(chunkCoords);
+    }
+
+    void queueWrite(Vec2i chunkCoords, const ChunkType& chunk)
+    {
+        ASSERT_WITH_MESSAGE(m_serializer, "ChunkStreamer needs a serializer for non-trivial tiles");
+        auto blob = make<Vector<Uint8>>();
+        m_serializer(chunk, *blob);
+        {
+            std::lock_guard<std::mutex> lock(m_writeMutex);
+            m_pendingWrites[chunkCoords] = blob;
+        }
+        m_ioWorker.post([this, chunkCoords, blob]() {
+            m_storage.write(chunkCoords, *blob);
+            std::lock_guard<std::mutex> lock(m_writeMutex);
+            auto it = m_pendingWrites.find(chunkCoords);
+            if(it != m_pendingWrites.end() && it->second == blob)
+                m_pendingWrites.erase(it);
+            return ChunkWorkerPool::Completion();
+        });
+    }
+
+    void evictChunks()
+    {
+        if(m_memoryBudget == 0)
+            return;
+
+        Size maxChunks = std::max<Size>(1, m_memoryBudget / sizeof(ChunkType));
+        if(m_tileMap.size() <= maxChunks)
+            return;
+
+        Vector<std::pair<Size, Vec2i>> candidates;
+        for(auto& pr: m_tileMap)
+        {
+            if(isNearViewer(pr.first))
+                continue;
+            auto it = m_states.find(pr.first);
+            candidates.push_back({it != m_states.end() ? it->second.lastUsedTick : 0, pr.first});
+        }
+
+        Size count = std::min(candidates.size(), m_tileMap.size() - maxChunks);
+        auto compare = [](const std::pair<Size, Vec2i>& _1, const std::pair<Size, Vec2i>& _2) { return _1.first < _2.first; };
+        std::nth_element(candidates.begin(), candidates.begin() + count, candidates.end(), compare);
+        for(Size s = 0; s < count; s++)
+            evictChunk(candidates[s].second);
+    }
+
+    void evictChunk(Vec2i chunkCoords)
+    {
+        auto chunk = m_tileMap.removeChunk(chunkCoords);
+        ASSERT(chunk);
+        auto it = m_states.find(chunkCoords);
+        if(it == m_states.end() || !it->second.saved || it->second.savedRevision != chunk->getRevision())
+            queueWrite(chunkCoords, *chunk);
+        if(it != m_states.end())
+            m_states.erase(it);
+        m_evictedChunkCount++;
+    }
+
+    TMap& m_tileMap;
+    RegionStorage m_storage;
+    Serializer m_serializer;
+    Deserializer m_deserializer;
+
+    Size m_memoryBudget = 0;
+    Size m_tick = 0;
+    Size m_evictedChunkCount = 0;
+    Size m_loadStallCount = 0;
+    Map<UidType, Viewer> m_viewers;
+    std::unordered_map<Vec2i, ChunkState, ChunkCoordsHash, ChunkCoordsEqual> m_states;
+    std::unordered_set<Vec2i, ChunkCoordsHash, ChunkCoordsEqual> m_pendingLoads;
+
+    std::mutex m_writeMutex;
+    std::unordered_map<Vec2i, SharedPtr<Vector<Uint8>>, ChunkCoordsHash, ChunkCoordsEqual> m_pendingWrites;
+
+    // Last, so that it's destroyed before anything its jobs use. Jobs run
+    // one at a time, so that writes of the same chunk stay in order. Loads
+    // are waited for by viewers, so they go before generation.
+    ChunkWorkerPool m_ioWorker {1, TaskPriority::High};
+};
+
+}
@@ -0,0 +1,129 @@
+/*
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*      ,----  ,----  ,----
+*      |      |      |
+*      |----  | --,  |----
+*      |      |   |  |
+*      '----  '---'  '----
+*
+*     Framework Library for Hexagon
+*
+*    Copyright (c) Sppmacd 2020 - 2021
+*
+*    Permission is hereby granted, free of charge, to any person obtaining a copy
+*    of this software and associated documentation files (the "Software"), to deal
+*    in the Software without restriction, including without limitation the rights
+*    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*    copies of the Software, and to permit persons to whom the Software is
+*    furnished to do so, subject to the following conditions:
+*
+*    The above copyright notice and this permission notice shall be included in all
+*    copies or substantial portions of the Software.
+*
+*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*    SOFTWARE.
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*/
+
+#include "ChunkWorkerPool.h"
+
+#include <ege/debug/Logger.h>
+#include <ege/main/Config.h>
+
+namespace EGE
+{
+
+ChunkWorkerPool::ChunkWorkerPool(Size maxConcurrency, TaskPriority priority)
+: m_state(make<State>())
+{
+    ASSERT(maxConcurrency > 0);
+    m_state->maxConcurrency = maxConcurrency;
+    m_state->priority = priority;
+}
+
+ChunkWorkerPool::~ChunkWorkerPool()
+{
+    m_state->token.cancel();
+    std::unique_lock<std::mutex> lock(m_state->mutex);
+    m_state->jobs.clear();
+    m_state->idleCondition.wait(lock, [this]() { return m_state->runningJobs == 0; });
+}
+
+void ChunkWorkerPool::post(Job job)
+{
+    std::lock_guard<std::mutex> lock(m_state->mutex);
+    m_state->jobs.push_back(std::move(job));
+    if(m_state->executorTasks + m_state->runningJobs < m_state->maxConcurrency)
+        submitJobLocked(m_state);
+}
+
+Size ChunkWorkerPool::processCompletions()
+{
+    Vector<Completion> completions;
+    {
+        std::lock_guard<std::mutex> lock(m_state->mutex);
+        completions.swap(m_state->completions);
+    }
+    for(auto& completion: completions)
+        completion();
+    return completions.size();
+}
+
+void ChunkWorkerPool::waitForIdle()
+{
+    std::unique_lock<std::mutex> lock(m_state->mutex);
+    m_state->idleCondition.wait(lock, [this]() { return m_state->jobs.empty() && m_state->runningJobs == 0; });
+}
+
+Size ChunkWorkerPool::getPendingJobCount() const
+{
+    std::lock_guard<std::mutex> lock(m_state->mutex);
+    return m_state->jobs.size() + m_state->runningJobs;
+}
+
+void ChunkWorkerPool::submitJobLocked(SharedPtr<State> state)
+{
+    state->executorTasks++;
+    TaskExecutor::instance().submit([state]() { runJob(state); }, state->priority);
+}
+
+void ChunkWorkerPool::runJob(const SharedPtr<State>& state)
+{
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->executorTasks--;
+    if(state->token.isCanceled() || state->jobs.empty())
+        return;
+
+    Job job = std::move(state->jobs.front());
+    state->jobs.pop_front();
+    state->runningJobs++;
+    lock.unlock();
+
+    Completion completion = job();
+
+    lock.lock();
+    if(completion)
+        state->completions.push_back(std::move(completion));
+    state->runningJobs--;
+
+    // Executor thread is released after every job, so that tasks with
+    // higher priority can run in the meantime.
+    if(!state->jobs.empty() && !state->token.isCanceled())
+    {
+        if(state->executorTasks + state->runningJobs < state->maxConcurrency)
+            submitJobLocked(state);
+    }
+    else if(state->runningJobs == 0)
+        state->idleCondition.notify_all();
+}
+
+}
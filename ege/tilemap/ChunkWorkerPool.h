@@ -0,0 +1,114 @@
+/*
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*      ,----  ,----  ,----
+*      |      |      |
+*      |----  | --,  |----
+*      |      |   |  |
+*      '----  '---'  '----
+*
+*     Framework Library for Hexagon
+*
+*    Copyright (c) Sppmacd 2020 - 2021
+*
+*    Permission is hereby granted, free of charge, to any person obtaining a copy
+*    of this software and associated documentation files (the "Software"), to deal
+*    in the Software without restriction, including without limitation the rights
+*    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*    copies of the Software, and to permit persons to whom the Software is
+*    furnished to do so, subject to the following conditions:
+*
+*    The above copyright notice and this permission notice shall be included in all
+*    copies or substantial portions of the Software.
+*
+*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*    SOFTWARE.
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*/
+
+#pragma once
+
+#include <ege/asyncLoop/CancellationToken.h>
+#include <ege/asyncLoop/TaskExecutor.h>
+#include <ege/util/PointerUtils.h>
+#include <ege/util/Types.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+namespace EGE
+{
+
+// Chunk I/O and generation jobs, run on shared TaskExecutor. Jobs return a
+// completion handler, which is run later by the owner thread in
+// processCompletions() (usually at the start of tick), so that only the
+// owner thread touches the tilemap.
+class ChunkWorkerPool
+{
+public:
+    typedef std::function<void()> Completion;
+    typedef std::function<Completion()> Job;
+
+    // At most %maxConcurrency jobs run at once, so 1 keeps them in order.
+    // Jobs are submitted to executor with %priority.
+    explicit ChunkWorkerPool(Size maxConcurrency = 1, TaskPriority priority = TaskPriority::Normal);
+
+    // Jobs that didn't start yet are canceled, running ones are waited for.
+    // Call waitForIdle() before if they must be finished.
+    ~ChunkWorkerPool();
+
+    ChunkWorkerPool(const ChunkWorkerPool&) = delete;
+    ChunkWorkerPool& operator=(const ChunkWorkerPool&) = delete;
+
+    // Jobs are started in order they were posted. Returned completion may
+    // be empty if there is nothing to do in owner thread.
+    void post(Job job);
+
+    // Runs completion handlers of finished jobs. Returns how many were run.
+    Size processCompletions();
+
+    // Blocks until all posted jobs are finished (but doesn't run completions).
+    // Must not be called from executor thread.
+    void waitForIdle();
+
+    // Jobs queued or running.
+    Size getPendingJobCount() const;
+    Size getMaxConcurrency() const { return m_state->maxConcurrency; }
+
+private:
+    // Executor tasks may outlive the pool if they were canceled before
+    // they started, so they hold the state and not the pool.
+    struct State
+    {
+        Size maxConcurrency;
+        TaskPriority priority;
+        CancellationToken token;
+
+        mutable std::mutex mutex;
+        std::condition_variable idleCondition;
+        std::deque<Job> jobs;
+        Vector<Completion> completions;
+        Size runningJobs = 0;
+
+        // Submitted to executor, but not started yet. Together with running
+        // jobs, there is at most maxConcurrency of them.
+        Size executorTasks = 0;
+    };
+
+    static void submitJobLocked(SharedPtr<State> state);
+    static void runJob(const SharedPtr<State>& state);
+
+    SharedPtr<State> m_state;
+};
+
+}
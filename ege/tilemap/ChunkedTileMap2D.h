@@ -36,12 +36,16 @@
 
 #pragma once
 
+#include "ChunkWorkerPool.h"
 #include "FixedChunk.h"
 #include "TileMap2D.h"
 
 #include <ege/debug/Logger.h>
+#include <ege/util/PointerUtils.h>
 #include <ege/util/Vector.h>
 #include <functional>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace EGE
 {
@@ -69,16 +73,20 @@ public:
 
     const ChunkType* getChunk(Vec2i chunkCoords) const
     {
+        if(m_lastChunk && m_lastChunkCoords.x == chunkCoords.x && m_lastChunkCoords.y == chunkCoords.y)
+            return m_lastChunk;
         auto it = m_chunks.find(chunkCoords);
         if(it == m_chunks.end())
             return nullptr;
-        return it->second.get();
+        m_lastChunkCoords = chunkCoords;
+        m_lastChunk = it->second.get();
+        return m_lastChunk;
     }
 
-    // Get pointer to chunk, if it exists.
+    // Get pointer to chunk, if it exists. Missing chunks are not inserted.
     virtual ChunkType* getChunk(Vec2i chunkCoords)
     {
-        return m_chunks[chunkCoords].get();
+        return const_cast<ChunkType*>(static_cast<const ChunkedTileMap2D*>(this)->getChunk(chunkCoords));
     }
 
     // Ensure that chunk exists, and return reference to it.
@@ -88,7 +96,8 @@ public:
         if(!chunk)
         {
             ChunkType& ptr = allocateChunk(chunkCoords);
-            generateChunk(chunkCoords, ptr);
+            if(!m_loader || !m_loader(chunkCoords, ptr))
+                generateChunk(chunkCoords, ptr);
             return ptr;
         }
         return *chunk;
@@ -115,12 +124,34 @@ public:
         initialize(getAndAllocateChunk(chunkCoords), defaultTile);
     }
 
-    Vec2i getChunkCoords(Vec2i globalCoord)
+    // Set tile at specified position, allocating its chunk if necessary,
+    // and mark the chunk dirty.
+    void setTile(Vec2i vec, const TileType& tile)
     {
-        return Vec2i(globalCoord.x / CSX, globalCoord.y / CSY);
+        ChunkType& chunk = ensureChunk(getChunkCoords(vec));
+        chunk.getTile(getLocalCoords(vec)) = tile;
+        chunk.markDirty();
     }
 
-    Vec2s getLocalCoords(Vec2i globalCoord)
+    // Notify renderers that chunk contents changed. Required only if tiles
+    // were modified directly by reference; setTile() does it automatically.
+    void markChunkDirty(Vec2i chunkCoords)
+    {
+        ChunkType* chunk = getChunk(chunkCoords);
+        if(chunk)
+            chunk->markDirty();
+    }
+
+    void markTileDirty(Vec2i globalCoord) { markChunkDirty(getChunkCoords(globalCoord)); }
+
+    Vec2i getChunkCoords(Vec2i globalCoord) const
+    {
+        // Round towards negative infinity, so that it matches getLocalCoords().
+        return Vec2i(globalCoord.x < 0 ? (globalCoord.x + 1) / (int)CSX - 1 : globalCoord.x / (int)CSX,
+                     globalCoord.y < 0 ? (globalCoord.y + 1) / (int)CSY - 1 : globalCoord.y / (int)CSY);
+    }
+
+    Vec2s getLocalCoords(Vec2i globalCoord) const
     {
         return {(globalCoord.x < 0 ? ((unsigned)(CSX - 1) + int(globalCoord.x + 1) % (int)CSX) : globalCoord.x % (int)CSX),
                 (globalCoord.y < 0 ? ((unsigned)(CSY - 1) + int(globalCoord.y + 1) % (int)CSY) : globalCoord.y % (int)CSY)};
@@ -128,17 +159,171 @@ public:
 
     Vec2i getGlobalCoords(Vec2i chunkCoord, Vec2s localCoord);
 
+    // With async generation enabled, generator is called from worker threads,
+    // possibly for many chunks at once, so it must not touch shared state.
+    // For random generation, seed the randomizer with getChunkSeed() so that
+    // the result doesn't depend on generation order.
     void setGenerator(std::function<void(Vec2i, ChunkType&)> func) { m_generator = func; }
 
+    void setSeed(MaxUint seed) { m_seed = seed; }
+    MaxUint getSeed() const { return m_seed; }
+
+    // Seed for chunk at specified position, derived from tilemap seed.
+    MaxUint getChunkSeed(Vec2i chunkCoords) const
+    {
+        // splitmix64 finalizer
+        MaxUint value = m_seed ^ (((MaxUint)(Uint32)chunkCoords.x << 32) | (Uint32)chunkCoords.y);
+        value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+        return value ^ (value >> 31);
+    }
+
+    // Generate missing chunks in background (TaskExecutor, at most
+    // %maxConcurrency at once) instead of blocking in requestChunk().
+    // Generated chunks are added to tilemap in update(). 0 disables async
+    // generation.
+    void setAsyncGeneration(Size maxConcurrency)
+    {
+        m_generationPool = maxConcurrency > 0 ? std::make_unique<ChunkWorkerPool>(maxConcurrency) : nullptr;
+        m_pendingGeneration.clear();
+    }
+
+    bool isAsyncGenerationEnabled() const { return m_generationPool != nullptr; }
+
+    // Returns chunk if it exists. Otherwise, if async loader is set or async
+    // generation is enabled, schedules loading or generation and returns
+    // nullptr; if not, ensures the chunk.
+    const ChunkType* requestChunk(Vec2i chunkCoords)
+    {
+        const ChunkType* chunk = getChunk(chunkCoords);
+        if(chunk)
+            return chunk;
+        if(m_asyncLoader)
+        {
+            m_asyncLoader(chunkCoords);
+            return getChunk(chunkCoords);
+        }
+        if(!m_generationPool)
+            return &ensureChunk(chunkCoords);
+        requestGeneration(chunkCoords);
+        return nullptr;
+    }
+
+    // Generate chunk in background if async generation is enabled, immediately
+    // otherwise. Unlike ensureChunk(), loader is not used, so call
+    // requestChunk() for chunks that may have been saved.
+    void requestGeneration(Vec2i chunkCoords)
+    {
+        if(!m_generationPool)
+        {
+            regenerateChunk(chunkCoords);
+            return;
+        }
+        if(!m_pendingGeneration.insert(chunkCoords).second)
+            return;
+
+        m_generationPool->post([this, chunkCoords]() {
+            // Completion must be copyable, so it can't hold UniquePtr directly.
+            auto chunk = make<UniquePtr<ChunkType>>(std::make_unique<ChunkType>());
+            generateChunk(chunkCoords, **chunk);
+            return [this, chunkCoords, chunk]() {
+                m_pendingGeneration.erase(chunkCoords);
+
+                // Ensured synchronously in the meantime.
+                if(getChunk(chunkCoords))
+                    return;
+                addChunk(chunkCoords, std::move(*chunk));
+            };
+        });
+    }
+
+    // Add chunks generated in background. Call it at the start of every tick.
+    void update()
+    {
+        if(m_generationPool)
+            m_generationPool->processCompletions();
+    }
+
+    // Chunks scheduled for generation that weren't added to tilemap yet.
+    Size getPendingGenerationCount() const { return m_pendingGeneration.size(); }
+
+    // Loader is tried before generator when ensureChunk() needs a new chunk.
+    // It should fill the chunk and return true, or return false if it
+    // doesn't know the chunk. Used by ChunkStreamer.
+    void setLoader(std::function<bool(Vec2i, ChunkType&)> func) { m_loader = func; }
+
+    // Used by requestChunk() instead of generation if set. It should load
+    // the chunk in background, and call requestGeneration() if the chunk
+    // was never saved. Used by ChunkStreamer.
+    void setAsyncLoader(std::function<void(Vec2i)> func) { m_asyncLoader = func; }
+
+    // Add existing chunk to tilemap, replacing old one if it exists.
+    void insertChunk(Vec2i chunkCoords, UniquePtr<ChunkType> chunk) { addChunk(chunkCoords, std::move(chunk)); }
+
+    // Remove chunk from tilemap and return it. Returns nullptr if it doesn't exist.
+    UniquePtr<ChunkType> removeChunk(Vec2i chunkCoords)
+    {
+        auto it = m_chunks.find(chunkCoords);
+        if(it == m_chunks.end())
+            return nullptr;
+        UniquePtr<ChunkType> chunk = std::move(it->second);
+        m_chunks.erase(it);
+        m_lastChunk = nullptr;
+        return chunk;
+    }
+
     const auto begin() const { return m_chunks.begin(); }
     auto begin() { return m_chunks.begin(); }
 
     const auto end() const { return m_chunks.end(); }
     auto end() { return m_chunks.end(); }
 
-    Size size() { return m_chunks.size(); }
+    Size size() const { return m_chunks.size(); }
+
+    // Call %func for every existing chunk in the range from %beginChunk to
+    // %endChunk (inclusive), without allocating missing ones.
+    // Function: void(Vec2i chunkCoords, ChunkType& chunk)
+    template<class Func>
+    void forEachChunk(Vec2i beginChunk, Vec2i endChunk, Func&& func)
+    {
+        forEachChunkImpl(*this, beginChunk, endChunk, func);
+    }
+
+    template<class Func>
+    void forEachChunk(Vec2i beginChunk, Vec2i endChunk, Func&& func) const
+    {
+        forEachChunkImpl(*this, beginChunk, endChunk, func);
+    }
 
 private:
+    template<class Self, class Func>
+    static void forEachChunkImpl(Self& self, Vec2i beginChunk, Vec2i endChunk, Func& func)
+    {
+        if(endChunk.x < beginChunk.x || endChunk.y < beginChunk.y)
+            return;
+
+        // Probe every position only if it's cheaper than walking all chunks.
+        MaxInt area = ((MaxInt)endChunk.x - beginChunk.x + 1) * ((MaxInt)endChunk.y - beginChunk.y + 1);
+        if((Size)area <= self.m_chunks.size())
+        {
+            for(int x = beginChunk.x; x <= endChunk.x; x++)
+            for(int y = beginChunk.y; y <= endChunk.y; y++)
+            {
+                auto it = self.m_chunks.find(Vec2i(x, y));
+                if(it != self.m_chunks.end())
+                    func(it->first, *it->second);
+            }
+        }
+        else
+        {
+            for(auto& pr: self.m_chunks)
+            {
+                if(pr.first.x >= beginChunk.x && pr.first.x <= endChunk.x && pr.first.y >= beginChunk.y && pr.first.y <= endChunk.y)
+                    func(pr.first, *pr.second);
+            }
+        }
+    }
+
     // Initialize chunk with specified tile.
     void initialize(ChunkType& chunk, const TileType& defaultTile = {})
     {
@@ -147,13 +332,17 @@ private:
         {
             chunk.getTile(Vec2s(x, y)) = defaultTile;
         }
+        chunk.markDirty();
     }
 
     // Populate chunk using user-specified generator or default initializer.
     void generateChunk(Vec2i chunkCoords, ChunkType& chunk)
     {
         if(m_generator)
+        {
             m_generator(chunkCoords, chunk);
+            chunk.markDirty();
+        }
         else
             initialize(chunk);
     }
@@ -182,10 +371,23 @@ private:
     void addChunk(Vec2i chunkCoords, UniquePtr<ChunkType> chunk)
     {
         m_chunks[chunkCoords] = std::move(chunk);
+        m_lastChunk = nullptr;
     }
 
-    Map<Vec2i, UniquePtr<ChunkType>> m_chunks;
+    std::unordered_map<Vec2i, UniquePtr<ChunkType>, ChunkCoordsHash, ChunkCoordsEqual> m_chunks;
     std::function<void(Vec2i, ChunkType&)> m_generator;
+    std::function<bool(Vec2i, ChunkType&)> m_loader;
+    std::function<void(Vec2i)> m_asyncLoader;
+
+    // Tile accesses tend to be local, so remember the last chunk found.
+    mutable Vec2i m_lastChunkCoords;
+    mutable const ChunkType* m_lastChunk = nullptr;
+
+    MaxUint m_seed = 0;
+    std::unordered_set<Vec2i, ChunkCoordsHash, ChunkCoordsEqual> m_pendingGeneration;
+
+    // Last, so that workers are stopped before anything they use is destroyed.
+    UniquePtr<ChunkWorkerPool> m_generationPool;
 };
 
 }
@@ -87,6 +87,9 @@ public:
         return &m_tiles;
     }
 
+    // The only chunk is always ready.
+    const ChunkType* requestChunk(EGE::Vec2i chunkCoords) { return getChunk(chunkCoords); }
+
     // Ensure that chunk exists, and return reference to it.
     virtual ChunkType& ensureChunk(EGE::Vec2i chunkCoords)
     {
@@ -100,8 +103,12 @@ public:
         for(size_t x = 0; x < SX; x++)
         for(size_t y = 0; y < SY; y++)
             m_tiles.getTile({x, y}) = value;
+        m_tiles.markDirty();
     }
 
+    // Notify renderers that tiles were modified.
+    void markDirty() { m_tiles.markDirty(); }
+
 private:
     FixedChunk<TT, SX, SY> m_tiles;
 };
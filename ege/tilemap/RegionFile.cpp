@@ -0,0 +1,275 @@
+/*
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*      ,----  ,----  ,----
+*      |      |      |
+*      |----  | --,  |----
+*      |      |   |  |
+*      '----  '---'  '----
+*
+*     Framework Library for Hexagon
+*
+*    Copyright (c) Sppmacd 2020 - 2021
+*
+*    Permission is hereby granted, free of charge, to any person obtaining a copy
+*    of this software and associated documentation files (the "Software"), to deal
+*    in the Software without restriction, including without limitation the rights
+*    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*    copies of the Software, and to permit persons to whom the Software is
+*    furnished to do so, subject to the following conditions:
+*
+*    The above copyright notice and this permission notice shall be included in all
+*    copies or substantial portions of the Software.
+*
+*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*    SOFTWARE.
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*/
+#include "RegionFile.h"
+
+#include <ege/debug/Logger.h>
+#include <ege/util/system.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace EGE
+{
+
+namespace
+{
+
+const char RegionMagic[4] = {'E', 'G', 'E', 'R'};
+
+void writeUint32(Uint8* data, Uint32 value)
+{
+    for(Size s = 0; s < 4; s++)
+        data[s] = (value >> (s * 8)) & 0xFF;
+}
+
+Uint32 readUint32(const Uint8* data)
+{
+    Uint32 value = 0;
+    for(Size s = 0; s < 4; s++)
+        value |= (Uint32)data[s] << (s * 8);
+    return value;
+}
+
+int floorDiv(int value, int divisor)
+{
+    return value < 0 ? (value + 1) / divisor - 1 : value / divisor;
+}
+
+}
+
+Size RegionFile::entryIndex(Vec2i localCoords)
+{
+    ASSERT(localCoords.x >= 0 && localCoords.x < RegionSize);
+    ASSERT(localCoords.y >= 0 && localCoords.y < RegionSize);
+    return localCoords.y * RegionSize + localCoords.x;
+}
+
+bool RegionFile::open(bool create)
+{
+    if(m_open)
+        return true;
+    if(m_missing && !create)
+        return false;
+
+    m_file.clear();
+    m_file.open(m_fileName, std::ios::in | std::ios::out | std::ios::binary);
+    if(!m_file.is_open())
+    {
+        if(!create)
+        {
+            m_missing = true;
+            return false;
+        }
+
+        // Create empty region.
+        Vector<Uint8> header(headerSize(), 0);
+        std::copy(RegionMagic, RegionMagic + 4, header.begin());
+        writeUint32(header.data() + 4, Version);
+        {
+            std::ofstream file(m_fileName, std::ios::binary);
+            file.write((const char*)header.data(), header.size());
+            if(!file.good())
+            {
+                ege_log.error() << "RegionFile: Failed to create " << m_fileName;
+                return false;
+            }
+        }
+        m_file.clear();
+        m_file.open(m_fileName, std::ios::in | std::ios::out | std::ios::binary);
+        if(!m_file.is_open())
+        {
+            ege_log.error() << "RegionFile: Failed to open " << m_fileName;
+            return false;
+        }
+    }
+    m_missing = false;
+
+    Vector<Uint8> header(headerSize());
+    m_file.read((char*)header.data(), header.size());
+    if(!m_file.good() || !std::equal(RegionMagic, RegionMagic + 4, header.begin()) || readUint32(header.data() + 4) != Version)
+    {
+        ege_log.error() << "RegionFile: " << m_fileName << " is not a valid region file";
+        m_file.close();
+        return false;
+    }
+
+    m_file.seekg(0, std::ios::end);
+    m_fileSize = m_file.tellg();
+
+    // Don't trust the header, file may be truncated or corrupted. Reading
+    // such entry would allocate up to 4 GiB before failing.
+    Size invalidEntries = 0;
+    for(Size s = 0; s < RegionSize * RegionSize; s++)
+    {
+        Entry& entry = m_entries[s];
+        entry.offset = readUint32(header.data() + 8 + s * 8);
+        entry.size = readUint32(header.data() + 12 + s * 8);
+        if(entry.size != 0 && (entry.offset < headerSize() || (Uint64)entry.offset + entry.size > m_fileSize))
+        {
+            entry = Entry();
+            invalidEntries++;
+        }
+    }
+    if(invalidEntries > 0)
+        ege_log.error() << "RegionFile: " << m_fileName << " has " << invalidEntries << " chunks outside of file, they are ignored";
+    m_open = true;
+    return true;
+}
+
+bool RegionFile::contains(Vec2i localCoords)
+{
+    if(!open(false))
+        return false;
+    return m_entries[entryIndex(localCoords)].size != 0;
+}
+
+bool RegionFile::read(Vec2i localCoords, Vector<Uint8>& blob)
+{
+    if(!open(false))
+        return false;
+
+    const Entry& entry = m_entries[entryIndex(localCoords)];
+    if(entry.size == 0)
+        return false;
+
+    blob.resize(entry.size);
+    m_file.seekg(entry.offset);
+    m_file.read((char*)blob.data(), entry.size);
+    if(!m_file.good())
+    {
+        ege_log.error() << "RegionFile: Failed to read chunk (" << localCoords.x << ", " << localCoords.y << ") from " << m_fileName;
+        m_file.clear();
+        return false;
+    }
+    return true;
+}
+
+bool RegionFile::write(Vec2i localCoords, const Vector<Uint8>& blob)
+{
+    ASSERT(!blob.empty());
+    ASSERT(blob.size() <= std::numeric_limits<Uint32>::max());
+    if(!open(true))
+        return false;
+
+    Size index = entryIndex(localCoords);
+    Entry entry = m_entries[index];
+
+    // Reuse old space if the blob fits.
+    if(blob.size() > entry.size)
+    {
+        m_file.seekp(0, std::ios::end);
+        auto end = m_file.tellp();
+
+        // Offsets are stored as Uint32.
+        if(end < 0 || (Uint64)end + blob.size() > std::numeric_limits<Uint32>::max())
+        {
+            ege_log.error() << "RegionFile: " << m_fileName << " is full, can't write chunk (" << localCoords.x << ", " << localCoords.y << ")";
+            m_file.clear();
+            return false;
+        }
+        entry.offset = end;
+    }
+    entry.size = blob.size();
+
+    m_file.seekp(entry.offset);
+    m_file.write((const char*)blob.data(), blob.size());
+
+    Uint8 entryData[8];
+    writeUint32(entryData, entry.offset);
+    writeUint32(entryData + 4, entry.size);
+    m_file.seekp(8 + index * 8);
+    m_file.write((const char*)entryData, 8);
+    m_file.flush();
+
+    if(!m_file.good())
+    {
+        ege_log.error() << "RegionFile: Failed to write chunk (" << localCoords.x << ", " << localCoords.y << ") to " << m_fileName;
+        m_file.clear();
+        return false;
+    }
+    m_entries[index] = entry;
+    m_fileSize = std::max<Uint64>(m_fileSize, (Uint64)entry.offset + entry.size);
+    return true;
+}
+
+Vec2i RegionStorage::getRegionCoords(Vec2i chunkCoords)
+{
+    return Vec2i(floorDiv(chunkCoords.x, RegionFile::RegionSize), floorDiv(chunkCoords.y, RegionFile::RegionSize));
+}
+
+Vec2i RegionStorage::getLocalCoords(Vec2i chunkCoords)
+{
+    Vec2i region = getRegionCoords(chunkCoords);
+    return Vec2i(chunkCoords.x - region.x * RegionFile::RegionSize, chunkCoords.y - region.y * RegionFile::RegionSize);
+}
+
+RegionFile& RegionStorage::getRegion(Vec2i regionCoords)
+{
+    auto it = m_regions.find(regionCoords);
+    if(it != m_regions.end())
+        return *it->second;
+
+    if(m_regions.size() >= MaxOpenRegions)
+        m_regions.clear();
+
+    std::string fileName = m_directory + "/r." + std::to_string(regionCoords.x) + "." + std::to_string(regionCoords.y) + ".egr";
+    auto& region = m_regions[regionCoords];
+    region = std::make_unique<RegionFile>(fileName);
+    return *region;
+}
+
+bool RegionStorage::read(Vec2i chunkCoords, Vector<Uint8>& blob)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return getRegion(getRegionCoords(chunkCoords)).read(getLocalCoords(chunkCoords), blob);
+}
+
+bool RegionStorage::write(Vec2i chunkCoords, const Vector<Uint8>& blob)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(!m_directoryCreated)
+    {
+        if(!System::createPath(m_directory))
+        {
+            ege_log.error() << "RegionStorage: Failed to create " << m_directory;
+            return false;
+        }
+        m_directoryCreated = true;
+    }
+    return getRegion(getRegionCoords(chunkCoords)).write(getLocalCoords(chunkCoords), blob);
+}
+
+}
@@ -0,0 +1,123 @@
+/*
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*      ,----  ,----  ,----
+*      |      |      |
+*      |----  | --,  |----
+*      |      |   |  |
+*      '----  '---'  '----
+*
+*     Framework Library for Hexagon
+*
+*    Copyright (c) Sppmacd 2020 - 2021
+*
+*    Permission is hereby granted, free of charge, to any person obtaining a copy
+*    of this software and associated documentation files (the "Software"), to deal
+*    in the Software without restriction, including without limitation the rights
+*    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*    copies of the Software, and to permit persons to whom the Software is
+*    furnished to do so, subject to the following conditions:
+*
+*    The above copyright notice and this permission notice shall be included in all
+*    copies or substantial portions of the Software.
+*
+*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*    SOFTWARE.
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*/
+
+#pragma once
+
+#include "TileMap2D.h"
+
+#include <ege/util/Types.h>
+#include <ege/util/Vector.h>
+
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace EGE
+{
+
+// Binary file that holds up to RegionSize x RegionSize chunk blobs.
+// Layout (all integers are little endian):
+//   char[4]   magic "EGER"
+//   Uint32    format version
+//   Uint32[2] blob offset and size, for every chunk (row-major)
+//   ...       chunk blobs
+// Size 0 means that chunk is not stored. Blobs that grew are appended at
+// the end of file, so the file may contain unused space. Entries that point
+// outside of file are ignored, and file can't grow over 4 GiB.
+class RegionFile
+{
+public:
+    static const int RegionSize = 32;
+    static const Uint32 Version = 1;
+
+    explicit RegionFile(std::string fileName)
+    : m_fileName(fileName) {}
+
+    bool read(Vec2i localCoords, Vector<Uint8>& blob);
+    bool write(Vec2i localCoords, const Vector<Uint8>& blob);
+    bool contains(Vec2i localCoords);
+
+    std::string getFileName() const { return m_fileName; }
+
+private:
+    struct Entry
+    {
+        Uint32 offset = 0;
+        Uint32 size = 0;
+    };
+
+    static Size entryIndex(Vec2i localCoords);
+    static Size headerSize() { return 8 + RegionSize * RegionSize * 8; }
+
+    bool open(bool create);
+
+    std::string m_fileName;
+    std::fstream m_file;
+    Entry m_entries[RegionSize * RegionSize];
+    Uint64 m_fileSize = 0;
+    bool m_open = false;
+    bool m_missing = false;
+};
+
+// Stores chunk blobs in region files in a directory. Thread safe.
+class RegionStorage
+{
+public:
+    explicit RegionStorage(std::string directory)
+    : m_directory(directory) {}
+
+    bool read(Vec2i chunkCoords, Vector<Uint8>& blob);
+    bool write(Vec2i chunkCoords, const Vector<Uint8>& blob);
+
+    static Vec2i getRegionCoords(Vec2i chunkCoords);
+    static Vec2i getLocalCoords(Vec2i chunkCoords);
+
+    std::string getDirectory() const { return m_directory; }
+
+private:
+    RegionFile& getRegion(Vec2i regionCoords);
+
+    // Open files are closed when this limit is reached.
+    static const Size MaxOpenRegions = 64;
+
+    std::string m_directory;
+    std::mutex m_mutex;
+    std::unordered_map<Vec2i, UniquePtr<RegionFile>, ChunkCoordsHash, ChunkCoordsEqual> m_regions;
+    bool m_directoryCreated = false;
+};
+
+}
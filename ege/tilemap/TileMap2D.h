@@ -38,10 +38,23 @@
 
 #include <ege/util/Vector.h>
 #include <cmath>
+#include <functional>
 
 namespace EGE
 {
 
+// Hash and equality functors for chunk coordinates, for use in unordered
+// containers (Vector2 operators aren't visible to std::equal_to).
+struct ChunkCoordsHash
+{
+    Size operator()(const Vec2i& vec) const { return std::hash<Uint64>()(((Uint64)(Uint32)vec.x << 32) | (Uint32)vec.y); }
+};
+
+struct ChunkCoordsEqual
+{
+    bool operator()(const Vec2i& _1, const Vec2i& _2) const { return _1.x == _2.x && _1.y == _2.y; }
+};
+
 template<class TT, Size SX, Size SY>
 class TileMapChunk
 {
@@ -52,6 +65,17 @@ public:
 
     virtual TT& getTile(EGE::Vec2s vec) = 0;
     virtual const TT& getTile(EGE::Vec2s vec) const = 0;
+
+    // Revision is incremented every time the chunk is marked dirty. Renderers
+    // compare it with revision of their cached geometry to know when it's
+    // necessary to rebuild it.
+    Size getRevision() const { return m_revision; }
+
+    // Call it after modifying tiles directly (via getTile() or ensureTile()).
+    void markDirty() { m_revision++; }
+
+private:
+    Size m_revision = 0;
 };
 
 template<class TT, class ST, Size CSX = 16, Size CSY = 16>
@@ -1,8 +1,16 @@
 #include <testsuite/Tests.h>
 
 #include <ege/tilemap/ChunkedTileMap2D.h>
+#include <ege/tilemap/ChunkStreamer.h>
 #include <ege/tilemap/FixedTileMap2D.h>
+#include <ege/tilemap/RegionFile.h>
+#include <ege/util/Random.h>
 #include <ege/util/VectorOperations.h>
+#include <ege/util/system.h>
+
+#include <atomic>
+#include <fstream>
+#include <thread>
 
 struct MyTile
 {
@@ -36,4 +44,229 @@ TESTCASE(chunked)
     return 0;
 }*/
 
+TESTCASE(chunkedLookup)
+{
+    EGE::ChunkedTileMap2D<MyTile, 16, 16> tileMap;
+
+    // Probing missing chunks doesn't allocate them.
+    for(int x = -100; x < 100; x++)
+        EXPECT(!tileMap.getTile(EGE::Vec2i(x * 16, 0)));
+    EXPECT_EQUAL(tileMap.size(), 0);
+
+    // Negative coordinates don't share chunks with positive ones.
+    tileMap.setTile(EGE::Vec2i(-1, -1), {1});
+    tileMap.setTile(EGE::Vec2i(15, 15), {2});
+    EXPECT_EQUAL(tileMap.size(), 2);
+    EXPECT_EQUAL(tileMap.getChunkCoords(EGE::Vec2i(-1, -1)), EGE::Vec2i(-1, -1));
+    EXPECT_EQUAL(tileMap.getChunkCoords(EGE::Vec2i(-16, 16)), EGE::Vec2i(-1, 1));
+    EXPECT_EQUAL(tileMap.getChunkCoords(EGE::Vec2i(-17, 0)), EGE::Vec2i(-2, 0));
+    EXPECT_EQUAL(tileMap.getTile(EGE::Vec2i(-1, -1))->c, 1);
+    EXPECT_EQUAL(tileMap.getTile(EGE::Vec2i(15, 15))->c, 2);
+    EXPECT_EQUAL(tileMap.getTile(EGE::Vec2i(0, 0))->c, 123);
+    return 0;
+}
+
+TESTCASE(chunkedIteration)
+{
+    EGE::ChunkedTileMap2D<MyTile, 16, 16> tileMap;
+    for(int x = -10; x < 10; x++)
+    for(int y = -10; y < 10; y++)
+        tileMap.generateChunk(EGE::Vec2i(x, y));
+    EXPECT_EQUAL(tileMap.size(), 400);
+
+    // Both small (probing) and large (scanning) ranges visit only existing chunks.
+    int count = 0;
+    tileMap.forEachChunk(EGE::Vec2i(-2, -2), EGE::Vec2i(1, 1), [&](EGE::Vec2i, auto&) { count++; });
+    EXPECT_EQUAL(count, 16);
+    count = 0;
+    tileMap.forEachChunk(EGE::Vec2i(0, 0), EGE::Vec2i(1000, 1000), [&](EGE::Vec2i coords, auto&) { count++; EXPECT(coords.x >= 0 && coords.y >= 0); });
+    EXPECT_EQUAL(count, 100);
+    EXPECT_EQUAL(tileMap.size(), 400);
+    return 0;
+}
+
+// 40000 chunks, 10M tile reads in scanline order.
+TESTCASE(chunkedLookup40k)
+{
+    EGE::ChunkedTileMap2D<MyTile, 16, 16> tileMap;
+    for(int x = 0; x < 200; x++)
+    for(int y = 0; y < 200; y++)
+        tileMap.generateChunk(EGE::Vec2i(x, y));
+
+    EGE::Size sum = 0;
+    for(int y = 0; y < 3125; y++)
+    for(int x = 0; x < 3200; x++)
+        sum += tileMap.getTile(EGE::Vec2i(x, y))->c;
+    EXPECT_EQUAL(sum, 123u * 10000000u);
+    return 0;
+}
+
+TESTCASE(regionFile)
+{
+    EGE::System::removePath("test-regions");
+    {
+        EGE::RegionStorage storage("test-regions");
+        EGE::Vector<EGE::Uint8> blob;
+        EXPECT(!storage.read(EGE::Vec2i(0, 0), blob));
+        EXPECT(storage.write(EGE::Vec2i(0, 0), {1, 2, 3}));
+        EXPECT(storage.write(EGE::Vec2i(-1, -33), {4, 5}));
+        EXPECT(storage.write(EGE::Vec2i(31, 31), {6}));
+
+        // Smaller blob reuses space, bigger one is appended.
+        EXPECT(storage.write(EGE::Vec2i(0, 0), {7}));
+        EXPECT(storage.write(EGE::Vec2i(31, 31), {8, 9, 10, 11}));
+    }
+
+    // Check from fresh storage so that data must come from disk.
+    EGE::RegionStorage storage("test-regions");
+    EGE::Vector<EGE::Uint8> blob;
+    EXPECT(storage.read(EGE::Vec2i(0, 0), blob) && blob == EGE::Vector<EGE::Uint8>({7}));
+    EXPECT(storage.read(EGE::Vec2i(-1, -33), blob) && blob == EGE::Vector<EGE::Uint8>({4, 5}));
+    EXPECT(storage.read(EGE::Vec2i(31, 31), blob) && blob == EGE::Vector<EGE::Uint8>({8, 9, 10, 11}));
+    EXPECT(!storage.read(EGE::Vec2i(1, 0), blob));
+    EXPECT(!storage.read(EGE::Vec2i(32, 0), blob));
+    EXPECT_EQUAL(EGE::RegionStorage::getRegionCoords(EGE::Vec2i(-1, -33)), EGE::Vec2i(-1, -2));
+    EXPECT_EQUAL(EGE::RegionStorage::getLocalCoords(EGE::Vec2i(-1, -33)), EGE::Vec2i(31, 31));
+    EGE::System::removePath("test-regions");
+
+    // Entries pointing outside of file are ignored.
+    {
+        EGE::RegionFile file("test-region.bin");
+        EXPECT(file.write(EGE::Vec2i(0, 0), {1, 2, 3}));
+        EXPECT(file.write(EGE::Vec2i(1, 0), {4, 5, 6}));
+    }
+    {
+        std::fstream file("test-region.bin", std::ios::in | std::ios::out | std::ios::binary);
+        EGE::Uint8 entry[8] = {0, 0, 0, 0, 0, 0, 0, 0xF0};
+        file.seekp(8 + 8);
+        file.write((const char*)entry, 8);
+    }
+    EGE::RegionFile file("test-region.bin");
+    EXPECT(!file.read(EGE::Vec2i(1, 0), blob));
+    EXPECT(file.read(EGE::Vec2i(0, 0), blob) && blob == EGE::Vector<EGE::Uint8>({1, 2, 3}));
+    EGE::System::removePath("test-region.bin");
+    return 0;
+}
+
+TESTCASE(chunkStreaming)
+{
+    typedef EGE::ChunkedTileMap2D<MyTile, 16, 16> TileMap;
+    EGE::System::removePath("test-streaming");
+
+    TileMap tileMap;
+    EGE::ChunkStreamer<TileMap> streamer(tileMap, "test-streaming");
+    streamer.setMemoryBudget(64 * sizeof(TileMap::ChunkType));
+
+    // Walk far away, leaving a mark in every chunk.
+    for(int x = 0; x < 200; x++)
+    {
+        streamer.setViewer(1, EGE::Vec2i(x, 0), 2);
+        streamer.update();
+        EXPECT(tileMap.size() <= 64);
+        streamer.flush();
+        EXPECT(tileMap.getChunk(EGE::Vec2i(x, 0)));
+        tileMap.setTile(EGE::Vec2i(x * 16, 0), {(char)x});
+    }
+    EXPECT(streamer.getEvictedChunkCount() > 0);
+
+    // Marks are preserved both when loading in background and when
+    // chunk is ensured directly.
+    EXPECT_EQUAL(streamer.getLoadStallCount(), 0u);
+    EXPECT_EQUAL(tileMap.ensureTile(EGE::Vec2i(0, 0)).c, 0);
+    EXPECT_EQUAL(tileMap.ensureTile(EGE::Vec2i(0, 1)).c, 123);
+    EXPECT_EQUAL(streamer.getLoadStallCount(), 1u);
+
+    // Tilemap requests (e.g from renderer) load saved chunks in background
+    // instead of generating them again.
+    tileMap.setAsyncGeneration(2);
+    EXPECT(!tileMap.requestChunk(EGE::Vec2i(1, 0)));
+    streamer.flush();
+    auto chunk = tileMap.requestChunk(EGE::Vec2i(1, 0));
+    EXPECT(chunk && chunk->getTile(EGE::Vec2s(0, 0)).c == 1);
+    EXPECT_EQUAL(tileMap.getPendingGenerationCount(), 0u);
+    EXPECT_EQUAL(streamer.getLoadStallCount(), 1u);
+    tileMap.setAsyncGeneration(0);
+
+    for(int x = 199; x >= 0; x--)
+    {
+        streamer.setViewer(1, EGE::Vec2i(x, 0), 2);
+        streamer.update();
+        streamer.flush();
+        EXPECT_EQUAL(tileMap.getTile(EGE::Vec2i(x * 16, 0))->c, (char)x);
+    }
+    streamer.saveAll();
+    EGE::System::removePath("test-streaming");
+    return 0;
+}
+
+TESTCASE(asyncGeneration)
+{
+    typedef EGE::ChunkedTileMap2D<MyTile, 16, 16> TileMap;
+    auto generator = [](TileMap& tileMap) {
+        return [&tileMap](EGE::Vec2i chunkCoords, TileMap::ChunkType& chunk) {
+            EGE::Random random(tileMap.getChunkSeed(chunkCoords));
+            for(EGE::Size x = 0; x < 16; x++)
+            for(EGE::Size y = 0; y < 16; y++)
+                chunk.getTile(EGE::Vec2s(x, y)).c = random.nextInt(100);
+        };
+    };
+
+    TileMap syncMap;
+    syncMap.setSeed(1234);
+    syncMap.setGenerator(generator(syncMap));
+
+    TileMap asyncMap;
+    asyncMap.setSeed(1234);
+    asyncMap.setGenerator(generator(asyncMap));
+    asyncMap.setAsyncGeneration(4);
+
+    // Request in reverse order, so that generation order differs.
+    for(int x = 19; x >= -20; x--)
+    for(int y = 19; y >= -20; y--)
+        EXPECT(!asyncMap.requestChunk(EGE::Vec2i(x, y)));
+    EXPECT_EQUAL(asyncMap.size(), 0);
+    EXPECT_EQUAL(asyncMap.getPendingGenerationCount(), 1600);
+
+    while(asyncMap.getPendingGenerationCount() > 0)
+    {
+        asyncMap.update();
+        std::this_thread::yield();
+    }
+    EXPECT_EQUAL(asyncMap.size(), 1600);
+
+    // Result is the same as generating synchronously.
+    bool same = true;
+    for(int x = -20 * 16; x < 20 * 16; x++)
+    for(int y = -20 * 16; y < 20 * 16; y++)
+        same &= syncMap.ensureTile(EGE::Vec2i(x, y)).c == asyncMap.getTile(EGE::Vec2i(x, y))->c;
+    EXPECT(same);
+
+    // Destroyed pool waits for running job, jobs that didn't start are canceled.
+    std::atomic<int> started { 0 };
+    std::atomic<bool> gate { false };
+    std::thread opener;
+    {
+        EGE::ChunkWorkerPool pool(1);
+        for(int s = 0; s < 10; s++)
+        {
+            pool.post([&]() {
+                started++;
+                while(!gate)
+                    std::this_thread::yield();
+                return EGE::ChunkWorkerPool::Completion();
+            });
+        }
+        while(started == 0)
+            std::this_thread::yield();
+        EXPECT_EQUAL(pool.getPendingJobCount(), 10u);
+        opener = std::thread([&gate]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            gate = true;
+        });
+    }
+    opener.join();
+    EXPECT_EQUAL(started.load(), 1);
+    return 0;
+}
+
 RUN_TESTS(tilemap)
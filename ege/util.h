@@ -60,6 +60,7 @@
 #include <ege/util/Random.h>
 #include <ege/util/Rect.h>
 #include <ege/util/Serializable.h>
+#include <ege/util/SmallFunction.h>
 #include <ege/util/StringUtils.h>
 #include <ege/util/Time.h>
 #include <ege/util/Types.h>
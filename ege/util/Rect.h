@@ -63,7 +63,8 @@ public:
 
     T area() const { return size.x * size.y; }
     T perimeter() const { return 2 * (size.x + size.y); }
-    bool empty() const { return size == Vector2<T>(); }
+    // NOTE: Vector2 operators are not visible from here, compare components.
+    bool empty() const { return size.x == 0 && size.y == 0; }
 
     bool contains(Vector2<T> pos) const
         { return pos.x >= position.x && pos.y >= position.y && pos.x <= position.x + size.x && pos.y <= position.y + size.y; }
@@ -95,7 +96,7 @@ public:
         { return intersection(other); }
 
     bool operator==(const Rect<T>& other) const
-        { return position == other.position && size == other.size; }
+        { return position.x == other.position.x && position.y == other.position.y && size.x == other.size.x && size.y == other.size.y; }
 
     bool operator!=(const Rect<T>& other) const
         { return !(*this == other); }
@@ -0,0 +1,166 @@
+/*
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*      ,----  ,----  ,----
+*      |      |      |
+*      |----  | --,  |----
+*      |      |   |  |
+*      '----  '---'  '----
+*
+*     Framework Library for Hexagon
+*
+*    Copyright (c) Sppmacd 2020 - 2021
+*
+*    Permission is hereby granted, free of charge, to any person obtaining a copy
+*    of this software and associated documentation files (the "Software"), to deal
+*    in the Software without restriction, including without limitation the rights
+*    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*    copies of the Software, and to permit persons to whom the Software is
+*    furnished to do so, subject to the following conditions:
+*
+*    The above copyright notice and this permission notice shall be included in all
+*    copies or substantial portions of the Software.
+*
+*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*    SOFTWARE.
+*
+*   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*
+*/
+
+#pragma once
+
+#include <ege/main/Config.h>
+#include <ege/util/Types.h>
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace EGE
+{
+
+// Move-only std::function replacement that keeps callables of up to
+// InlineSize bytes inside itself, so that creating and moving it doesn't
+// allocate. Bigger callables are allocated on heap.
+template<class Signature, Size InlineSize = 48>
+class SmallFunction;
+
+template<class R, class... Args, Size InlineSize>
+class SmallFunction<R(Args...), InlineSize>
+{
+public:
+    SmallFunction() = default;
+    SmallFunction(std::nullptr_t) {}
+
+    template<class Func, class = std::enable_if_t<!std::is_same_v<std::decay_t<Func>, SmallFunction>>>
+    SmallFunction(Func&& func)
+    {
+        typedef std::decay_t<Func> F;
+        if constexpr(fitsInline<F>())
+        {
+            new(m_storage) F(std::forward<Func>(func));
+            m_ops = &InlineOps<F>::ops;
+        }
+        else
+        {
+            *reinterpret_cast<F**>(m_storage) = new F(std::forward<Func>(func));
+            m_ops = &HeapOps<F>::ops;
+        }
+    }
+
+    SmallFunction(SmallFunction&& other) noexcept { moveFrom(other); }
+
+    SmallFunction& operator=(SmallFunction&& other) noexcept
+    {
+        if(this != &other)
+        {
+            reset();
+            moveFrom(other);
+        }
+        return *this;
+    }
+
+    SmallFunction(const SmallFunction&) = delete;
+    SmallFunction& operator=(const SmallFunction&) = delete;
+
+    ~SmallFunction() { reset(); }
+
+    R operator()(Args... args)
+    {
+        ASSERT(m_ops);
+        return m_ops->invoke(m_storage, std::forward<Args>(args)...);
+    }
+
+    explicit operator bool() const { return m_ops; }
+
+    void reset()
+    {
+        if(m_ops)
+            m_ops->destroy(m_storage);
+        m_ops = nullptr;
+    }
+
+    // True if callable didn't fit in InlineSize and was allocated.
+    bool isAllocated() const { return m_ops && m_ops->allocated; }
+
+private:
+    struct Ops
+    {
+        R (*invoke)(void*, Args&&...);
+        void (*move)(void* to, void* from);
+        void (*destroy)(void*);
+        bool allocated;
+    };
+
+    template<class F>
+    static constexpr bool fitsInline()
+    {
+        return sizeof(F) <= InlineSize && alignof(F) <= alignof(std::max_align_t) && std::is_nothrow_move_constructible_v<F>;
+    }
+
+    template<class F>
+    struct InlineOps
+    {
+        static R invoke(void* storage, Args&&... args) { return (*static_cast<F*>(storage))(std::forward<Args>(args)...); }
+        static void move(void* to, void* from)
+        {
+            new(to) F(std::move(*static_cast<F*>(from)));
+            static_cast<F*>(from)->~F();
+        }
+        static void destroy(void* storage) { static_cast<F*>(storage)->~F(); }
+
+        static constexpr Ops ops { &invoke, &move, &destroy, false };
+    };
+
+    template<class F>
+    struct HeapOps
+    {
+        static R invoke(void* storage, Args&&... args) { return (**static_cast<F**>(storage))(std::forward<Args>(args)...); }
+        static void move(void* to, void* from) { *static_cast<F**>(to) = *static_cast<F**>(from); }
+        static void destroy(void* storage) { delete *static_cast<F**>(storage); }
+
+        static constexpr Ops ops { &invoke, &move, &destroy, true };
+    };
+
+    void moveFrom(SmallFunction& other)
+    {
+        if(!other.m_ops)
+            return;
+        other.m_ops->move(m_storage, other.m_storage);
+        m_ops = other.m_ops;
+        other.m_ops = nullptr;
+    }
+
+    alignas(std::max_align_t) unsigned char m_storage[InlineSize];
+    const Ops* m_ops = nullptr;
+};
+
+}
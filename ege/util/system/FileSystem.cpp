@@ -80,7 +80,8 @@ bool createPath(std::string path, FileMode mode)
 {
     for(EGE::Size s = 0; s < path.size() + 1; s++)
     {
-        if(path[s] == '/' || s == path.size())
+        // Skip root of absolute paths.
+        if((path[s] == '/' || s == path.size()) && s > 0)
         {
             if(!createDirectory(path.substr(0, s), mode))
             {